@@ -0,0 +1,102 @@
+// The applications of the window under the cursor: app_matcher_t::match()
+// on a memo hit and on a miss, against the regex_match of every pattern it
+// replaced. The patterns are those of a large configuration: 300 plain names
+// and 100 regexes; the names are of those applications and of others.
+#include <stdint.h>
+
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "apps.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+constexpr auto REGEX_FLAGS = std::regex_constants::ECMAScript|std::regex_constants::icase;
+
+// as the set was made before: every pattern is a regex, tried in order.
+app_set_t scan(const std::vector<std::regex>& patterns, const std::string& executable)
+{
+	app_set_t apps(patterns.size());
+	for (size_t i = 0; i < patterns.size(); ++i)
+		if (std::regex_match(executable, patterns[i]))
+			apps.set((app_id_t)i);
+	return apps;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	std::vector<std::string> patterns;
+	for (int i = 0; i < 300; ++i)
+		patterns.push_back(fmt::format("application{}\\.exe", i));
+	for (int i = 0; i < 100; ++i) {
+		switch (i % 4) {
+		case 0: patterns.push_back(fmt::format("tool{}(64)?\\.exe", i)); break;
+		case 1: patterns.push_back(fmt::format("(editor|viewer){}\\.exe", i)); break;
+		case 2: patterns.push_back(fmt::format(".*game{}\\.exe", i)); break;
+		case 3: patterns.push_back(fmt::format("service{}_\\d+\\.exe", i)); break;
+		}
+	}
+
+	app_matcher_t matcher;
+	std::vector<std::regex> regexes;
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		matcher.add(fmt::format("app{}", i), patterns[i]);
+		regexes.emplace_back(patterns[i], REGEX_FLAGS);
+	}
+
+	// a name of each kind in turn: a plain name, a regex, and no application.
+	// there are more of them than the memo keeps, so cycling through them
+	// always misses.
+	std::mt19937 random(2024);
+	std::vector<std::string> names;
+	for (int i = 0; i < 4096; ++i) {
+		auto n = random() % 100;
+		switch (i % 6) {
+		case 0: names.push_back(fmt::format("Application{}.exe", random() % 300)); break;
+		case 1: names.push_back(fmt::format("tool{}64.exe", n)); break;
+		case 2: names.push_back(fmt::format("viewer{}.exe", n)); break;
+		case 3: names.push_back(fmt::format("somegame{}.exe", n)); break;
+		case 4: names.push_back(fmt::format("service{}_{}.exe", n, i)); break;
+		case 5: names.push_back(fmt::format("unknown{}.exe", i)); break;
+		}
+	}
+
+	// both find the same applications.
+	for (auto& name: names) {
+		if (matcher.match(name) != scan(regexes, name)) {
+			fprintf(stderr, "match(\"%s\") differs from the scan\n", name.c_str());
+			return 1;
+		}
+	}
+
+	// the names of the windows the cursor moves over.
+	std::vector<std::string> hits(names.begin(), names.begin() + 16);
+	for (auto& name: hits)
+		matcher.match(name);
+	size_t i = 0;
+	run("match/hit", [&]{
+		keep(matcher.match(hits[i++ % hits.size()]));
+	});
+	i = 0;
+	run("match/miss", [&]{
+		keep(matcher.match(names[i++ % names.size()]));
+	});
+	i = 0;
+	run("regex_match/every pattern", [&]{
+		keep(scan(regexes, names[i++ % names.size()]));
+	});
+	return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef GPMOUSE_BENCH_BENCH_H
+#define GPMOUSE_BENCH_BENCH_H
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+
+// The harness of the benchmarks. Each case runs in samples of a fixed
+// number of calls, calibrated to about 10 ms, and reports the median and the
+// minimum time of a call over the samples: the median to compare releases,
+// the minimum to tell noise from a regression.
+// Output, one line per case:
+//   <name> <median ns> <min ns> <calls per sample>
+// The latency benchmarks report percentiles() of their own samples instead.
+namespace gpmouse::bench
+{
+
+// keeps the compiler from optimizing a value away.
+template <typename T>
+inline void keep(const T& v)
+{
+	asm volatile("" : : "r"(&v) : "memory");
+}
+
+// the cases to run: those whose name contains argv[1], or every case.
+inline const char*& filter()
+{
+	static const char* f = nullptr;
+	return f;
+}
+
+inline void init(int argc, char** argv)
+{
+	if (argc > 1)
+		filter() = argv[1];
+	printf("%-40s %10s %10s %10s\n", "case", "median ns", "min ns", "calls");
+}
+
+// calls f() in samples and prints its time per call, or per item when a
+// call processes items of something.
+template <typename F>
+void run(const char* name, F&& f, uint64_t items = 1)
+{
+	using clock = std::chrono::steady_clock;
+	constexpr int SAMPLES = 21;
+	constexpr auto TARGET = std::chrono::milliseconds(10);
+
+	if (filter() && !strstr(name, filter()))
+		return;
+
+	auto sample = [&](uint64_t calls) {
+		auto start = clock::now();
+		for (uint64_t i = 0; i < calls; ++i)
+			f();
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+	};
+
+	// the calls of a sample, which also warms up the caches and the branch predictors.
+	uint64_t calls = 1;
+	while (calls < (1ull << 32) && sample(calls) < std::chrono::duration<double, std::nano>(TARGET).count())
+		calls *= 2;
+
+	double ns[SAMPLES];
+	for (auto& t: ns)
+		t = sample(calls) / calls / items;
+	std::sort(ns, ns + SAMPLES);
+	printf("%-40s %10.2f %10.2f %10llu\n", name, ns[SAMPLES / 2], ns[0], (unsigned long long)calls);
+}
+
+// prints the percentiles of samples [ns]:
+//   <name> <p50> <p90> <p99> <max> <samples>
+inline void percentiles(const char* name, std::vector<double> samples)
+{
+	if (samples.empty() || (filter() && !strstr(name, filter())))
+		return;
+	std::sort(samples.begin(), samples.end());
+	auto at = [&](double p) { return samples[(size_t)(p * (samples.size() - 1))]; };
+	printf("%-40s p50 %10.0f p90 %10.0f p99 %10.0f max %10.0f (%zu)\n",
+		name, at(0.5), at(0.9), at(0.99), samples.back(), samples.size());
+}
+
+} // namespace gpmouse::bench
+
+#endif // ndef GPMOUSE_BENCH_BENCH_H
@@ -0,0 +1,82 @@
+// binding_table_t from a hundred to tens of thousands of bindings: the
+// lookup of the candidates of a button mask against the binary search over
+// the sorted bindings it replaced, and the build at load.
+#include <stdint.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "config.h"
+#include "bindings.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// n bindings of random combinations for 64 applications, sorted as configure() sorts them.
+std::vector<key_binding_t> random_bindings(size_t n, std::mt19937& random)
+{
+	std::uniform_int_distribution<int> mask(1, 0xffff), app(0, 64), key(1, 254);
+	std::vector<key_binding_t> bindings(n);
+	for (auto& b: bindings) {
+		b.buttons = (uint16_t)mask(random);
+		auto a = app(random);
+		b.app = a == 64 ? NO_APP : (app_id_t)a;
+		b.priority = (uint16_t)(b.app == NO_APP ? UINT16_MAX : a);
+		b.keys[0] = (uint8_t)key(random);
+	}
+	std::sort(bindings.begin(), bindings.end(), [](auto& a, auto& b) {
+		return a.buttons < b.buttons || (a.buttons == b.buttons && a.priority < b.priority);
+	});
+	return bindings;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	std::mt19937 random(2024);
+	key_binding_t single_button[16] = {};
+	for (int i = 0; i < 16; ++i)
+		single_button[i] = { .buttons = (uint16_t)(1 << i), .keys = { (uint8_t)(0x41 + i), 0, 0, 0 } };
+
+	// the masks looked up, pressed as often as they are bound.
+	std::vector<uint16_t> masks(4096);
+
+	for (size_t n: { 100, 1000, 10000, 50000 }) {
+		auto bindings = random_bindings(n, random);
+		std::uniform_int_distribution<size_t> pick(0, n - 1);
+		for (auto& m: masks)
+			m = bindings[pick(random)].buttons;
+
+		binding_table_t table;
+		table.build(bindings, single_button);
+
+		size_t next = 0;
+		run(fmt::format("candidates/{}", n).c_str(), [&]{
+			auto c = table.candidates(masks[next++ % masks.size()]);
+			keep(table.keys(c[0]));
+		});
+		run(fmt::format("equal_range/{}", n).c_str(), [&]{
+			key_binding_t key = {};
+			key.buttons = masks[next++ % masks.size()];
+			auto r = std::equal_range(bindings.begin(), bindings.end(), key);
+			keep(*r.first);
+		});
+		run(fmt::format("build/{}", n).c_str(), [&]{
+			binding_table_t t;
+			t.build(bindings, single_button);
+			keep(t);
+		});
+	}
+
+	return 0;
+}
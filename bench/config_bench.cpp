@@ -0,0 +1,49 @@
+// Loading a large gpmouse.toml: 200 applications with 8 bindings each.
+// Built only where toml11 and magic_enum are found, as loader.cpp.
+#include <string>
+
+#include <fmt/format.h>
+
+#include "settings.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+std::string large_config(int apps)
+{
+	static const char* buttons[] = { "A", "B", "X", "Y", "UP", "DOWN", "LEFT", "RIGHT" };
+
+	std::string text = "[logging]\nlevel = \"info\"\n\n";
+	for (auto b: buttons)
+		text += fmt::format("[[bindings.buttons]]\nbutton = \"{}\"\nkeys = \"F1\"\n\n", b);
+	for (int i = 0; i < apps; ++i) {
+		// every other pattern is a regular expression.
+		if (i % 2)
+			text += fmt::format("[[bindings.applications]]\nname = \"app{0}\"\npattern = 'app{0}(-x64)?\\.exe'\n\n", i);
+		else
+			text += fmt::format("[[bindings.applications]]\nname = \"app{0}\"\npattern = 'app{0}.exe'\n\n", i);
+		for (auto b: buttons)
+			text += fmt::format("[[bindings.binding]]\napp = \"app{}\"\nbuttons = [\"LEFT_SHOULDER\", \"{}\"]\nkeys = [\"CONTROL\", \"F{}\"]\n\n",
+				i, b, 1 + i % 12);
+	}
+	return text;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	auto text = large_config(200);
+	run("load_config/200 apps", [&]{
+		settings_t s;
+		load_config(text, "gpmouse.toml", s);
+		keep(s);
+	});
+	return 0;
+}
@@ -0,0 +1,58 @@
+// The response curves: a baked curve_table_t against evaluating the curve
+// on every sample, as the stick math did with pow().
+#include <stdint.h>
+#include <math.h>
+
+#include "config.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	const trigger_config_t curves[] = {
+		{ .maxval = 8, .type = analog_function_t::exp },
+		{ .minval = 0.5f, .maxval = 4, .type = analog_function_t::log },
+		{ .deadzone = 16, .maxval = 4, .type = analog_function_t::linear },
+	};
+	const char* names[][2] = {
+		{ "exp/evaluate", "exp/table" },
+		{ "log/evaluate", "log/table" },
+		{ "linear/evaluate", "linear/table" },
+	};
+
+	// the trigger sweeps its whole range, so the branches are not all predicted.
+	uint8_t x = 0;
+	for (size_t i = 0; i < std::size(curves); ++i) {
+		auto& cfg = curves[i];
+		curve_table_t table;
+		table.bake(cfg);
+		run(names[i][0], [&]{
+			keep(cfg.evaluate(x));
+			x += 37;
+		});
+		run(names[i][1], [&]{
+			keep(table[x]);
+			x += 37;
+		});
+	}
+
+	// what left_stick computed before the tables.
+	float accel_max = 8;
+	run("exp/pow per sample", [&]{
+		keep((float)pow(accel_max, x / 255.));
+		x += 37;
+	});
+
+	stick_t stick;
+	run("stick_t::bake", [&]{
+		stick.bake();
+		keep(stick);
+	});
+
+	return 0;
+}
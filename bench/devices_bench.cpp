@@ -0,0 +1,115 @@
+// The cost of a tick of the polling thread by the number of pads, up to 64
+// synthetic ones: every pad resting, every stick moving the cursor, a
+// button changing on one pad, and 4 pads left of 64 ids after the others
+// were unplugged, which has to cost as 4 pads do.
+#include <stdint.h>
+
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "settings.h"
+#include "engine.h"
+#include "source.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// Drops the events.
+class null_sink_t: public output_sink_t
+{
+public:
+	UINT send(UINT n, INPUT* inputs) override {
+		keep(inputs);
+		return n;
+	}
+};
+
+enum class load_t { rest, sticks, buttons };
+
+// n pads on the polling path of check_xinput(), and the handler's end of the queue.
+class rig_t
+{
+public:
+	rig_t(const settings_t& s, int n): _source(_devices), _queue(overflow_t::drop), _poller(_queue, _output) {
+		_poller.attach(_devices);
+		_poller.configure(s);
+		_pads.resize(n);
+		for (int i = 0; i < n; ++i)
+			_source.set(i, _pads[i]);
+	}
+
+	void unplug(int from) {
+		for (int i = from; i < (int)_pads.size(); ++i)
+			_source.disconnect(i);
+		_pads.resize(from);
+		tick(load_t::rest);
+	}
+
+	void tick(load_t load) {
+		++_now;
+		if (load == load_t::sticks) {
+			// every stick out of its deadzone, turning a little every tick.
+			for (size_t i = 0; i < _pads.size(); ++i) {
+				_pads[i].sThumbLX = (SHORT)(20000 + (_now + i) % 64 * 100);
+				_pads[i].sThumbRY = (SHORT)(-20000 - (_now + i) % 64 * 100);
+				_source.set((int)i, _pads[i]);
+			}
+		}
+		else if (load == load_t::buttons) {
+			auto i = _now % _pads.size();
+			_pads[i].wButtons ^= XINPUT_GAMEPAD_A;
+			_source.set((int)i, _pads[i]);
+		}
+
+		_poller.begin(_now * 8000, _now * 8000000);
+		_source.poll(
+			[&](device_id_t id, const XINPUT_STATE& state, bool changed) { _poller.state(id, state, changed); },
+			[&](device_id_t id) { _poller.disconnect(id); });
+		_poller.end();
+		_output.flush(_sink);
+
+		xinput_t input;
+		while (_queue.pop(input))
+			keep(input);
+	}
+
+private:
+	device_registry_t _devices;
+	synthetic_source_t _source;
+	xinput_queue_t _queue;
+	analog_output_t _output;
+	poller_t _poller;
+	null_sink_t _sink;
+	std::vector<XINPUT_GAMEPAD> _pads;
+	uint64_t _now = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	settings_t s;
+	default_config(s);
+
+	static const struct { load_t load; const char* name; } loads[] = {
+		{ load_t::rest, "rest" }, { load_t::sticks, "sticks" }, { load_t::buttons, "buttons" },
+	};
+	for (auto& [load, name]: loads) {
+		for (int n: { 1, 4, 16, 64 }) {
+			rig_t rig(s, n);
+			run(fmt::format("tick/{}/{} pads", name, n).c_str(), [&]{ rig.tick(load); });
+		}
+	}
+
+	rig_t sparse(s, 64);
+	sparse.unplug(4);
+	run("tick/sticks/4 of 64 ids", [&]{ sparse.tick(load_t::sticks); });
+	return 0;
+}
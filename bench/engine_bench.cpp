@@ -0,0 +1,143 @@
+// The hot paths of the mapping engine: translating the buttons into keys,
+// sending the keys which changed, the stick math and the key repeats.
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+#include "engine.h"
+#include "process.h"
+#include "repeat.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// Drops the events.
+class null_sink_t: public output_sink_t
+{
+public:
+	UINT send(UINT n, INPUT* inputs) override {
+		keep(inputs);
+		return n;
+	}
+};
+
+// One window, of an application with bindings of its own.
+class editor_window_system_t: public window_system_t
+{
+public:
+	window_t window_under_cursor() override { return 1; }
+	window_t foreground_window() override { return 1; }
+	process_id_t process_id(window_t) override { return 1; }
+	bool executable_name(process_id_t, std::string& name) override {
+		name = "code.exe";
+		return true;
+	}
+};
+
+// the default bindings, plus LB+A and LB+B for an application.
+void add_app_bindings(settings_t& s)
+{
+	auto& c = *s.controllers[0];
+	auto app = s.app_matcher.add("editor", "code.exe");
+	c.key_bindings.clear();
+	for (auto& sb: c.single_button)
+		if (sb.buttons != 0)
+			c.key_bindings.push_back(sb);
+	c.key_bindings.push_back({ .app = app, .priority = 0, .buttons = XINPUT_GAMEPAD_LEFT_SHOULDER | XINPUT_GAMEPAD_A, .keys = { VK_F5, 0, 0, 0 } });
+	c.key_bindings.push_back({ .app = app, .priority = 0, .buttons = XINPUT_GAMEPAD_LEFT_SHOULDER | XINPUT_GAMEPAD_B, .keys = { VK_F6, 0, 0, 0 } });
+	std::sort(c.key_bindings.begin(), c.key_bindings.end(), [](auto& a, auto& b) {
+		return a.buttons < b.buttons || (a.buttons == b.buttons && a.priority < b.priority);
+	});
+	c.binding_table.build(c.key_bindings, c.single_button);
+	c.binding_profiles.clear();
+}
+
+// stick positions around the circle, at every distance from the center.
+std::vector<XINPUT_GAMEPAD> stick_positions()
+{
+	std::vector<XINPUT_GAMEPAD> pads(256);
+	for (size_t i = 0; i < pads.size(); ++i) {
+		auto r = (int)(i % 16) * 2048;
+		auto a = (int)(i / 16);
+		pads[i].sThumbLX = (SHORT)std::clamp(r * ((a & 3) - 1), -32768, 32767);
+		pads[i].sThumbLY = (SHORT)std::clamp(r * (((a >> 2) & 3) - 1), -32768, 32767);
+		pads[i].sThumbRX = pads[i].sThumbLY;
+		pads[i].sThumbRY = pads[i].sThumbLX;
+	}
+	return pads;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	settings_t s;
+	default_config(s);
+	add_app_bindings(s);
+	auto& c = *s.controllers[0];
+
+	no_window_system_t no_windows;
+	process_cache_t no_processes(no_windows);
+	editor_window_system_t editor;
+	process_cache_t processes(editor);
+
+	run("translate_input/single", [&]{
+		keep(translate_input(s, c, no_processes, XINPUT_GAMEPAD_A));
+	});
+	run("translate_input/combination", [&]{
+		keep(translate_input(s, c, no_processes, XINPUT_GAMEPAD_DPAD_UP | XINPUT_GAMEPAD_X | XINPUT_GAMEPAD_RIGHT_SHOULDER));
+	});
+	run("translate_input/app", [&]{
+		keep(translate_input(s, c, processes, XINPUT_GAMEPAD_LEFT_SHOULDER | XINPUT_GAMEPAD_A));
+	});
+
+	// two states which differ in a few keys, sent alternately.
+	auto a = translate_input(s, c, no_processes, XINPUT_GAMEPAD_A | XINPUT_GAMEPAD_DPAD_UP);
+	auto b = translate_input(s, c, no_processes, XINPUT_GAMEPAD_B | XINPUT_GAMEPAD_DPAD_LEFT | XINPUT_GAMEPAD_LEFT_SHOULDER);
+	run("keycount", [&]{
+		keep(keycount(a, b));
+		std::swap(a, b);
+	});
+
+	null_sink_t sink;
+	keystate_t state = {};
+	run("gp_handle_buttons_input", [&]{
+		keep(gp_handle_buttons_input(sink, a, state));
+		std::swap(a, b);
+	});
+
+	auto pads = stick_positions();
+	size_t next = 0;
+	run("left_stick", [&]{
+		analog_motion_t out;
+		left_stick(c.stick_params.cursor, pads[next++ % pads.size()], out);
+		keep(out);
+	});
+	run("right_stick", [&]{
+		analog_motion_t out;
+		right_stick(c.stick_params.scroll, pads[next++ % pads.size()], out);
+		keep(out);
+	});
+
+	// 4 pads holding 4 keys each, repeating every millisecond.
+	repeat_config_t fast = { .delay = 1, .interval = 1, .keys = {} };
+	repeat_scheduler_t repeats;
+	uint64_t now = 0;
+	for (device_id_t d = 0; d < 4; ++d)
+		for (uint8_t vk: { VK_UP, VK_DOWN, VK_LEFT, VK_RIGHT })
+			repeats.press(d, vk, now, fast);
+	run("repeat_keys/16 keys", [&]{
+		repeat_keys(sink, repeats, ++now);
+	});
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+// The logging of an input event: the dozen debug lines of
+// gp_handle_buttons_input through GP_LOG_DEBUG, with the level off and on,
+// against calling the logger of get_logger() as the input threads used to.
+#include <stdint.h>
+
+#include <filesystem>
+
+// the debug lines are compiled in here, whatever the build.
+#define GP_LOG_LEVEL SPDLOG_LEVEL_DEBUG
+
+#include "config.h"
+#include "log.h"
+#include "engine.h"
+#include "output.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// Drops the events.
+class null_sink_t: public output_sink_t
+{
+public:
+	UINT send(UINT n, INPUT*) override { return n; }
+};
+
+void log_event(const keystate_t& input, const keystate_t& state)
+{
+	GP_LOG_DEBUG("number of inputs: {}", keycount(input, state));
+	GP_LOG_DEBUG("------ buttons -------");
+	for (int i = 0; i < 4; ++i)
+		GP_LOG_DEBUG("[{:02X}] {:016X} {:016X} {:016X} {:016X}", 64 * i, input.keys[i], state.keys[i], ~input.keys[i] & state.keys[i], input.keys[i] & ~state.keys[i]);
+	for (int i = 0; i < 4; ++i)
+		GP_LOG_DEBUG("up: {:016X} down: {:016X}", ~input.keys[i] & state.keys[i], input.keys[i] & ~state.keys[i]);
+	GP_LOG_DEBUG("---------------------");
+}
+
+// the same lines, before log.h.
+void log_event_get_logger(const keystate_t& input, const keystate_t& state)
+{
+	get_logger()->debug("number of inputs: {}", keycount(input, state));
+	get_logger()->debug("------ buttons -------");
+	for (int i = 0; i < 4; ++i)
+		get_logger()->debug("[{:02X}] {:016X} {:016X} {:016X} {:016X}", 64 * i, input.keys[i], state.keys[i], ~input.keys[i] & state.keys[i], input.keys[i] & ~state.keys[i]);
+	for (int i = 0; i < 4; ++i)
+		get_logger()->debug("up: {:016X} down: {:016X}", ~input.keys[i] & state.keys[i], input.keys[i] & ~state.keys[i]);
+	get_logger()->debug("---------------------");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	// an async logger on a small file of the temporary directory.
+	log_config_t log;
+	log.directory = (std::filesystem::temp_directory_path() / "gpmouse-bench").string();
+	log.max_size = 1024 * 1024;
+	log.max_files = 1;
+	log.level = "info";
+	configure_log(log);
+	auto logger = get_logger();
+
+	keystate_t a = {}, b = {};
+	a.press(VK_UP);
+	a.press(VK_SHIFT);
+	b.press(VK_LBUTTON);
+
+	run("GP_LOG_DEBUG/off", [&]{
+		log_event(a, b);
+		std::swap(a, b);
+	});
+	run("get_logger()->debug/off", [&]{
+		log_event_get_logger(a, b);
+		std::swap(a, b);
+	});
+
+	// the events as the engine sends them, its debug lines compiled out
+	// unless it is a debug build.
+	null_sink_t sink;
+	keystate_t state = {};
+	run("gp_handle_buttons_input/off", [&]{
+		keep(gp_handle_buttons_input(sink, a, state));
+		std::swap(a, b);
+	});
+
+	// formatted on the calling thread and written by the thread pool; the
+	// queue drops the oldest lines when the writer falls behind.
+	logger->set_level(spdlog::level::debug);
+	run("GP_LOG_DEBUG/on", [&]{
+		log_event(a, b);
+		std::swap(a, b);
+	});
+	run("get_logger()->debug/on", [&]{
+		log_event_get_logger(a, b);
+		std::swap(a, b);
+	});
+	logger->set_level(spdlog::level::info);
+
+	spdlog::shutdown();
+	return 0;
+}
@@ -0,0 +1,141 @@
+// The names of the keys and the buttons in gpmouse.toml: parse_vk_code()
+// and parse_button() on their perfect hashes, against the linear scans over
+// the upper-cased name they replaced. The tokens are those of a generated
+// configuration, in any case, with and without "VK_", and a few unknown.
+// config_bench loads a whole generated gpmouse.toml where the loader is built.
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+struct name_t
+{
+	std::string name;
+	uint16_t value;
+};
+
+std::string upper(std::string s)
+{
+	for (auto& c: s)
+		c = ascii_upper(c);
+	return s;
+}
+
+// as parse_vk_code() was: a scan for the name, then for "VK_" + the name.
+uint8_t scan_vk_code(const std::vector<name_t>& vks, const std::string& s)
+{
+	auto us = upper(s);
+	for (auto& vk: vks)
+		if (us == vk.name)
+			return (uint8_t)vk.value;
+
+	us = "VK_" + us;
+	for (auto& vk: vks)
+		if (us == vk.name)
+			return (uint8_t)vk.value;
+	return 0;
+}
+
+uint16_t scan_button(const std::vector<name_t>& buttons, const std::string& s)
+{
+	auto us = upper(s);
+	for (auto& b: buttons)
+		if (us == b.name)
+			return b.value;
+	return 0;
+}
+
+// s in random case.
+std::string mixed_case(std::string s, std::mt19937& random)
+{
+	for (auto& c: s)
+		if ('A' <= c && c <= 'Z' && random() % 2)
+			c = (char)(c - 'A' + 'a');
+	return s;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	std::vector<name_t> vks;
+	for (int vk = 0; vk < 256; ++vk)
+		if (*vk_name((uint8_t)vk) != '\0')
+			vks.push_back({ vk_name((uint8_t)vk), (uint16_t)vk });
+
+	std::vector<name_t> buttons = {
+		{ "UP", XINPUT_GAMEPAD_DPAD_UP }, { "DOWN", XINPUT_GAMEPAD_DPAD_DOWN },
+		{ "LEFT", XINPUT_GAMEPAD_DPAD_LEFT }, { "RIGHT", XINPUT_GAMEPAD_DPAD_RIGHT },
+		{ "START", XINPUT_GAMEPAD_START }, { "BACK", XINPUT_GAMEPAD_BACK },
+		{ "LT", XINPUT_GAMEPAD_LEFT_THUMB }, { "LEFT_THUMB", XINPUT_GAMEPAD_LEFT_THUMB },
+		{ "RT", XINPUT_GAMEPAD_RIGHT_THUMB }, { "RIGHT_THUMB", XINPUT_GAMEPAD_RIGHT_THUMB },
+		{ "LS", XINPUT_GAMEPAD_LEFT_SHOULDER }, { "LEFT_SHOULDER", XINPUT_GAMEPAD_LEFT_SHOULDER },
+		{ "RS", XINPUT_GAMEPAD_RIGHT_SHOULDER }, { "RIGHT_SHOULDER", XINPUT_GAMEPAD_RIGHT_SHOULDER },
+		{ "GUIDE", 0x0400 },	// XINPUT_GAMEPAD_GUIDE, defined in config.cpp
+		{ "A", XINPUT_GAMEPAD_A }, { "B", XINPUT_GAMEPAD_B }, { "X", XINPUT_GAMEPAD_X }, { "Y", XINPUT_GAMEPAD_Y },
+	};
+
+	// the tokens: 1 in 16 unknown, half of the keys without "VK_".
+	std::mt19937 random(2024);
+	std::vector<std::string> vk_tokens, button_tokens;
+	for (int i = 0; i < 4096; ++i) {
+		auto& vk = vks[random() % vks.size()].name;
+		auto name = random() % 2 ? vk : vk.substr(3);
+		vk_tokens.push_back(mixed_case(random() % 16 ? name : name + "_X", random));
+
+		auto& b = buttons[random() % buttons.size()].name;
+		button_tokens.push_back(mixed_case(random() % 16 ? b : b + "_X", random));
+	}
+
+	// both find the same values.
+	for (auto& t: vk_tokens) {
+		if (parse_vk_code(t) != scan_vk_code(vks, t)) {
+			fprintf(stderr, "parse_vk_code(\"%s\") differs from the scan\n", t.c_str());
+			return 1;
+		}
+	}
+	for (auto& t: button_tokens) {
+		if (parse_button(t) != scan_button(buttons, t)) {
+			fprintf(stderr, "parse_button(\"%s\") differs from the scan\n", t.c_str());
+			return 1;
+		}
+	}
+
+	run("parse_vk_code/perfect hash", [&]{
+		unsigned n = 0;
+		for (auto& t: vk_tokens)
+			n += parse_vk_code(t);
+		keep(n);
+	}, vk_tokens.size());
+	run("parse_vk_code/linear scan", [&]{
+		unsigned n = 0;
+		for (auto& t: vk_tokens)
+			n += scan_vk_code(vks, t);
+		keep(n);
+	}, vk_tokens.size());
+	run("parse_button/perfect hash", [&]{
+		unsigned n = 0;
+		for (auto& t: button_tokens)
+			n += parse_button(t);
+		keep(n);
+	}, button_tokens.size());
+	run("parse_button/linear scan", [&]{
+		unsigned n = 0;
+		for (auto& t: button_tokens)
+			n += scan_button(buttons, t);
+		keep(n);
+	}, button_tokens.size());
+	return 0;
+}
@@ -0,0 +1,154 @@
+// The handoff of a button state from the polling thread to the handler
+// thread: xinput_queue_t against a mutex and a condition variable around a
+// deque, the baseline of a general purpose queue. The latency is the time
+// from push to pop, with the handler spinning and with it sleeping.
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+#include "poll.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// The baseline.
+class mutex_queue_t
+{
+public:
+	void push(const xinput_t& v) {
+		{
+			std::lock_guard lock(_lock);
+			_items.push_back(v);
+		}
+		_ready.notify_one();
+	}
+	bool pop(xinput_t& v) {
+		std::lock_guard lock(_lock);
+		return take(v);
+	}
+	bool wait_pop(xinput_t& v) {
+		std::unique_lock lock(_lock);
+		_ready.wait_for(lock, std::chrono::milliseconds(1), [&]{ return !_items.empty(); });
+		return take(v);
+	}
+
+private:
+	bool take(xinput_t& v) {
+		if (_items.empty())
+			return false;
+		v = _items.front();
+		_items.pop_front();
+		return true;
+	}
+
+	std::mutex _lock;
+	std::condition_variable _ready;
+	std::deque<xinput_t> _items;
+};
+
+// yields, so the other thread runs even on a single core.
+void pause_for(uint64_t ns)
+{
+	auto until = now_ns() + ns;
+	while (now_ns() < until)
+		std::this_thread::yield();
+}
+
+// n states, one every gap, and the latency of each as the consumer sees it.
+template <typename Push, typename Pop>
+std::vector<double> handoff(int n, uint64_t gap, Push&& push, Pop&& pop)
+{
+	std::vector<double> latency;
+	latency.reserve(n);
+	std::atomic<bool> done = false;
+
+	std::thread consumer([&]{
+		xinput_t v;
+		while (!done.load(std::memory_order_acquire) || (int)latency.size() < n) {
+			if (pop(v))
+				latency.push_back((double)(uint32_t)((uint32_t)now_ns() - v.timestamp));
+			else if (done.load(std::memory_order_acquire))
+				break;
+			else
+				std::this_thread::yield();
+		}
+	});
+	for (int i = 0; i < n; ++i) {
+		pause_for(gap);
+		push(xinput_t{ 0, (uint32_t)now_ns(), (uint16_t)i, 0 });
+	}
+	// let the consumer take the last one.
+	pause_for(10 * 1000 * 1000);
+	done.store(true, std::memory_order_release);
+	consumer.join();
+	return latency;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	// one thread: the cost of a push and a pop.
+	{
+		xinput_queue_t queue;
+		xinput_t v = { 0, 0, 1, 0 };
+		run("xinput_queue_t/push+pop", [&]{
+			queue.push(v);
+			queue.pop(v);
+			keep(v);
+		});
+		mutex_queue_t baseline;
+		run("mutex queue/push+pop", [&]{
+			baseline.push(v);
+			baseline.pop(v);
+			keep(v);
+		});
+	}
+
+	// the handler spinning: the cost of the handoff itself.
+	{
+		xinput_queue_t queue;
+		percentiles("xinput_queue_t/spin", handoff(100000, 2000,
+			[&](const xinput_t& v) { queue.push(v); },
+			[&](xinput_t& v) { return queue.pop(v); }));
+		mutex_queue_t baseline;
+		percentiles("mutex queue/spin", handoff(100000, 2000,
+			[&](const xinput_t& v) { baseline.push(v); },
+			[&](xinput_t& v) { return baseline.pop(v); }));
+	}
+
+	// the handler sleeping until it is woken up, as it runs.
+	{
+		xinput_queue_t queue;
+		percentiles("xinput_queue_t/signal", handoff(20000, 50000,
+			[&](const xinput_t& v) {
+				queue.push(v);
+				queue.signal().notify();
+			},
+			[&](xinput_t& v) {
+				auto seen = queue.signal().value();
+				if (queue.pop(v))
+					return true;
+				queue.signal().wait(seen, 1);
+				return queue.pop(v);
+			}));
+		mutex_queue_t baseline;
+		percentiles("mutex queue/condition_variable", handoff(20000, 50000,
+			[&](const xinput_t& v) { baseline.push(v); },
+			[&](xinput_t& v) { return baseline.wait_pop(v); }));
+	}
+
+	return 0;
+}
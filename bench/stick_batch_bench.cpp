@@ -0,0 +1,105 @@
+// process_stick_batches() over a long session of 4 pads, with every kernel
+// the machine has, against stick_velocity() one sample at a time. The
+// kernels have to give the same velocities as the live path, bit for bit.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "config.h"
+#include "stick.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+constexpr size_t DEVICES = 4;
+constexpr size_t SAMPLES = 256 * 1024;	// per device, about 35 minutes at 8 ms
+
+struct session_t
+{
+	std::vector<int16_t> x, y;
+	std::vector<uint8_t> lt, rt;
+	std::vector<float> vx, vy;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+
+	stick_t cfg;
+	cfg.bake();
+
+	// the same random session every run.
+	std::mt19937 random(2024);
+	std::uniform_int_distribution<int> thumb(-32768, 32767);
+	std::uniform_int_distribution<int> trigger(0, 255);
+	std::vector<session_t> sessions(DEVICES);
+	std::vector<stick_batch_t> batches(DEVICES);
+	for (size_t d = 0; d < DEVICES; ++d) {
+		auto& s = sessions[d];
+		for (size_t i = 0; i < SAMPLES; ++i) {
+			s.x.push_back((int16_t)thumb(random));
+			s.y.push_back((int16_t)thumb(random));
+			// the triggers rest most of the time.
+			s.lt.push_back(i % 4 == 0 ? (uint8_t)trigger(random) : 0);
+			s.rt.push_back(i % 8 == 0 ? (uint8_t)trigger(random) : 0);
+		}
+		s.vx.resize(SAMPLES);
+		s.vy.resize(SAMPLES);
+		batches[d] = {
+			.cfg = &cfg,
+			.divisor = 1920,
+			.y_sign = -1,
+			.in = { SAMPLES, s.x.data(), s.y.data(), s.lt.data(), s.rt.data() },
+			.vx = s.vx.data(),
+			.vy = s.vy.data(),
+		};
+	}
+
+	// the live path, which the kernels are checked against.
+	std::vector<float> expected_x(DEVICES * SAMPLES), expected_y(DEVICES * SAMPLES);
+	auto live = [&]{
+		for (size_t d = 0; d < DEVICES; ++d) {
+			auto& s = sessions[d];
+			for (size_t i = 0; i < SAMPLES; ++i)
+				stick_velocity(cfg, 1920, -1, s.x[i], s.y[i], s.lt[i], s.rt[i],
+					expected_x[d * SAMPLES + i], expected_y[d * SAMPLES + i]);
+		}
+	};
+	live();
+	run("stick_velocity/sample", live, DEVICES * SAMPLES);
+
+	static const struct { simd_t simd; const char* name; } kernels[] = {
+		{ simd_t::scalar, "process_stick_batches/scalar" },
+		{ simd_t::sse41, "process_stick_batches/sse41" },
+		{ simd_t::avx2, "process_stick_batches/avx2" },
+	};
+	int mismatches = 0;
+	for (auto& k: kernels) {
+		if (k.simd > detect_simd())
+			continue;
+		process_stick_batches(batches.data(), batches.size(), k.simd);
+		for (size_t d = 0; d < DEVICES; ++d) {
+			auto& s = sessions[d];
+			if (memcmp(s.vx.data(), &expected_x[d * SAMPLES], SAMPLES * sizeof(float)) != 0 ||
+				memcmp(s.vy.data(), &expected_y[d * SAMPLES], SAMPLES * sizeof(float)) != 0) {
+				fprintf(stderr, "%s: the velocities of device %zu differ from stick_velocity()\n", k.name, d);
+				++mismatches;
+			}
+		}
+		run(k.name, [&]{
+			process_stick_batches(batches.data(), batches.size(), k.simd);
+			keep(sessions);
+		}, DEVICES * SAMPLES);
+	}
+
+	return mismatches != 0;
+}
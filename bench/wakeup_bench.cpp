@@ -0,0 +1,108 @@
+// Press-to-emit latency of the handler thread: from the push of a button
+// state to the send() of its key. Before, the handler woke up every
+// 1000/16 ms to look at the queue; now the polling thread wakes it up with
+// the signal of the queue, as handle_xinput in gpmouse.cpp does.
+#include <stdint.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "settings.h"
+#include "engine.h"
+#include "poll.h"
+#include "process.h"
+#include "queue.h"
+
+#include "bench.h"
+
+using namespace gpmouse;
+using namespace gpmouse::bench;
+
+namespace {
+
+// the timed wait of the handler thread before it was woken up by the queue.
+constexpr uint32_t HANDLE_INTERVAL = 1000 / 16;	// [ms]
+
+// When each send() happens.
+class timing_sink_t: public output_sink_t
+{
+public:
+	explicit timing_sink_t(size_t n) { sent.reserve(n); }
+	UINT send(UINT n, INPUT*) override {
+		sent.push_back(now_ns());
+		count.store(sent.size(), std::memory_order_release);
+		return n;
+	}
+
+	std::vector<uint64_t> sent;
+	std::atomic<size_t> count = 0;
+};
+
+// presses and releases of A, one every gap on average; each sends one key.
+std::vector<double> measure(bool event_driven, int n, uint64_t gap)
+{
+	settings_t s;
+	default_config(s);
+	xinput_queue_t queue;
+	signal_t stop;
+	timing_sink_t sink(n);
+
+	std::thread handler_thread([&]{
+		no_window_system_t windows;
+		process_cache_t processes(windows);
+		button_handler_t handler(sink, processes);
+		auto& signal = queue.signal();
+		auto stopped = stop.value();
+		xinput_t input;
+		while (stop.value() == stopped) {
+			auto seen = signal.value();
+			auto now = now_ns() / 1000000;
+			handler.repeat(now);
+			while (queue.pop(input))
+				handler.handle(s, input, now);
+
+			if (!event_driven) {
+				stop.wait(stopped, HANDLE_INTERVAL);
+				continue;
+			}
+			auto deadline = handler.next_deadline();
+			auto timeout = deadline == repeat_scheduler_t::NEVER ? signal_t::INFINITE_WAIT
+				: (uint32_t)(deadline - std::min<uint64_t>(deadline, now_ns() / 1000000));
+			signal.wait(seen, timeout);
+		}
+	});
+
+	// the same jittered gaps every run.
+	std::mt19937 random(2024);
+	std::uniform_int_distribution<uint64_t> jitter(gap / 2, gap * 3 / 2);
+	std::vector<uint64_t> pushed(n);
+	for (int i = 0; i < n; ++i) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(jitter(random)));
+		pushed[i] = now_ns();
+		queue.push({ 0, (uint32_t)pushed[i], (uint16_t)(i % 2 ? 0 : XINPUT_GAMEPAD_A), 0 });
+		queue.signal().notify();
+	}
+	auto deadline = now_ns() + 2000ull * 1000 * 1000;
+	while (sink.count.load(std::memory_order_acquire) < (size_t)n && now_ns() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	stop.notify();
+	queue.signal().notify();
+	handler_thread.join();
+
+	std::vector<double> latency;
+	for (size_t i = 0; i < sink.sent.size() && i < pushed.size(); ++i)
+		latency.push_back((double)(sink.sent[i] - pushed[i]));
+	return latency;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	init(argc, argv);
+	percentiles("timed wait (62 ms)", measure(false, 200, 10 * 1000 * 1000));
+	percentiles("woken up by the queue", measure(true, 2000, 1000 * 1000));
+	return 0;
+}
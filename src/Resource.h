@@ -6,3 +6,4 @@
 #define IDI_ICON1                               106
 #define IDM_QUIT                                40000
 #define IDM_RELOAD                              40001
+#define IDM_LATENCY                             40002
@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <new>
+
+#include "alloc.h"
+
+
+#ifdef GPMOUSE_TRACK_ALLOCATIONS
+
+namespace {
+
+thread_local uint64_t t_allocations = 0;
+thread_local uint64_t t_allowed = 0;
+thread_local int t_allow_depth = 0;
+
+void* allocate(size_t size)
+{
+	++t_allocations;
+	if (auto p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* allocate(size_t size, std::align_val_t align)
+{
+	++t_allocations;
+#ifdef _MSC_VER
+	if (auto p = _aligned_malloc(size ? size : 1, (size_t)align))
+		return p;
+#else
+	if (auto p = aligned_alloc((size_t)align, ((size ? size : 1) + (size_t)align - 1) & ~((size_t)align - 1)))
+		return p;
+#endif
+	throw std::bad_alloc();
+}
+
+void deallocate(void* p, std::align_val_t)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+} // namespace
+
+namespace gpmouse
+{
+
+uint64_t thread_allocations()
+{
+	return t_allocations;
+}
+
+uint64_t thread_allowed_allocations()
+{
+	return t_allowed;
+}
+
+allow_alloc_scope_t::allow_alloc_scope_t():
+	_start(t_allocations)
+{
+	++t_allow_depth;
+}
+
+allow_alloc_scope_t::~allow_alloc_scope_t()
+{
+	if (--t_allow_depth == 0)
+		t_allowed += t_allocations - _start;
+}
+
+} // namespace gpmouse
+
+// The array and nothrow forms of the standard library call these.
+void* operator new(size_t size) { return allocate(size); }
+void* operator new(size_t size, std::align_val_t align) { return allocate(size, align); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t align) noexcept { deallocate(p, align); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { deallocate(p, align); }
+
+#endif // def GPMOUSE_TRACK_ALLOCATIONS
@@ -0,0 +1,75 @@
+#ifndef GPMOUSE_ALLOC_H
+#define GPMOUSE_ALLOC_H
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+
+namespace gpmouse
+{
+
+// Allocations are counted in debug builds, and in the builds which define
+// GPMOUSE_TRACK_ALLOCATIONS, as the Linux build does for its tests.
+#if defined(_DEBUG) && !defined(GPMOUSE_TRACK_ALLOCATIONS)
+#	define GPMOUSE_TRACK_ALLOCATIONS
+#endif
+
+#ifdef GPMOUSE_TRACK_ALLOCATIONS
+
+// Number of operator new calls made by the calling thread.
+uint64_t thread_allocations();
+// Of those, the calls made in an allow_alloc_scope_t.
+uint64_t thread_allowed_allocations();
+
+// Asserts that the calling thread does not allocate until the end of the
+// scope, but in the allow_alloc_scope_t within it.
+class no_alloc_scope_t
+{
+public:
+	no_alloc_scope_t(): _start(counted()) {}
+	~no_alloc_scope_t() {
+		assert(counted() == _start && "the input path allocated");
+	}
+
+	no_alloc_scope_t(const no_alloc_scope_t&) = delete;
+	no_alloc_scope_t& operator=(const no_alloc_scope_t&) = delete;
+
+private:
+	static uint64_t counted() {
+		return thread_allocations() - thread_allowed_allocations();
+	}
+
+	uint64_t _start;
+};
+
+// What may allocate on the input path: the sink, the log, and the caches
+// when they miss. Nested scopes count once.
+class allow_alloc_scope_t
+{
+public:
+	allow_alloc_scope_t();
+	~allow_alloc_scope_t();
+
+	allow_alloc_scope_t(const allow_alloc_scope_t&) = delete;
+	allow_alloc_scope_t& operator=(const allow_alloc_scope_t&) = delete;
+
+private:
+	uint64_t _start;
+};
+
+#else
+
+class no_alloc_scope_t
+{
+};
+
+class allow_alloc_scope_t
+{
+};
+
+#endif
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_ALLOC_H
@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+
+#include "apps.h"
+#include "alloc.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// Forget the memoized names past this, e.g. with a lot of short lived processes.
+constexpr size_t MAX_MEMO = 1024;
+
+constexpr auto REGEX_FLAGS = std::regex_constants::ECMAScript|std::regex_constants::icase;
+
+char to_lower(char c)
+{
+	return 'A' <= c && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// Unescapes a pattern which matches exactly one string.
+// Returns false if the pattern has any operator.
+bool literal_pattern(const std::string& pattern, std::string& literal)
+{
+	literal.clear();
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		auto c = pattern[i];
+		if (c == '\\') {
+			if (++i == pattern.size())
+				return false;
+			c = pattern[i];
+			// \d, \w, \b, \x41 and so on are not literals.
+			if (('0' <= c && c <= '9') || ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z'))
+				return false;
+		}
+		else if (strchr(".[](){}*+?|^$", c) != nullptr)
+			return false;
+		literal.push_back(to_lower(c));
+	}
+	return true;
+}
+
+} // namespace
+
+app_id_t app_matcher_t::add(const std::string& name, const std::string& pattern)
+{
+	return add(name, pattern, true);
+}
+
+app_id_t app_matcher_t::restore(const std::string& name, const std::string& pattern)
+{
+	return add(name, pattern, false);
+}
+
+app_id_t app_matcher_t::add(const std::string& name, const std::string& pattern, bool compile)
+{
+	if (_names.size() >= NO_APP)
+		throw std::runtime_error("too many applications");
+
+	auto id = (app_id_t)_names.size();
+	std::string literal;
+	if (literal_pattern(pattern, literal))
+		_literals[literal].push_back(id);
+	else if (compile)
+		_patterns.push_back({ id, true, std::regex(pattern, REGEX_FLAGS) });
+	else
+		_patterns.push_back({ id, false, std::regex() });
+	_names.push_back(name);
+	_sources.push_back(pattern);
+	// the sets have one more bit now.
+	_memo.clear();
+	_sets.clear();
+	return id;
+}
+
+void app_matcher_t::clear()
+{
+	_names.clear();
+	_sources.clear();
+	_literals.clear();
+	_patterns.clear();
+	_memo.clear();
+	_sets.clear();
+}
+
+const app_set_t& app_matcher_t::match(std::string_view executable)
+{
+	auto m = _memo.find(executable);
+	if (m != _memo.end()) {
+		++_stats.hits;
+		return *m->second;
+	}
+
+	++_stats.misses;
+	allow_alloc_scope_t miss;
+	if (_memo.size() >= MAX_MEMO)
+		_memo.clear();
+	auto& set = *_sets.insert(evaluate(executable)).first;
+	_memo.emplace(executable, &set);
+	return set;
+}
+
+app_set_t app_matcher_t::evaluate(std::string_view executable)
+{
+	app_set_t apps(_names.size());
+
+	std::string key(executable);
+	for (auto& c: key)
+		c = to_lower(c);
+	auto l = _literals.find(key);
+	if (l != _literals.end()) {
+		for (auto id: l->second)
+			apps.set(id);
+	}
+
+	for (auto& p: _patterns) {
+		if (!p.compiled) {
+			p.compiled = true;
+			try {
+				p.regex.assign(_sources[p.id], REGEX_FLAGS);
+			}
+			catch (std::regex_error&) {
+				p.regex.assign("[^\\s\\S]"); // matches nothing
+			}
+		}
+		if (std::regex_match(executable.begin(), executable.end(), p.regex))
+			apps.set(p.id);
+	}
+	return apps;
+}
+
+} // namespace gpmouse
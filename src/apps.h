@@ -0,0 +1,104 @@
+#ifndef GPMOUSE_APPS_H
+#define GPMOUSE_APPS_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+
+
+namespace gpmouse
+{
+
+using app_id_t = uint16_t;
+constexpr app_id_t NO_APP = UINT16_MAX;
+
+// Set of app ids.
+class app_set_t
+{
+public:
+	app_set_t() = default;
+	explicit app_set_t(size_t n): _bits((n + 63) / 64) {}
+
+	bool test(app_id_t id) const {
+		return (size_t)(id >> 6) < _bits.size() && (_bits[id >> 6] >> (id & 63)) & 1;
+	}
+	void set(app_id_t id) {
+		_bits[id >> 6] |= 1ull << (id & 63);
+	}
+	auto operator<=>(const app_set_t&) const = default;
+	const std::vector<uint64_t>& bits() const { return _bits; }
+
+private:
+	std::vector<uint64_t> _bits;
+};
+
+// Matches an executable name against the patterns of every application at once.
+// Patterns follow std::regex_match with ECMAScript|icase, as before. Patterns
+// which are plain names (e.g. "notepad\.exe") are looked up in a hash table,
+// the others are tried one by one, and the resulting set is memoized per
+// executable name, so a name is matched only once until the next configure().
+// The sets are kept once each, for as long as the applications, so a memo hit
+// neither allocates nor copies.
+// Applications restored from the config cache compile their regex on the
+// first match instead of at load.
+class app_matcher_t
+{
+public:
+	struct stats_t
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
+	// throws std::regex_error if the pattern is malformed.
+	app_id_t add(const std::string& name, const std::string& pattern);
+	// for a pattern add() has accepted before. a malformed one never matches.
+	app_id_t restore(const std::string& name, const std::string& pattern);
+	void clear();
+
+	size_t size() const { return _names.size(); }
+	const std::string& name(app_id_t id) const { return _names[id]; }
+	const std::string& pattern(app_id_t id) const { return _sources[id]; }
+
+	// called from the handler thread only. The set stays valid until add()
+	// or clear(), even when the memo is dropped for growing too large.
+	const app_set_t& match(std::string_view executable);
+
+	const stats_t& stats() const { return _stats; }
+
+private:
+	struct pattern_t
+	{
+		app_id_t id;
+		bool compiled;
+		std::regex regex;
+	};
+
+	app_id_t add(const std::string& name, const std::string& pattern, bool compile);
+	app_set_t evaluate(std::string_view executable);
+
+	// finds the memo of a name without making a std::string of it.
+	struct name_hash_t
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+	};
+
+	std::vector<std::string> _names;
+	std::vector<std::string> _sources;
+	std::unordered_map<std::string, std::vector<app_id_t>> _literals; // lower case name -> apps
+	std::vector<pattern_t> _patterns;
+	std::set<app_set_t> _sets;	// every set a name has matched
+	std::unordered_map<std::string, const app_set_t*, name_hash_t, std::equal_to<>> _memo;
+	stats_t _stats;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_APPS_H
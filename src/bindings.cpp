@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+
+#include "bindings.h"
+#include "alloc.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+constexpr size_t BUTTON_MASKS = 1 << 16;
+
+// Past this, drop every profile instead of keeping them all.
+constexpr size_t MAX_PROFILES = 64;
+
+const keystate_t NO_KEYS = {};
+
+} // namespace
+
+binding_table_t::binding_table_t():
+	_offsets(BUTTON_MASKS + 1, 0)
+{
+}
+
+void binding_table_t::build(const std::vector<key_binding_t>& bindings, const key_binding_t (&single_button)[16])
+{
+	// counting sort on the button mask, stable.
+	std::fill(_offsets.begin(), _offsets.end(), 0);
+	for (auto& b: bindings)
+		++_offsets[b.buttons + 1];
+	for (size_t i = 1; i <= BUTTON_MASKS; ++i)
+		_offsets[i] += _offsets[i - 1];
+
+	_hot.assign(bindings.size(), {});
+	_keys.assign(bindings.size(), {});
+	_cold.assign(bindings.size(), {});
+
+	std::vector<uint32_t> next(_offsets.begin(), _offsets.end() - 1);
+	for (auto& b: bindings) {
+		auto i = next[b.buttons]++;
+		_hot[i] = { b.app, b.flags };
+		b.fill(_keys[i]);
+		_cold[i] = b;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		_single[i] = {};
+		single_button[i].fill(_single[i]);
+	}
+}
+
+keystate_t binding_table_t::combine(uint16_t buttons) const
+{
+	keystate_t keys = {};
+	for (int i = 0; buttons != 0; ++i, buttons >>= 1) {
+		if (buttons & 1)
+			keys |= _single[i];
+	}
+	return keys;
+}
+
+binding_profile_t::binding_profile_t(const binding_table_t& table, const app_set_t& cursor, const app_set_t& foreground):
+	_table(&table),
+	_keys(table.size(), nullptr)
+{
+	for (uint32_t buttons = 0; buttons < BUTTON_MASKS; ++buttons) {
+		auto candidates = table.candidates((uint16_t)buttons);
+		if (candidates.empty())
+			continue;
+
+		// the first binding whose application matches, nothing if none does.
+		const keystate_t* keys = &NO_KEYS;
+		for (auto& c: candidates) {
+			auto& apps = c.foreground_window() ? foreground : cursor;
+			if (c.app == NO_APP || apps.test(c.app)) {
+				keys = &table.keys(c);
+				break;
+			}
+		}
+		_keys[table.offset((uint16_t)buttons)] = keys;
+	}
+}
+
+size_t binding_profiles_t::key_hash_t::operator()(const std::vector<uint64_t>& key) const
+{
+	// FNV-1a over the words
+	uint64_t h = 14695981039346656037ull;
+	for (auto w: key) {
+		h ^= w;
+		h *= 1099511628211ull;
+	}
+	return (size_t)h;
+}
+
+const binding_profile_t& binding_profiles_t::select(const app_set_t& cursor, const app_set_t& foreground)
+{
+	if (!_active) {
+		// sizes the buffers below. The sets of one configuration all have
+		// the same size, so the later lookups reuse them.
+		allow_alloc_scope_t first;
+		return find(cursor, foreground);
+	}
+	if (cursor == _cursor && foreground == _foreground)
+		return *_active;
+	return find(cursor, foreground);
+}
+
+const binding_profile_t& binding_profiles_t::find(const app_set_t& cursor, const app_set_t& foreground)
+{
+	_key.assign(1, cursor.bits().size());
+	_key.insert(_key.end(), cursor.bits().begin(), cursor.bits().end());
+	_key.insert(_key.end(), foreground.bits().begin(), foreground.bits().end());
+
+	auto p = _profiles.find(_key);
+	if (p == _profiles.end()) {
+		allow_alloc_scope_t miss;
+		if (_profiles.size() >= MAX_PROFILES)
+			_profiles.clear();
+		p = _profiles.emplace(_key, std::make_unique<binding_profile_t>(*_table, cursor, foreground)).first;
+	}
+
+	_active = p->second.get();
+	_cursor = cursor;
+	_foreground = foreground;
+	return *_active;
+}
+
+void binding_profiles_t::clear()
+{
+	_profiles.clear();
+	_active = nullptr;
+}
+
+} // namespace gpmouse
@@ -0,0 +1,114 @@
+#ifndef GPMOUSE_BINDINGS_H
+#define GPMOUSE_BINDINGS_H
+#pragma once
+
+#include <stdint.h>
+#include <span>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "config.h"
+
+
+namespace gpmouse
+{
+
+// Key bindings indexed by the 16 bit button mask.
+// candidates(buttons) is one load from a dense offset table, and the
+// candidates of a mask are contiguous. The fields tested while selecting a
+// binding are kept apart from the keys it sends and from the binding itself,
+// so a lookup touches one or two cache lines.
+class binding_table_t
+{
+public:
+	struct candidate_t
+	{
+		app_id_t app = NO_APP;
+		uint8_t flags = 0;
+
+		bool foreground_window() const {
+			return flags & key_binding_t::FOREGROUND_WINDOW;
+		}
+	};
+
+	binding_table_t();
+
+	// bindings of the same buttons keep their order, i.e. their priority.
+	// single_button is used for the combinations without a binding.
+	void build(const std::vector<key_binding_t>& bindings, const key_binding_t (&single_button)[16]);
+
+	std::span<const candidate_t> candidates(uint16_t buttons) const {
+		return { _hot.data() + _offsets[buttons], _hot.data() + _offsets[buttons + 1] };
+	}
+	const keystate_t& keys(const candidate_t& c) const {
+		return _keys[&c - _hot.data()];
+	}
+	const key_binding_t& binding(const candidate_t& c) const {
+		return _cold[&c - _hot.data()];
+	}
+	// index of the first candidate of buttons.
+	uint32_t offset(uint16_t buttons) const {
+		return _offsets[buttons];
+	}
+	// keys of a combination without a binding: the single buttons put together.
+	keystate_t combine(uint16_t buttons) const;
+
+	size_t size() const { return _hot.size(); }
+
+private:
+	std::vector<uint32_t> _offsets;		// 65537 entries
+	std::vector<candidate_t> _hot;
+	std::vector<keystate_t> _keys;		// key_binding_t::fill() of each binding
+	std::vector<key_binding_t> _cold;
+	keystate_t _single[16];
+};
+
+// Keys of every combination of buttons, resolved for one pair of
+// (applications under the cursor, applications of the foreground window).
+class binding_profile_t
+{
+public:
+	binding_profile_t(const binding_table_t& table, const app_set_t& cursor, const app_set_t& foreground);
+
+	keystate_t resolve(uint16_t buttons) const {
+		if (_table->candidates(buttons).empty())
+			return _table->combine(buttons);
+		return *_keys[_table->offset(buttons)];
+	}
+
+private:
+	const binding_table_t* _table;
+	// indexed by the offset of the first candidate, the other entries are unused.
+	std::vector<const keystate_t*> _keys;
+};
+
+// Profiles built so far. The handler thread keeps the active one and only
+// looks another one up when the applications change.
+class binding_profiles_t
+{
+public:
+	explicit binding_profiles_t(const binding_table_t& table): _table(&table) {}
+
+	const binding_profile_t& select(const app_set_t& cursor, const app_set_t& foreground);
+	void clear();
+
+private:
+	const binding_profile_t& find(const app_set_t& cursor, const app_set_t& foreground);
+
+	struct key_hash_t
+	{
+		size_t operator()(const std::vector<uint64_t>& key) const;
+	};
+
+	const binding_table_t* _table;
+	std::unordered_map<std::vector<uint64_t>, std::unique_ptr<binding_profile_t>, key_hash_t> _profiles;
+	const binding_profile_t* _active = nullptr;
+	std::vector<uint64_t> _key;		// reused by every lookup
+	app_set_t _cursor;
+	app_set_t _foreground;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_BINDINGS_H
@@ -0,0 +1,391 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <filesystem>
+#include <type_traits>
+
+#include "platform.h"
+#if defined(__linux__)
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include "cache.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+constexpr char MAGIC[4] = { 'G', 'P', 'M', 'C' };
+constexpr uint32_t FORMAT_VERSION = 3;
+
+struct header_t
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;		// of the payload after the header
+	uint64_t checksum;	// of the payload
+};
+
+static_assert(std::is_trivially_copyable_v<key_binding_t>);
+static_assert(std::is_trivially_copyable_v<stick_params_t>);
+static_assert(std::is_trivially_copyable_v<polling_t>);
+static_assert(std::is_trivially_copyable_v<repeat_config_t>);
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+{
+	auto p = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i) {
+		h ^= p[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+template <typename T>
+uint64_t hash_value(const T& v, uint64_t h)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	return fnv1a(&v, sizeof(v), h);
+}
+
+class writer_t
+{
+public:
+	template <typename T>
+	void put(const T& v) {
+		put(&v, 1);
+	}
+	template <typename T>
+	void put(const T* v, size_t n) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		auto p = (const uint8_t*)v;
+		_data.insert(_data.end(), p, p + sizeof(T) * n);
+	}
+	void put(const std::string& s) {
+		put((uint32_t)s.size());
+		put(s.data(), s.size());
+	}
+
+	std::vector<uint8_t>& data() { return _data; }
+
+private:
+	std::vector<uint8_t> _data;
+};
+
+// Reads what writer_t wrote. Once a read runs past the end, every read fails.
+// The data may be unaligned, so values are copied out instead of cast.
+class reader_t
+{
+public:
+	reader_t(const uint8_t* data, size_t size): _p(data), _end(data + size) {}
+
+	template <typename T>
+	bool get(T& v) {
+		return get(&v, 1);
+	}
+	template <typename T>
+	bool get(T* v, size_t n) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		if (!_p || (size_t)(_end - _p) / sizeof(T) < n)
+			return fail();
+		if (n != 0)	// an empty vector may have no data
+			memcpy(v, _p, sizeof(T) * n);
+		_p += sizeof(T) * n;
+		return true;
+	}
+	bool get(std::string& s) {
+		uint32_t n;
+		if (!get(n) || (size_t)(_end - _p) < n)
+			return fail();
+		s.assign((const char*)_p, n);
+		_p += n;
+		return true;
+	}
+	template <typename T>
+	bool get(std::vector<T>& v) {
+		uint32_t n;
+		if (!get(n) || (size_t)(_end - _p) / sizeof(T) < n)
+			return fail();
+		v.resize(n);
+		return get(v.data(), n);
+	}
+
+	bool done() const { return _p == _end; }
+
+private:
+	bool fail() {
+		_p = nullptr;
+		return false;
+	}
+
+	const uint8_t* _p;
+	const uint8_t* _end;
+};
+
+} // namespace
+
+uint64_t settings_cache_key(std::string_view source)
+{
+	auto h = fnv1a(source.data(), source.size());
+	h = hash_value(FORMAT_VERSION, h);
+	// a build with another layout of the settings must not read this one.
+	h = hash_value(sizeof(key_binding_t), h);
+	h = hash_value(sizeof(stick_params_t), h);
+	h = hash_value(sizeof(polling_t), h);
+	h = hash_value(sizeof(repeat_config_t), h);
+	// repeat settings not in the file are taken from the control panel.
+	h = hash_value(default_repeat(), h);
+	return h;
+}
+
+std::vector<uint8_t> serialize_settings(const settings_t& s, uint64_t key)
+{
+	writer_t w;
+	w.put(header_t{});
+
+	w.put(s.log.directory);
+	w.put((uint64_t)s.log.max_size);
+	w.put((uint64_t)s.log.max_files);
+	w.put(s.log.level);
+	w.put(s.log.pattern);
+
+	w.put((uint32_t)s.app_matcher.size());
+	for (app_id_t id = 0; id < s.app_matcher.size(); ++id) {
+		w.put(s.app_matcher.name(id));
+		w.put(s.app_matcher.pattern(id));
+	}
+
+	w.put((uint32_t)s.controllers.size());
+	for (auto& c: s.controllers) {
+		w.put(c->name);
+		w.put((uint32_t)c->key_bindings.size());
+		w.put(c->key_bindings.data(), c->key_bindings.size());
+		w.put(c->single_button, std::size(c->single_button));
+		w.put(c->stick_params);
+	}
+	w.put((uint32_t)s.controller_matches.size());
+	for (auto& m: s.controller_matches) {
+		w.put(m.controller);
+		w.put((uint32_t)m.ids.size());
+		w.put(m.ids.data(), m.ids.size());
+		w.put((uint32_t)m.keys.size());
+		for (auto& k: m.keys)
+			w.put(k);
+	}
+	w.put(s.polling);
+	w.put(s.repeat);
+
+	w.put((uint32_t)s.app_repeats.size());
+	for (auto& [id, repeat]: s.app_repeats) {
+		w.put(id);
+		w.put(repeat);
+	}
+
+	auto& data = w.data();
+	header_t header = {
+		{ MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3] },
+		FORMAT_VERSION,
+		key,
+		data.size() - sizeof(header_t),
+		fnv1a(data.data() + sizeof(header_t), data.size() - sizeof(header_t)),
+	};
+	memcpy(data.data(), &header, sizeof(header));
+	return std::move(data);
+}
+
+std::unique_ptr<settings_t> deserialize_settings(const uint8_t* data, size_t size, uint64_t key)
+{
+	header_t header;
+	if (size < sizeof(header))
+		return nullptr;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.version != FORMAT_VERSION
+		|| header.key != key
+		|| header.size != size - sizeof(header)
+		|| header.checksum != fnv1a(data + sizeof(header), header.size))
+		return nullptr;
+
+	auto s = std::make_unique<settings_t>();
+	reader_t r(data + sizeof(header), header.size);
+
+	uint64_t max_size = 0, max_files = 0;
+	if (!r.get(s->log.directory) || !r.get(max_size) || !r.get(max_files)
+		|| !r.get(s->log.level) || !r.get(s->log.pattern))
+		return nullptr;
+	s->log.max_size = (size_t)max_size;
+	s->log.max_files = (size_t)max_files;
+
+	uint32_t apps = 0;
+	if (!r.get(apps) || apps > NO_APP)
+		return nullptr;
+	std::string name, pattern;
+	for (uint32_t i = 0; i < apps; ++i) {
+		if (!r.get(name) || !r.get(pattern))
+			return nullptr;
+		s->app_matcher.restore(name, pattern);
+	}
+
+	uint32_t controllers = 0;
+	if (!r.get(controllers) || controllers == 0 || controllers > MAX_CONTROLLERS)
+		return nullptr;
+	s->controllers.resize(controllers);
+	for (auto& c: s->controllers) {
+		if (!c)
+			c = std::make_unique<controller_profile_t>();
+		r.get(c->name);
+		r.get(c->key_bindings);
+		r.get(c->single_button, std::size(c->single_button));
+		r.get(c->stick_params);
+	}
+	uint32_t matches = 0;
+	if (!r.get(matches) || matches > MAX_CONTROLLERS)
+		return nullptr;
+	s->controller_matches.resize(matches);
+	for (auto& m: s->controller_matches) {
+		uint32_t keys = 0;
+		// every key takes at least its length.
+		if (!r.get(m.controller) || !r.get(m.ids) || !r.get(keys) || keys > header.size / sizeof(uint32_t))
+			return nullptr;
+		m.keys.resize(keys);
+		for (auto& k: m.keys)
+			if (!r.get(k))
+				return nullptr;
+	}
+	r.get(s->polling);
+	r.get(s->repeat);
+
+	uint32_t n = 0;
+	r.get(n);
+	for (uint32_t i = 0; i < n; ++i) {
+		app_id_t id;
+		repeat_config_t repeat;
+		if (!r.get(id) || !r.get(repeat))
+			return nullptr;
+		s->app_repeats.emplace_back(id, repeat);
+	}
+
+	if (!r.done())
+		return nullptr;
+
+	// ids out of range would index past the application tables.
+	for (auto& c: s->controllers)
+		for (auto& k: c->key_bindings)
+			if (k.app != NO_APP && k.app >= apps)
+				return nullptr;
+	for (auto& [id, repeat]: s->app_repeats)
+		if (id >= apps)
+			return nullptr;
+	for (auto& m: s->controller_matches)
+		if (m.controller >= controllers)
+			return nullptr;
+
+	for (auto& c: s->controllers)
+		c->binding_table.build(c->key_bindings, c->single_button);
+	return s;
+}
+
+#if defined(_WIN32)
+
+bool save_settings_cache(const std::wstring& path, const settings_t& s, uint64_t key)
+{
+	auto data = serialize_settings(s, key);
+
+	// written aside and renamed, so a reader never maps a half written cache.
+	auto tmp = path + L".tmp";
+	auto file = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		get_logger()->warn("failed to create the config cache: {}", GetLastError());
+		return false;
+	}
+
+	DWORD written = 0;
+	auto ok = WriteFile(file, data.data(), (DWORD)data.size(), &written, nullptr) && written == data.size();
+	CloseHandle(file);
+	if (ok)
+		ok = MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+	if (!ok) {
+		get_logger()->warn("failed to write the config cache: {}", GetLastError());
+		DeleteFileW(tmp.c_str());
+	}
+	return ok;
+}
+
+std::unique_ptr<settings_t> load_settings_cache(const std::wstring& path, uint64_t key)
+{
+	auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	std::unique_ptr<settings_t> s;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(header_t) && size.QuadPart < UINT32_MAX) {
+		auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping) {
+			auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (view) {
+				s = deserialize_settings((const uint8_t*)view, (size_t)size.QuadPart, key);
+				UnmapViewOfFile(view);
+			}
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+	return s;
+}
+
+#else
+
+bool save_settings_cache(const std::wstring& path, const settings_t& s, uint64_t key)
+{
+	auto data = serialize_settings(s, key);
+
+	// written aside and renamed, so a reader never maps a half written cache.
+	auto target = file_path(path);
+	auto tmp = file_path(path + L".tmp");
+	auto fd = open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644);
+	if (fd < 0) {
+		get_logger()->warn("failed to create the config cache: {}", errno);
+		return false;
+	}
+
+	auto ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+	ok = close(fd) == 0 && ok;
+	if (ok)
+		ok = rename(tmp.c_str(), target.c_str()) == 0;
+	if (!ok) {
+		get_logger()->warn("failed to write the config cache: {}", errno);
+		unlink(tmp.c_str());
+	}
+	return ok;
+}
+
+std::unique_ptr<settings_t> load_settings_cache(const std::wstring& path, uint64_t key)
+{
+	auto fd = open(file_path(path).c_str(), O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+
+	std::unique_ptr<settings_t> s;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(header_t) && st.st_size < UINT32_MAX) {
+		auto view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			s = deserialize_settings((const uint8_t*)view, (size_t)st.st_size, key);
+			munmap(view, (size_t)st.st_size);
+		}
+	}
+	close(fd);
+	return s;
+}
+
+#endif
+
+} // namespace gpmouse
@@ -0,0 +1,37 @@
+#ifndef GPMOUSE_CACHE_H
+#define GPMOUSE_CACHE_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "settings.h"
+
+
+namespace gpmouse
+{
+
+// Binary form of a loaded settings_t, written next to gpmouse.toml so that
+// an unchanged file is neither parsed nor sorted again.
+// The cache is keyed by settings_cache_key() of the TOML text; a cache made
+// from another text, by another build or with a broken checksum is ignored.
+
+// Hash of the TOML text, the cache format and the system defaults the loader uses.
+uint64_t settings_cache_key(std::string_view source);
+
+std::vector<uint8_t> serialize_settings(const settings_t& s, uint64_t key);
+// Returns nullptr if data is not a valid cache for key.
+std::unique_ptr<settings_t> deserialize_settings(const uint8_t* data, size_t size, uint64_t key);
+
+// Failures are logged and otherwise ignored; the TOML is the source of truth.
+bool save_settings_cache(const std::wstring& path, const settings_t& s, uint64_t key);
+// Maps the file and deserializes it. nullptr if missing, stale or corrupt.
+std::unique_ptr<settings_t> load_settings_cache(const std::wstring& path, uint64_t key);
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_CACHE_H
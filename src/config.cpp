@@ -1,31 +1,25 @@
-#include <windows.h>
-#include <xinput.h>
+#include "platform.h"
 #include <stdint.h>
+#include <string.h>
 
 #include <iterator>
 #include <vector>
 #include <filesystem>
+#include <regex>
 #include <cassert>
 #include <cstdlib>
 #include <stdexcept>
 
-#define TOML_TOML11
-#ifdef TOML_TOML11
-	#include <toml.hpp>
-#else
-	#include <toml++/toml.hpp>
-#endif // def TOML_TOML11
-
-#include <magic_enum.hpp>
+#include <spdlog/async.h>
 #include <spdlog/sinks/rotating_file_sink.h>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
+#include <fmt/format.h>
 
 #include "config.h"
+#include "bindings.h"
+#include "settings.h"
 
 
 #define XINPUT_GAMEPAD_GUIDE 0x0400
-#define MAX_PATH_LENGTH 32767
 
 
 namespace gpmouse
@@ -333,35 +327,65 @@ const char* vk_name(uint8_t vk)
 	return virtual_key_codes[vk].name;
 }
 
-std::vector<key_binding_t> g_key_bindings;
-key_binding_t g_single_button[16];
-stick_params_t g_stick_params[XUSER_MAX_COUNT];
+float trigger_config_t::evaluate(uint8_t x) const
+{
+	if (x <= deadzone)
+		return minval;
+	if (x >= saturation)
+		return maxval;
+
+	double t = double(x - deadzone) / (saturation - deadzone);
+	switch (type) {
+	case analog_function_t::step:
+		return maxval;
+	case analog_function_t::exp:
+		if (minval > 0 && maxval > 0)
+			return (float)(minval * pow((double)maxval / minval, t));
+		break;
+	case analog_function_t::log:
+		return (float)(minval + (maxval - minval) * log1p(9 * t) / log(10.));
+	default:
+		break;
+	}
+	return (float)(minval + (maxval - minval) * t);
+}
 
-//std::vector<std::regex> g_apps;
-struct app_t {
-	std::string name;
-	uint8_t priority;
-	std::regex pattern;
-};
-std::map<std::string, app_t> g_apps;
+void curve_table_t::bake(const trigger_config_t& cfg)
+{
+	for (size_t i = 0; i < std::size(values); ++i)
+		values[i] = cfg.evaluate((uint8_t)i);
+}
+
+snapshot_t<settings_t> g_settings;
 
 std::wstring application_directory()
 {
-	std::array<wchar_t, MAX_PATH_LENGTH + 1> buf;
-	auto len = GetModuleFileNameW(0, buf.data(), buf.size());
-	if (len == buf.size())
+	auto path = executable_path();
+	auto p = path.find_last_of(L"\\/");
+	if (p == std::wstring::npos)
 		return L""; // TODO:
 
-	for (auto p = buf.data() + len, head = buf.data(); p >= head; --p) {
-		if (*p == L'\\')
-			break;
-		*p = L'\0';
+	return path.substr(0, p + 1);
+}
+
+// The delay and the rate of the keyboard in the control panel.
+repeat_config_t default_repeat()
+{
+	repeat_config_t c;
+
+	int delay;
+	DWORD speed;
+	if (keyboard_repeat(delay, speed)) {
+		c.delay = 250 * (std::clamp(delay, 0, 3) + 1);
+		c.interval = (uint32_t)(1000 / (2.5f + std::min<DWORD>(speed, 31) * 27.5f / 31));
 	}
 
-	return std::wstring(buf.data());
+	for (int i = 0; i < 4; ++i)
+		c.keys.keys[i] = repeatable_keys(i);
+	return c;
 }
 
-void default_config()
+void default_config(settings_t& s)
 {
 	constexpr uint8_t ctrl = key_binding_t::CONTROL;
 	constexpr uint8_t alt = key_binding_t::ALT;
@@ -386,293 +410,63 @@ void default_config()
 		{.buttons = XINPUT_GAMEPAD_X, .keys = { VK_LBUTTON, 0, 0, 0 } },
 		{.buttons = XINPUT_GAMEPAD_Y, .keys = { VK_MBUTTON, 0, 0, 0 } },
 	};
-	std::copy(single_button, single_button + 16, g_single_button);
+	auto& c = *s.controllers[0];
+	std::copy(single_button, single_button + 16, c.single_button);
+	s.repeat = default_repeat();
+	c.binding_table.build(c.key_bindings, c.single_button);
+	c.binding_profiles.clear();
+
+	c.stick_params.scroll.accel.type = analog_function_t::linear;
+	c.stick_params.cursor.bake();
+	c.stick_params.scroll.bake();
 }
 
-std::vector<std::string> split_string(const std::string& s, const std::string& delims = " ,&|")
+constexpr name_table_t<uint16_t, 19> button_names({{
+	{ "UP",				XINPUT_GAMEPAD_DPAD_UP },
+	{ "DOWN",			XINPUT_GAMEPAD_DPAD_DOWN },
+	{ "LEFT",			XINPUT_GAMEPAD_DPAD_LEFT },
+	{ "RIGHT",			XINPUT_GAMEPAD_DPAD_RIGHT },
+	{ "START",			XINPUT_GAMEPAD_START },
+	{ "BACK",			XINPUT_GAMEPAD_BACK },
+	{ "LT",				XINPUT_GAMEPAD_LEFT_THUMB },
+	{ "LEFT_THUMB",		XINPUT_GAMEPAD_LEFT_THUMB },
+	{ "RT",				XINPUT_GAMEPAD_RIGHT_THUMB },
+	{ "RIGHT_THUMB",	XINPUT_GAMEPAD_RIGHT_THUMB },
+	{ "LS",				XINPUT_GAMEPAD_LEFT_SHOULDER },
+	{ "LEFT_SHOULDER",	XINPUT_GAMEPAD_LEFT_SHOULDER },
+	{ "RS",				XINPUT_GAMEPAD_RIGHT_SHOULDER },
+	{ "RIGHT_SHOULDER", XINPUT_GAMEPAD_RIGHT_SHOULDER },
+	{ "GUIDE",			XINPUT_GAMEPAD_GUIDE },
+	{ "A",				XINPUT_GAMEPAD_A },
+	{ "B",				XINPUT_GAMEPAD_B },
+	{ "X",				XINPUT_GAMEPAD_X },
+	{ "Y",				XINPUT_GAMEPAD_Y },
+}});
+
+uint16_t parse_button(std::string_view s)
 {
-	std::vector<std::string> ret;
-	return boost::split(ret, s, boost::is_any_of(delims));
+	return button_names.find(s);
 }
 
-uint16_t parse_button(const std::string& s)
-{
-	static constexpr struct {
-		const char* name;
-		uint16_t value;
-	}
-	buttons[] = {
-		{ "UP",				XINPUT_GAMEPAD_DPAD_UP },
-		{ "DOWN",			XINPUT_GAMEPAD_DPAD_DOWN },
-		{ "LEFT",			XINPUT_GAMEPAD_DPAD_LEFT },
-		{ "RIGHT",			XINPUT_GAMEPAD_DPAD_RIGHT },
-		{ "START",			XINPUT_GAMEPAD_START },
-		{ "BACK",			XINPUT_GAMEPAD_BACK },
-		{ "LT",				XINPUT_GAMEPAD_LEFT_THUMB },
-		{ "LEFT_THUMB",		XINPUT_GAMEPAD_LEFT_THUMB },
-		{ "RT",				XINPUT_GAMEPAD_RIGHT_THUMB },
-		{ "RIGHT_THUMB",	XINPUT_GAMEPAD_RIGHT_THUMB },
-		{ "LS",				XINPUT_GAMEPAD_LEFT_SHOULDER },
-		{ "LEFT_SHOULDER",	XINPUT_GAMEPAD_LEFT_SHOULDER },
-		{ "RS",				XINPUT_GAMEPAD_RIGHT_SHOULDER },
-		{ "RIGHT_SHOULDER", XINPUT_GAMEPAD_RIGHT_SHOULDER },
-		{ "GUIDE",			XINPUT_GAMEPAD_GUIDE },
-		{ "A",				XINPUT_GAMEPAD_A },
-		{ "B",				XINPUT_GAMEPAD_B },
-		{ "X",				XINPUT_GAMEPAD_X },
-		{ "Y",				XINPUT_GAMEPAD_Y },
-	};
+// virtual_key_codes without the reserved codes, keyed by the name without "VK_".
+constexpr size_t VK_NAMES = std::count_if(std::begin(virtual_key_codes), std::end(virtual_key_codes),
+	[](auto& vk){ return *vk.name != '\0'; });
 
-	auto us = boost::to_upper_copy(s);
-	for (auto& b: buttons)
-		if (us == b.name)
-			return b.value;
-	return 0;
-}
-
-uint8_t parse_vk_code(const std::string& s)
-{
-	auto us = boost::to_upper_copy(s);
+constexpr name_table_t<uint8_t, VK_NAMES> vk_names([]{
+	std::array<name_entry_t<uint8_t>, VK_NAMES> names = {};
+	size_t n = 0;
 	for (auto& vk: virtual_key_codes)
-		if (us == vk.name)
-			return vk.value;
-
-	us = "VK_" + us;
-	for (auto& vk: virtual_key_codes)
-		if (us == vk.name)
-			return vk.value;
-	
-	return 0;
-}
+		if (*vk.name != '\0')
+			names[n++] = { strip_prefix(vk.name, "VK_"), vk.value };
+	return names;
+}());
 
-#ifdef TOML_TOML11
-template <typename TC, typename K>
-float as_float(const toml::basic_value<TC>& v, const K& k, float default_value)
+// "VK_BACK", "vk_back", "BACK" and "back" are all VK_BACK.
+uint8_t parse_vk_code(std::string_view s)
 {
-	if (v.is_empty())
-		return default_value;
-
-	try {
-		return toml::find<float>(v, k);
-	}
-	catch (toml::type_error& exc) {
-		return toml::find<int64_t>(v, k);
-	}
-	catch (std::out_of_range& exc) {
-		return default_value;
-	}
+	return vk_names.find(strip_prefix(s, "VK_"));
 }
 
-template <typename TC>
-//stick_t load_stick_params(const toml::basic_value<TC>& v, uint32_t deadzone=2500,
-//	acceleration_t accel_type=acceleration_t::exponential,
-//	float base_speed=0.8, float accel_max=8, float deaccel_max=4, 
-//	trigger_function_t lt=trigger_function_t::nop, 
-//	trigger_function_t rt=trigger_function_t::nop)
-stick_t load_stick_params(const toml::basic_value<TC>& v, const stick_t& defval=stick_t())
-{
-	namespace me = magic_enum;
-
-	static const char* trigger_funcion_aliases[][2] = {
-		{ "accel", "acceleration" },
-		{ "deaccel", "deacceleration" },
-	};
-
-	stick_t c = defval;
-
-	if (v.is_empty())
-		return c;
-
-	c.deadzone = toml::find_or<uint32_t>(v, "deadzone", defval.deadzone);
-	c.accel_type = defval.accel_type;
-	c.base_speed = as_float(v, "base_speed", defval.base_speed);
-	c.accel_max = as_float(v, "accel_max", defval.accel_max);
-	c.deaccel_max = as_float(v, "deaccel_max", defval.deaccel_max);
-
-	try {
-		auto lt = toml::find<std::string>(v, "left_trigger");
-		for (auto pair: trigger_funcion_aliases)
-			if (boost::iequals(lt, pair[0])) {
-				lt = pair[1];
-				break;
-			}
-		c.left_trigger = me::enum_cast<trigger_function_t>(lt, me::case_insensitive).value();
-	}
-	catch (std::out_of_range&) {
-		c.left_trigger = defval.left_trigger;
-	}
-
-	try {
-		auto rt = toml::find<std::string>(v, "right_trigger");
-		for (auto pair: trigger_funcion_aliases)
-			if (boost::iequals(rt, pair[0])) {
-				rt = pair[1];
-				break;
-			}
-		c.right_trigger = me::enum_cast<trigger_function_t>(rt, me::case_insensitive).value();
-	}
-	catch (std::out_of_range&) {
-		c.left_trigger = defval.right_trigger;
-	}
-
-	return c;
-}
-
-void configure_input(const toml::value& cfg)
-{
-	using namespace std::regex_constants;
-
-	g_apps.clear();
-
-	auto accel = magic_enum::enum_cast<trigger_function_t>("accel");
-	auto acceleration = magic_enum::enum_cast<trigger_function_t>("acceleration");
-
-	auto cfg = toml::parse(cfg_file, toml::spec::v(1, 1, 0));
-
-	auto cursor = toml::find_or_default<toml::value>(cfg, "cursor");
-	g_stick_params[0].cursor
-		= g_stick_params[1].cursor
-		= g_stick_params[2].cursor
-		= g_stick_params[3].cursor 
-		= load_stick_params(cursor, { .deadzone=1000, .base_speed=0.3, });
-
-	auto scroll = toml::find_or_default<toml::value>(cfg, "scroll");
-	g_stick_params[0].scroll
-		= g_stick_params[1].scroll
-		= g_stick_params[2].scroll
-		= g_stick_params[3].scroll
-		= load_stick_params(scroll, { .deadzone = 5000, .base_speed = 0.01, .accel_max = 16, });
-
-	memset(g_single_button, 0, sizeof(g_single_button));
-	auto buttons = toml::find<std::vector<toml::value>>(cfg, "bindings", "buttons");
-	for (auto& b: buttons) {
-		auto button = parse_button(b["button"].as_string());
-		
-		DWORD i;
-		if (!BitScanForward(&i, button))
-			throw std::runtime_error("unknown button");
-
-		auto& k = g_single_button[i];
-		k.buttons = button;
-		k.priority = USHRT_MAX;
-		
-		auto modifiers = b["modifiers"];
-		if (modifiers.is_string()) {
-			for (auto m: split_string(modifiers.as_string()))
-				k.add_modifier(m);
-		}
-		else if (!modifiers.is_empty()) {
-			for (auto m: modifiers.as_array())
-				k.add_modifier(m.as_string());
-		}
-
-		auto keys = b["keys"];
-		if (keys.is_string()) {
-			auto ks = split_string(keys.as_string());
-			if (ks.size() > std::size(k.keys))
-				throw std::runtime_error("too many keys");
-			for (int i = 0; i < ks.size(); ++i)
-				k.keys[i] = parse_vk_code(ks[i]);
-		}
-		else if (!keys.is_empty()) {
-			auto ks = keys.as_array();
-			if (ks.size() > std::size(k.keys))
-				throw std::runtime_error("too many keys");
-			for (int i = 0; i < ks.size(); ++i)
-				k.keys[i] = parse_vk_code(ks[i].as_string());
-		}
-	}
-
-	auto apps_cfg = toml::find<std::vector<toml::value>>(cfg, "bindings", "applications");
-	for (auto& app: apps_cfg) {
-		auto name = app["name"].as_string();
-		app_t a {
-			name,
-			toml::find_or(app, "priority", UCHAR_MAX - 1), 
-			std::regex(app["pattern"].as_string(), ECMAScript|icase),
-		};
-		g_apps.emplace(name, std::move(a));
-	}
-
-	auto bindings = toml::find<std::vector<toml::value>>(cfg, "bindings", "binding");
-	for (auto& binding: bindings) {
-		key_binding_t k = {};
-
-		auto priority = toml::find_or(binding, "priority", 255);
-		k.priority = (priority << 8);
-
-		auto app = toml::find_or_default<std::string>(binding, "app");
-		if (!app.empty()) {
-			auto ri = g_apps.find(app);
-			if (ri == g_apps.end()) {
-				// TODO: log? throw?
-				continue;
-			}
-			k.executable = &ri->second.pattern;
-			k.priority += ri->second.priority;
-		}
-		else
-			k.priority += UCHAR_MAX;
-		k.foreground_window(toml::find_or_default<bool>(binding, "foreground_window"));
-		k.oneshot(toml::find_or_default<bool>(binding, "oneshot"));
-
-		auto m = binding["modifiers"];
-		if (m.is_string()) {
-			for (auto mod: split_string(m.as_string()))
-				k.add_modifier(mod);
-		}
-		else if (!m.is_empty()) {
-			auto mods = m.as_array();
-			for (auto& mod: mods)
-				k.add_modifier(mod.as_string());
-		}
-
-		auto b = binding["buttons"];
-		if (b.is_string()) {
-			for (auto button: split_string(b.as_string()))
-				k.buttons |= parse_button(button);
-		}
-		else if (!b.is_empty()) {
-			auto buttons = b.as_array();
-			for (auto& button: buttons)
-				k.buttons |= parse_button(button.as_string());
-		}
-
-		auto keys = binding["keys"];
-		if (keys.is_string()) {
-			auto ks = split_string(keys.as_string());
-			if (ks.size() > std::size(k.keys))
-				throw std::runtime_error("too many keys");
-			for (int i = 0; i < ks.size(); ++i)
-				k.keys[i] = parse_vk_code(ks[i]);
-		}
-		else if (!keys.is_empty()) {
-			auto ks = keys.as_array();
-			assert(std::size(k.keys) == 4);
-			if (ks.size() > std::size(k.keys))
-				throw std::runtime_error("too many keys");
-			for (int i = 0; i < ks.size(); ++i)
-				k.keys[i] = parse_vk_code(ks[i].as_string());
-		}
-
-		g_key_bindings.push_back(std::move(k));
-	}
-
-	for (auto& sb: g_single_button)
-		if (sb.buttons != 0)
-			g_key_bindings.push_back(sb);
-
-	std::sort(
-		g_key_bindings.begin(),
-		g_key_bindings.end(),
-		[](auto& a, auto& b){
-			return a.buttons < b.buttons ||
-				a.buttons == b.buttons && a.priority < b.priority; 
-		}
-	);
-} // configure_input()
-
-
 std::shared_ptr<spdlog::logger> get_logger(const std::string& dir, size_t max_size, size_t max_files)
 {
 	namespace fs = std::filesystem;
@@ -680,13 +474,20 @@ std::shared_ptr<spdlog::logger> get_logger(const std::string& dir, size_t max_si
 	static std::shared_ptr<spdlog::logger> logger;
 	if (!logger) {
 		auto path = fs::path(dir)/"gpmouse.log";
-		logger = spdlog::rotating_logger_mt("gpmouse", path.string(), max_size, max_files);
+		// The file is written by the thread pool of spdlog, so the input threads
+		// never wait on the disk. When the queue is full the oldest message is dropped.
+		spdlog::init_thread_pool(8192, 1);
+		logger = spdlog::rotating_logger_mt<spdlog::async_factory_nonblock>(
+			"gpmouse", path.string(), max_size ? max_size : 4 * 1024 * 1024, max_files ? max_files : 10);
+		logger->flush_on(spdlog::level::err);
 	}
 	return logger;
 }
 
-#pragma warning(push)
-#pragma warning(disable:4996)
+#ifdef _MSC_VER
+#	pragma warning(push)
+#	pragma warning(disable:4996)
+#endif
 std::string expand_environment_variables(const std::string& s)
 {
 	using namespace std::regex_constants;
@@ -708,7 +509,7 @@ std::string expand_environment_variables(const std::string& s)
 			auto varname = m.str().substr(1, m.length() - 2);
 			auto varval = std::getenv(varname.c_str());
 			if (varval == NULL)
-				throw std::runtime_error(std::format("no environment variable named '{}'", varname));
+				throw std::runtime_error(fmt::format("no environment variable named '{}'", varname));
 			std::copy(varval, varval + strlen(varval), out);
 		}
 
@@ -719,61 +520,24 @@ std::string expand_environment_variables(const std::string& s)
 	else
 		return s;
 }
-#pragma warning(pop)
+#ifdef _MSC_VER
+#	pragma warning(pop)
+#endif
 
-void configure_log(const toml::value& cfg)
+void configure_log(const log_config_t& log)
 {
-	auto logging_cfg = toml::find<toml::value>(cfg, "logging");
-
-	auto dir = toml::find_or<std::string>(logging_cfg, "directory", "<temp>");
-	dir = expand_environment_variables(dir);
-
-	auto max_size = toml::find_or<size_t>(logging_cfg, "max_size", 4 * 1024 * 1024);
-	auto max_files = toml::find_or<size_t>(logging_cfg, "max_files", 10);
-
-	auto logger = get_logger(dir, max_size, max_files);
-
+	auto dir = expand_environment_variables(log.directory);
+	auto logger = get_logger(dir, log.max_size, log.max_files);
 
-	auto level_str = toml::find_or_default<std::string>(logging_cfg, "level");
-	if (!level_str.empty()) {
-		auto level = spdlog::level::from_str(level_str);
-		logger->set_level(level);
-	}
-
-	auto pattern = toml::find_or_default<std::string>(logging_cfg, "pattern");
-	if (!pattern.empty())
-		logger->set_pattern(pattern);
-
-	auto format = toml::find_or_default<std::string>(logging_cfg, "format");
-	if (!format.empty()) {
-		// logger->set_formatter(
-	}
+	if (!log.level.empty())
+		logger->set_level(spdlog::level::from_str(log.level));
+	if (!log.pattern.empty())
+		logger->set_pattern(log.pattern);
 } // configure_log()
 
-#else
-
-#endif // def TOML_TOML11
-
 std::shared_ptr<spdlog::logger> get_logger()
 {
 	return get_logger("", 0, 0);
 }
 
-void configure()
-{
-	namespace fs = std::filesystem;
-
-	auto cfg_file = fs::path(application_directory()) / L"gpmouse.toml";
-
-	if (!fs::is_regular_file(cfg_file)) {
-		default_config();
-		return;
-	}
-
-	auto cfg = toml::parse(cfg_file, toml::spec::v(1, 1, 0));
-
-	configure_log(cfg);
-	configure_input(cfg);
-}
-
 } // namespace gpmouse
@@ -5,13 +5,17 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
-#include <regex>
+#include <algorithm>
+#include <cmath>
 
-#include <xinput.h>
+#include "platform.h"
 
 #include <boost/algorithm/string.hpp>
 #include <spdlog/spdlog.h>
 
+#include "apps.h"
+#include "names.h"
+
 
 namespace gpmouse
 {
@@ -128,16 +132,30 @@ enum class analog_function_t
 	log,
 };
 
+// Response of an analog input (a trigger, or the magnitude of a stick).
+// Inputs up to deadzone give minval, inputs from saturation give maxval,
+// and type decides the shape of the curve in between.
 struct trigger_config_t
 {
-	uint8_t deadzone;
-	uint8_t saturation;
-	int16_t minval;
-	int16_t maxval;
-	analog_function_t type;
-	// TODO: exp, log ̃p[^
-	float c; // c * a ** deadzone == minval, c * a ** saturation == maxval
-	float a; // c * log_a(deadzone) == minval, c * log_a(saturation) == maxval
+	uint8_t deadzone = 0;
+	uint8_t saturation = 255;
+	float minval = 1;
+	float maxval = 1;
+	analog_function_t type = analog_function_t::linear;
+
+	float evaluate(uint8_t x) const;
+};
+
+// trigger_config_t baked into a table indexed by the raw 8 bit input,
+// so that the input threads do not have to call pow() or log().
+struct curve_table_t
+{
+	float values[256] = {};
+
+	void bake(const trigger_config_t& cfg);
+	float operator[](uint8_t i) const {
+		return values[i];
+	}
 };
 
 struct stick_config_t
@@ -161,6 +179,12 @@ struct keystate_t
 				return false;
 		return true;
 	}
+	keystate_t& operator|=(const keystate_t& ks) {
+		for (int i = 0; i < 4; ++i)
+			keys[i] |= ks.keys[i];
+		return *this;
+	}
+	bool operator==(const keystate_t&) const = default;
 	bool oneshot() const {
 		// virtual key code 0 ͉ɂ蓖ĂĂȂ̂ŁAs[g֎~tOƂĎg
 		return (keys[0] & 1) == 1;
@@ -169,9 +193,17 @@ struct keystate_t
 
 
 
+// Key repeat. keys are the keys which repeat while they are held.
+struct repeat_config_t
+{
+	uint32_t delay = 500;	// ms before the first repeat
+	uint32_t interval = 33;	// ms between two repeats
+	keystate_t keys;
+};
+
 struct key_binding_t
 {
-	std::regex* executable = 0;
+	app_id_t app = NO_APP;
 	uint16_t priority = USHRT_MAX;
 	uint16_t buttons = 0;
 	uint8_t flags = 0;
@@ -205,15 +237,14 @@ struct key_binding_t
 		return modifiers & WINDOWS;
 	}
 
-	void add_modifier(const std::string& ms) {
-		auto s = boost::to_upper_copy(ms);
-		if (s == "CONTROL" || s == "CTRL")
+	void add_modifier(std::string_view s) {
+		if (iequals(s, "CONTROL") || iequals(s, "CTRL"))
 			modifiers |= CONTROL;
-		if (s == "ALT")
+		if (iequals(s, "ALT"))
 			modifiers |= ALT;
-		if (s == "SHIFT")
+		if (iequals(s, "SHIFT"))
 			modifiers |= SHIFT;
-		if (s == "WIN" || s == "WINDOWS")
+		if (iequals(s, "WIN") || iequals(s, "WINDOWS"))
 			modifiers |= WINDOWS;
 	}
 
@@ -239,7 +270,7 @@ struct key_binding_t
 		set_flag(FOREGROUND_WINDOW, val);
 	}
 
-	void fill(keystate_t& ks) {
+	void fill(keystate_t& ks) const {
 		if (has_alt())
 			ks.press(VK_MENU);
 		if (has_ctrl())
@@ -287,6 +318,24 @@ struct stick_t
 	float deaccel_max = 4;
 	trigger_function_t left_trigger = trigger_function_t::deacceleration;
 	trigger_function_t right_trigger = trigger_function_t::acceleration;
+
+	trigger_config_t accel = { .maxval = 8, .type = analog_function_t::exp };
+	trigger_config_t brake = { .maxval = 4 };
+	// gain applied to the stick vector, indexed by its length / 128.
+	trigger_config_t magnitude = {};
+
+	curve_table_t accel_table;
+	curve_table_t brake_table;
+	curve_table_t magnitude_table;
+
+	void bake() {
+		accel_table.bake(accel);
+		brake_table.bake(brake);
+		magnitude_table.bake(magnitude);
+	}
+	static uint8_t magnitude_index(int x, int y) {
+		return (uint8_t)std::min(255.0f, std::sqrt((float)x*x + (float)y*y) / 128);
+	}
 };
 
 struct stick_params_t
@@ -297,16 +346,41 @@ struct stick_params_t
 	float min_touch_dist = 50;
 };
 
-// g_key_binding  (buttons asc, process desc) Ń\[gĂ
-extern std::vector<key_binding_t> g_key_bindings;
-extern key_binding_t g_single_button[16];
-extern stick_params_t g_stick_params[XUSER_MAX_COUNT];
+struct polling_t
+{
+	float active_rate = 1000;	// Hz, while a stick or a trigger is out of its deadzone
+	float idle_rate = 30;		// Hz, after the pads have been idle for idle_delay
+	uint32_t idle_delay = 250;	// ms without a new packet before backing off
+	uint32_t probe_interval = 1000;	// ms between two probes of an empty slot
+};
+
+// [logging] as written in gpmouse.toml. <NAME> in directory is expanded when the logger is made.
+struct log_config_t
+{
+	std::string directory = "<temp>";
+	size_t max_size = 4 * 1024 * 1024;
+	size_t max_files = 10;
+	std::string level;
+	std::string pattern;
+};
 
+// The delay and the rate of the keyboard in the control panel.
+repeat_config_t default_repeat();
 
+// Loads gpmouse.toml and publishes it to g_settings (settings.h).
+// Throws if the file is broken, and the previous settings stay.
+// In loader.cpp, the only module which needs toml11 and magic_enum.
 void configure();
+// makes the logger of log, or applies the level and pattern of log to it.
+void configure_log(const log_config_t& log);
+// the directory of gpmouse.exe, where gpmouse.toml is.
+std::wstring application_directory();
 std::shared_ptr<spdlog::logger> get_logger();
 
 const char* vk_name(uint8_t vk);
+// the button or the virtual key of a name in gpmouse.toml, 0 if none.
+uint16_t parse_button(std::string_view s);
+uint8_t parse_vk_code(std::string_view s);
 
 } // namespace gpmouse
 
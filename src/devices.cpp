@@ -0,0 +1,60 @@
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+device_id_t device_registry_t::id(const std::string& key)
+{
+	if (auto i = _ids.find(key); i != _ids.end())
+		return i->second;
+	if (size() == MAX_DEVICES)
+		return NONE;
+
+	auto id = size();
+	_ids.emplace(key, id);
+	_keys.push_back(key);
+	_position.push_back(-1);
+	return id;
+}
+
+void device_registry_t::attach(device_id_t id)
+{
+	if (_position[id] >= 0)
+		return;
+	_position[id] = (int)_active.size();
+	_active.push_back(id);
+}
+
+void device_registry_t::detach(device_id_t id)
+{
+	auto p = _position[id];
+	if (p < 0)
+		return;
+	// the last one takes the place of id.
+	auto last = _active.back();
+	_active[p] = last;
+	_position[last] = p;
+	_active.pop_back();
+	_position[id] = -1;
+}
+
+void insert_sorted(std::vector<device_id_t>& ids, device_id_t id)
+{
+	auto i = std::lower_bound(ids.begin(), ids.end(), id);
+	if (i == ids.end() || *i != id)
+		ids.insert(i, id);
+}
+
+void erase_sorted(std::vector<device_id_t>& ids, device_id_t id)
+{
+	auto i = std::lower_bound(ids.begin(), ids.end(), id);
+	if (i != ids.end() && *i == id)
+		ids.erase(i);
+}
+
+} // namespace gpmouse
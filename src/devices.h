@@ -0,0 +1,67 @@
+#ifndef GPMOUSE_DEVICES_H
+#define GPMOUSE_DEVICES_H
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace gpmouse
+{
+
+// The number of pads the engine tells apart, over every source. It bounds
+// the per-device slots of the queue and of a recording; the other
+// per-device arrays grow with the pads actually seen.
+constexpr int MAX_DEVICES = 256;
+// The number of controller profiles (settings.h) the pads can be given.
+// The queue carries the profile of a state in 7 bits.
+constexpr int MAX_CONTROLLERS = 128;
+
+// A pad, numbered from 0 in the order the pads are first seen, so it
+// indexes the per-device arrays directly.
+using device_id_t = int;
+
+// The ids of the pads of every source, and which of them are connected.
+// A source knows a pad by a key of its own ("xinput/0", the physical path
+// of an evdev device, ...), and the pad keeps its id for the life of the
+// process: a pad plugged in again gets its id back, and the per-device
+// arrays only grow when a pad never seen before arrives.
+// Polling thread only.
+class device_registry_t
+{
+public:
+	static constexpr device_id_t NONE = -1;
+
+	// the id of key, made on its first call. NONE if MAX_DEVICES ids are taken.
+	device_id_t id(const std::string& key);
+
+	// O(1) each.
+	void attach(device_id_t id);
+	void detach(device_id_t id);
+	bool attached(device_id_t id) const {
+		return id >= 0 && id < size() && _position[id] >= 0;
+	}
+
+	// the connected pads, in no particular order.
+	const std::vector<device_id_t>& active() const { return _active; }
+	// the number of ids, i.e. the size the per-device arrays need.
+	int size() const { return (int)_keys.size(); }
+	const std::string& key(device_id_t id) const { return _keys[id]; }
+
+private:
+	std::unordered_map<std::string, device_id_t> _ids;
+	std::vector<std::string> _keys;
+	std::vector<int> _position;	// in _active, -1 if not attached
+	std::vector<device_id_t> _active;
+};
+
+// Adds id to the ids in ascending order, unless it is there. The sources
+// report their pads in this order, so a replay can report them the same.
+void insert_sorted(std::vector<device_id_t>& ids, device_id_t id);
+void erase_sorted(std::vector<device_id_t>& ids, device_id_t id);
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_DEVICES_H
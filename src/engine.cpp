@@ -0,0 +1,519 @@
+﻿#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <bitset>
+
+#include "platform.h"
+
+#include "engine.h"
+#include "config.h"
+#include "poll.h"
+#include "output.h"
+#include "stick.h"
+#include "process.h"
+#include "bindings.h"
+#include "alloc.h"
+#include "log.h"
+#include "repeat.h"
+#include "settings.h"
+#include "latency.h"
+
+
+namespace gpmouse
+{
+
+#define INTERVAL 10
+#define FPS (1000/INTERVAL)
+
+struct point_t
+{
+	float x;
+	float y;
+};
+bool operator==(const point_t& a, const point_t& b)
+{
+	return a.x == b.x && a.y == b.y;
+}
+
+enum class mouse_button_t : uint32_t
+{
+	invalid = 0,
+	left = 0x0002,
+	right = 0x0008,
+	middle = 0x0020,
+};
+
+enum class stick_mode_t : uint32_t
+{
+	mouse = 0,
+	touch = 2,
+	multi_touch = 3,
+	MAX = 3,
+};
+struct input_state_t
+{
+	stick_mode_t stick_mode;
+	std::bitset<256> keys;
+	bool single; // ボタンの同時押しがなされていない
+	//std::bitset<4> modifiers;
+	uint16_t modifiers;
+	uint16_t vk_buttons[16]; // 今現在ボタンがどのキーにバインドされているか。
+	point_t touch_start[2];
+#if defined(_WIN32)
+	POINTER_TOUCH_INFO touch[2];
+#endif
+};
+input_state_t g_input_state = {};
+
+void calibrate_stick_params(stick_params_t& params, const XINPUT_GAMEPAD& in)
+{
+	params.cursor.cx = in.sThumbLX;
+	params.cursor.cy = in.sThumbLY;
+	params.scroll.cx = in.sThumbRX;
+	params.scroll.cy = in.sThumbRY;
+	params.initialized = true;
+}
+
+void reload_stick_params(stick_params_t& params, const stick_params_t& loaded)
+{
+	auto cursor = params.cursor;
+	auto scroll = params.scroll;
+	auto initialized = params.initialized;
+
+	params = loaded;
+	params.cursor.cx = cursor.cx;
+	params.cursor.cy = cursor.cy;
+	params.scroll.cx = scroll.cx;
+	params.scroll.cy = scroll.cy;
+	params.initialized = initialized;
+}
+
+void left_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input, analog_motion_t& out)
+{
+	// Remark: dy の計算で SM_CXSCREEN を使っているのは間違いではない。
+	//   SM_CXSCREEN で計算すると、縦と横でカーソルのスピードが違ってしまうため、
+	//   Y軸方向も SM_CXSCREEN で計算している。スクロールの方は、縦と横で
+	//   違っていても問題がないため、SM_CYSCREEN を使う。
+	float dx, dy;
+	if (!stick_velocity(cfg, (float)screen_width(), -1,
+			input.sThumbLX, input.sThumbLY, input.bLeftTrigger, input.bRightTrigger, dx, dy))
+		return;
+
+	if (g_input_state.stick_mode == stick_mode_t::mouse) {
+		out.dx = dx;
+		out.dy = dy;
+	}
+	else {
+	}
+}
+void right_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input, analog_motion_t& out)
+{
+	float dx, dy;
+	if (!stick_velocity(cfg, FPS, 1,
+			input.sThumbRX, input.sThumbRY, input.bLeftTrigger, input.bRightTrigger, dx, dy))
+		return;
+
+	if (g_input_state.stick_mode == stick_mode_t::mouse) {
+		out.hwheel = dx;
+		out.vwheel = dy;
+	}
+	else {
+		g_input_state.stick_mode = stick_mode_t::multi_touch;
+
+		if (g_input_state.touch_start[0] == g_input_state.touch_start[1]) {
+			// タッチの開始
+		}
+		else {
+			//auto new_location = {  }
+			//sendtouch
+		}
+	}
+}
+
+void gp_handle_analogue_input(const stick_params_t& config, const XINPUT_GAMEPAD& input, analog_motion_t& out)
+{
+	left_stick(config.cursor, input, out);
+	right_stick(config.scroll, input, out);
+}
+
+keystate_t translate_input(const settings_t& s, const controller_profile_t& controller, process_cache_t& processes, WORD input)
+{
+	auto& table = controller.binding_table;
+	auto candidates = table.candidates(input);
+
+	keystate_t keys = {};
+	if (candidates.empty()) { // the combination of buttons is not defined
+		// 個々のボタンのキーバインディングを組み合わせる
+		keys = table.combine(input);
+	}
+	else if (candidates[0].app == NO_APP) { // input にアプリケーション固有のバインディングはない
+		keys = table.keys(candidates[0]);
+	}
+	else {
+		// a name stays valid until the next lookup only, so it is matched at once.
+		auto cursor_process = processes.under_cursor();
+#ifdef _DEBUG
+		GP_LOG_INFO("finding custom rule");
+		GP_LOG_INFO("cursor: \"{}\", input: {:04X}", cursor_process, input);
+#endif
+		auto& cursor_apps = s.app_matcher.match(cursor_process);
+		auto foreground_process = processes.foreground();
+#ifdef _DEBUG
+		GP_LOG_INFO("foreground: \"{}\"", foreground_process);
+#endif
+		auto& foreground_apps = s.app_matcher.match(foreground_process);
+
+		keys = controller.binding_profiles.select(cursor_apps, foreground_apps).resolve(input);
+
+#ifdef _DEBUG
+
+		// the profile must give the same keys as trying the candidates in order.
+		keystate_t expected = {};
+		for (auto& c: candidates) {
+			if (c.app == NO_APP)
+				GP_LOG_INFO("No custom rule matched");
+			else
+				GP_LOG_INFO("Testing \"{}\"", s.app_matcher.name(c.app));
+			auto& apps = c.foreground_window() ? foreground_apps : cursor_apps;
+			if (c.app != NO_APP && !apps.test(c.app))
+				continue;
+			expected = table.keys(c);
+			break;
+		}
+		assert(keys == expected);
+#endif
+	}
+	return keys;
+}
+
+int keycount(const keystate_t& current, const keystate_t& prev)
+{
+	int N = 0;
+	for (int i = 0; i < 4; ++i) {
+		N += __popcnt64(~current.keys[i] & prev.keys[i]);
+		N += __popcnt64(current.keys[i] & ~prev.keys[i]);
+	}
+	return N;
+}
+
+void make_mouse_button_input(INPUT& i, uint8_t vk, bool up)
+{
+	memset(&i, 0, sizeof(INPUT));
+	i.type = INPUT_MOUSE;
+
+	if (vk == VK_XBUTTON1 || vk == VK_XBUTTON2) {
+		i.mi.mouseData = vk - VK_XBUTTON1 + 1;
+		i.mi.dwFlags = up ? MOUSEEVENTF_XUP : MOUSEEVENTF_XDOWN;
+	}
+	else {
+		auto button = vk == VK_LBUTTON ? mouse_button_t::left :
+						vk == VK_RBUTTON ? mouse_button_t::right :
+						vk == VK_MBUTTON ? mouse_button_t::middle : mouse_button_t::invalid;
+		assert(button != mouse_button_t::invalid);
+
+		i.mi.dwFlags = up ? ((uint32_t)button << 1) : (uint32_t)button;
+	}
+}
+
+void make_kbd_input(INPUT& i, uint8_t vk, bool up) {
+	GP_LOG_DEBUG("{:<20} {}", vk_name(vk), up ? "Up" : "Down");
+
+	memset(&i, 0, sizeof(INPUT));
+	i.type = INPUT_KEYBOARD;
+	i.ki.wVk = vk;
+	i.ki.wScan = scan_code(vk);
+	if (up)
+		i.ki.dwFlags = KEYEVENTF_KEYUP;
+	if (is_extended_key(vk))
+		i.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+}
+
+int gp_handle_buttons_input(output_sink_t& sink, const keystate_t& input, keystate_t& state)
+{
+	auto N = keycount(input, state);
+	if (N == 0)
+		return 0;
+
+	GP_LOG_DEBUG("number of inputs: {}", N);
+
+	// TODO: SHIFT が押しっぱなしでも up down されている
+	GP_LOG_DEBUG("------ buttons -------");
+	GP_LOG_DEBUG("     {:<16} {:<16} {:<16} {:<16}", "input", "state", "up", "down");
+	GP_LOG_DEBUG("[00] {:016X} {:016X} {:016X} {:016X}", input.keys[0], state.keys[0], ~input.keys[0] & state.keys[0], input.keys[0] & ~state.keys[0]);
+	GP_LOG_DEBUG("[40] {:016X} {:016X} {:016X} {:016X}", input.keys[1], state.keys[1], ~input.keys[1] & state.keys[1], input.keys[1] & ~state.keys[1]);
+	GP_LOG_DEBUG("[80] {:016X} {:016X} {:016X} {:016X}", input.keys[2], state.keys[2], ~input.keys[2] & state.keys[2], input.keys[2] & ~state.keys[2]);
+	GP_LOG_DEBUG("[C0] {:016X} {:016X} {:016X} {:016X}", input.keys[3], state.keys[3], ~input.keys[3] & state.keys[3], input.keys[3] & ~state.keys[3]);
+	GP_LOG_DEBUG("---------------------");
+	for (int i = 0; i < 4; ++i) {
+		GP_LOG_DEBUG("mouse up: {:016X} = {:016X} & {:016X} & {:016X}", (~input.keys[i] & state.keys[i]) & MOUSE_EVENTS_MASK[i], ~input.keys[i], state.keys[i], MOUSE_EVENTS_MASK[i]);
+		GP_LOG_DEBUG("non-modifier up: {:016X} = {:016X} & {:016X} & {:016X}", (~input.keys[i] & state.keys[i]) & keys_mask(i), ~input.keys[i], state.keys[i], keys_mask(i));
+		GP_LOG_DEBUG("modifier up: {:016X} = {:016X} & {:016X} & {:016X}", (~input.keys[i] & state.keys[i]) & MODIFIERS_MASK[i], ~input.keys[i], state.keys[i], MODIFIERS_MASK[i]);
+		GP_LOG_DEBUG("modifier down: {:016X}", (input.keys[i] & ~state.keys[i]) & MODIFIERS_MASK[i]);
+	}
+
+	// the log and the sink may allocate, the batch may not.
+	[[maybe_unused]] no_alloc_scope_t no_alloc;
+	input_batch_t inputs;
+	{
+		DWORD k;
+		// mouse up
+		for (int i = 0; i < 4; ++i) {
+			auto r = (~input.keys[i] & state.keys[i]) & MOUSE_EVENTS_MASK[i];
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_mouse_button_input(inputs.push(), vk, true);
+				r ^= (1ull << k);
+			}
+		}
+		// non-modifier key up
+		for (int i = 0; i < 4; ++i) {
+			auto r = (~input.keys[i] & state.keys[i]) & keys_mask(i);
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_kbd_input(inputs.push(), vk, true);
+				r ^= (1ull << k);
+			}
+		}
+		// modifier key up
+		for (int i = 0; i < 4; ++i) {
+			auto r = (~input.keys[i] & state.keys[i]) & MODIFIERS_MASK[i];
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_kbd_input(inputs.push(), vk, true);
+				r ^= (1ull << k);
+			}
+		}
+		// modifier key down
+		for (int i = 0; i < 4; ++i) {
+			auto r = (input.keys[i] & ~state.keys[i]) & MODIFIERS_MASK[i];
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_kbd_input(inputs.push(), vk, false);
+				r ^= (1ull << k);
+			}
+		}
+		// non-modifier key down
+		for (int i = 0; i < 4; ++i) {
+			auto r = (input.keys[i] & ~state.keys[i]) & keys_mask(i);
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_kbd_input(inputs.push(), vk, false);
+				r ^= (1ull << k);
+			}
+		}
+		// mouse down
+		for (int i = 0; i < 4; ++i) {
+			auto r = (input.keys[i] & ~state.keys[i]) & MOUSE_EVENTS_MASK[i];
+			while (BitScanForward64(&k, r)) {
+				uint8_t vk = 64 * i + k;
+				make_mouse_button_input(inputs.push(), vk, false);
+				r ^= (1ull << k);
+			}
+		}
+	}
+	{
+		allow_alloc_scope_t sending;
+		sink.send(inputs.size, inputs.inputs);
+	}
+
+	state = input;
+	return N;
+}
+
+void update_repeats(const settings_t& s, process_cache_t& processes, repeat_scheduler_t& repeats, device_id_t device, const keystate_t& before, const keystate_t& after, uint64_t now)
+{
+	// virtual key code 0 (oneshot) がある時はリピートしない
+	if (after.oneshot()) {
+		repeats.release_all(device);
+		return;
+	}
+
+	auto cfg = &s.repeat;
+	if (!s.app_repeats.empty())
+		cfg = &s.repeat_config(s.app_matcher.match(processes.foreground()));
+
+	for (size_t i = 0; i < std::size(after.keys); ++i) {
+		DWORD k;
+		auto released = before.keys[i] & ~after.keys[i];
+		while (BitScanForward64(&k, released)) {
+			repeats.release(device, (uint8_t)(64 * i + k));
+			released ^= (1ull << k);
+		}
+		auto pressed = after.keys[i] & ~before.keys[i] & cfg->keys.keys[i];
+		while (BitScanForward64(&k, pressed)) {
+			repeats.press(device, (uint8_t)(64 * i + k), now, *cfg);
+			pressed ^= (1ull << k);
+		}
+	}
+}
+
+void repeat_keys(output_sink_t& sink, repeat_scheduler_t& repeats, uint64_t now)
+{
+	// the sink may allocate, the batch may not.
+	[[maybe_unused]] no_alloc_scope_t no_alloc;
+	input_batch_t inputs;
+	auto send = [&] {
+		allow_alloc_scope_t sending;
+		sink.send(inputs.size, inputs.inputs);
+		inputs.size = 0;
+	};
+	repeats.advance(now, [&](int, uint8_t vk) {
+		if (inputs.size == input_batch_t::CAPACITY)
+			send();
+		make_kbd_input(inputs.push(), vk, false);
+	});
+	if (!inputs.empty())
+		send();
+}
+
+button_handler_t::button_handler_t(output_sink_t& sink, process_cache_t& processes, latency_stats_t* latency):
+	_sink(&sink),
+	_processes(&processes),
+	_latency(latency)
+{
+}
+
+void button_handler_t::handle(const settings_t& s, const xinput_t& input, uint64_t now)
+{
+	// but for the sink, the log and the misses of the caches.
+	[[maybe_unused]] no_alloc_scope_t no_alloc;
+	GP_LOG_DEBUG("buttons: {:04X}", input.buttons);
+
+	// the timestamp wraps around, but a state is never 4 seconds old.
+	uint64_t dequeued = 0, translated = 0;
+	if (_latency) {
+		dequeued = now_ns();
+		_latency->record(latency_stage_t::dequeue, (uint32_t)dequeued - input.timestamp);
+	}
+
+	auto keys = translate_input(s, s.controller(input.controller), *_processes, input.buttons);
+	if (_latency) {
+		translated = now_ns();
+		_latency->record(latency_stage_t::translate, translated - dequeued);
+	}
+
+	if (input.device >= (int)_prev.size()) {
+		allow_alloc_scope_t first_press;
+		_prev.resize(input.device + 1);
+	}
+	auto& prev = _prev[input.device];
+	auto before = prev;
+	if (gp_handle_buttons_input(*_sink, keys, prev) != 0 && _latency) {
+		auto emitted = now_ns();
+		_latency->record(latency_stage_t::emit, emitted - translated);
+		_latency->record(latency_stage_t::total, (uint32_t)emitted - input.timestamp);
+	}
+	update_repeats(s, *_processes, _repeats, input.device, before, prev, now);
+}
+
+void button_handler_t::repeat(uint64_t now)
+{
+	repeat_keys(*_sink, _repeats, now);
+}
+
+poller_t::poller_t(xinput_queue_t& queue, analog_output_t& output, latency_stats_t* latency):
+	_queue(&queue),
+	_output(&output),
+	_latency(latency)
+{
+}
+
+void poller_t::configure(const settings_t& s)
+{
+	_polling = s.polling;
+	_matches = s.controller_matches;
+	_loaded.clear();
+	for (auto& c: s.controllers)
+		_loaded.push_back(c->stick_params);
+
+	// the pads may take other profiles now.
+	for (device_id_t i = 0; i < (int)_sticks.size(); ++i) {
+		_controllers[i] = select(i);
+		reload_stick_params(_sticks[i], _loaded[_controllers[i]]);
+	}
+}
+
+void poller_t::grow(device_id_t i)
+{
+	for (auto j = (device_id_t)_sticks.size(); j <= i; ++j) {
+		_controllers.push_back(select(j));
+		_sticks.push_back(_loaded.empty() ? stick_params_t() : _loaded[_controllers[j]]);
+	}
+	auto n = (size_t)i + 1;
+	_integrators.resize(n, motion_integrator_t(INTERVAL * 1000));
+	_buttons.resize(n, 0);
+}
+
+uint8_t poller_t::select(device_id_t i) const
+{
+	std::string_view key;
+	if (_devices && i < _devices->size())
+		key = _devices->key(i);
+	auto c = select_controller(_matches, i, key);
+	return c < _loaded.size() ? c : 0;
+}
+
+void poller_t::begin(uint64_t now, uint64_t polled)
+{
+	_now = now;
+	_polled = polled;
+	_active = false;
+	_changed = false;
+	_pushed = false;
+	_frame = {};
+}
+
+void poller_t::state(device_id_t i, const XINPUT_STATE& input, bool packet_changed)
+{
+	if (i >= (int)_sticks.size())
+		grow(i);
+
+	auto& s_params = _sticks[i];
+	auto& in = input.Gamepad;
+
+	if (!s_params.initialized || in.wButtons == (XINPUT_GAMEPAD_START|XINPUT_GAMEPAD_BACK))
+		calibrate_stick_params(s_params, in);
+	analog_motion_t motion;
+	gp_handle_analogue_input(s_params, in, motion);
+	_frame += _integrators[i].integrate(_now, motion);
+	_active = _active || is_active(s_params, in);
+
+	if (packet_changed) {
+		_changed = true;
+		// the handler only needs the buttons, so a stick motion does not wake it up.
+		if (in.wButtons != _buttons[i])
+			push(i, in.wButtons);
+	}
+}
+
+void poller_t::disconnect(device_id_t i)
+{
+	if (i >= (int)_sticks.size())
+		return;
+	_sticks[i].initialized = false;
+	_integrators[i].reset();
+	// the handler releases the keys of the buttons which were held.
+	if (_buttons[i] != 0)
+		push(i, 0);
+}
+
+void poller_t::push(device_id_t i, WORD buttons)
+{
+	_buttons[i] = buttons;
+	xinput_t item{ i, (uint32_t)_polled, buttons, _controllers[i] };
+	_queue->push(item);
+	_pushed = true;
+	if (_latency)
+		_latency->record(latency_stage_t::enqueue, now_ns() - _polled);
+}
+
+void poller_t::end()
+{
+	if (_pushed)
+		_queue->signal().notify();
+
+	if (!_frame.empty())
+		_output->submit(_frame);
+}
+
+} // namespace gpmouse
@@ -0,0 +1,142 @@
+#ifndef GPMOUSE_ENGINE_H
+#define GPMOUSE_ENGINE_H
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "platform.h"
+
+#include "config.h"
+#include "settings.h"
+#include "output.h"
+#include "queue.h"
+#include "process.h"
+#include "repeat.h"
+#include "latency.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+// The hot paths of the engine, each usable on its own.
+
+// the center of the sticks of a pad from its current state.
+void calibrate_stick_params(stick_params_t& params, const XINPUT_GAMEPAD& in);
+// takes the reloaded settings of a pad but keeps its calibration.
+void reload_stick_params(stick_params_t& params, const stick_params_t& loaded);
+// the cursor and the wheel motion of the sticks in one tick.
+void left_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input, analog_motion_t& out);
+void right_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input, analog_motion_t& out);
+void gp_handle_analogue_input(const stick_params_t& config, const XINPUT_GAMEPAD& input, analog_motion_t& out);
+
+// the keys the bindings of controller give the pressed buttons, for the
+// windows under the cursor and in the foreground.
+keystate_t translate_input(const settings_t& s, const controller_profile_t& controller, process_cache_t& processes, WORD input);
+// the number of keys which differ.
+int keycount(const keystate_t& current, const keystate_t& prev);
+void make_mouse_button_input(INPUT& i, uint8_t vk, bool up);
+void make_kbd_input(INPUT& i, uint8_t vk, bool up);
+// sends the key changes from state to input. Returns the number of them.
+int gp_handle_buttons_input(output_sink_t& sink, const keystate_t& input, keystate_t& state);
+// starts the repeat of the keys a button change pressed, and stops the released ones.
+void update_repeats(const settings_t& s, process_cache_t& processes, repeat_scheduler_t& repeats,
+	device_id_t device, const keystate_t& before, const keystate_t& after, uint64_t now);
+// sends the repeats due at now [ms].
+void repeat_keys(output_sink_t& sink, repeat_scheduler_t& repeats, uint64_t now);
+
+// The work of one tick of the polling thread, without the polling and the
+// sleep: the states of the pads are turned into analog motion for output,
+// and the button changes are pushed to queue.
+// check_xinput drives it with XInput and the real clock, a replay with a
+// recording and a virtual clock.
+// The pads are device ids (devices.h). The state of a pad is made the
+// first time it is seen and kept after it is lost, as the id is.
+// A pad takes its controller profile (settings.h) then and at every
+// configure(), and the pushed states carry it to the handler.
+// With latency, the enqueue stage of every pushed state is recorded.
+class poller_t
+{
+public:
+	poller_t(xinput_queue_t& queue, analog_output_t& output, latency_stats_t* latency = nullptr);
+
+	// the registry the device keys are taken from, to select the controller
+	// profiles. Without it, as in a replay, the pads are matched by id only.
+	void attach(const device_registry_t& devices) { _devices = &devices; }
+
+	// takes the settings of s but keeps the calibration of the sticks.
+	void configure(const settings_t& s);
+	const polling_t& polling() const { return _polling; }
+
+	// now    : [us]
+	// polled : now_ns() before the pads are read, the timestamp of the pushed states
+	void begin(uint64_t now, uint64_t polled);
+	void state(device_id_t i, const XINPUT_STATE& input, bool packet_changed);
+	void disconnect(device_id_t i);
+	void end();
+
+	// some stick or trigger is out of its deadzone in this tick.
+	bool active() const { return _active; }
+	// the packet number of some pad has changed in this tick.
+	bool changed() const { return _changed; }
+
+private:
+	// makes the state of the pads up to i.
+	void grow(device_id_t i);
+	uint8_t select(device_id_t i) const;
+	// queues the buttons of pad i for the handler.
+	void push(device_id_t i, WORD buttons);
+
+	xinput_queue_t* _queue;
+	analog_output_t* _output;
+	latency_stats_t* _latency;
+	const device_registry_t* _devices = nullptr;
+
+	// a copy, as poll_scheduler_t and slot_tracker_t keep a pointer to it.
+	polling_t _polling;
+	std::vector<controller_match_t> _matches;
+	// the settings a new pad starts from, by controller profile.
+	std::vector<stick_params_t> _loaded;
+	// by device id
+	std::vector<uint8_t> _controllers;
+	std::vector<stick_params_t> _sticks;
+	// the stick speeds are tuned for one tick per INTERVAL.
+	std::vector<motion_integrator_t> _integrators;
+	std::vector<WORD> _buttons;
+
+	uint64_t _now = 0;
+	uint64_t _polled = 0;
+	bool _active = false;
+	bool _changed = false;
+	bool _pushed = false;
+	analog_frame_t _frame;
+};
+
+// The button side of the handler thread: translates the button states of
+// the queue, sends the key events to sink and repeats the keys.
+// With latency, the stages from the dequeue on are recorded for every state.
+class button_handler_t
+{
+public:
+	button_handler_t(output_sink_t& sink, process_cache_t& processes, latency_stats_t* latency = nullptr);
+
+	// now : [ms]
+	void handle(const settings_t& s, const xinput_t& input, uint64_t now);
+	// sends the repeats due at now.
+	void repeat(uint64_t now);
+	// repeat_scheduler_t::NEVER if no key is repeating.
+	uint64_t next_deadline() const { return _repeats.next_deadline(); }
+
+private:
+	output_sink_t* _sink;
+	process_cache_t* _processes;
+	latency_stats_t* _latency;
+	// by device id, made when a pad sends its first state.
+	std::vector<keystate_t> _prev;
+	repeat_scheduler_t _repeats;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_ENGINE_H
@@ -0,0 +1,548 @@
+#include "platform.h"
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <string>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "evdev.h"
+#include "engine.h"
+#include "settings.h"
+#include "poll.h"
+#include "latency.h"
+#include "log.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// XInputGetStateEx (gpmouse.cpp) reports the guide button with this bit.
+constexpr WORD GAMEPAD_GUIDE = 0x0400;
+
+constexpr uint64_t WAKE_ID = ~0ull;
+constexpr uint64_t WATCH_ID = ~1ull;
+
+constexpr size_t LONG_BITS = 8 * sizeof(unsigned long);
+
+bool test_bit(const unsigned long* bits, unsigned bit)
+{
+	return (bits[bit / LONG_BITS] >> (bit % LONG_BITS)) & 1;
+}
+
+// min..max -> -32768..32767
+SHORT scale_stick(int32_t value, int32_t min, int32_t range)
+{
+	if (range <= 0)
+		return 0;
+	auto v = (int64_t)(value - min) * 65535 / range - 32768;
+	return (SHORT)std::clamp<int64_t>(v, -32768, 32767);
+}
+
+// min..max -> 0..255
+BYTE scale_trigger(int32_t value, int32_t min, int32_t range)
+{
+	if (range <= 0)
+		return 0;
+	return (BYTE)std::clamp<int64_t>((int64_t)(value - min) * 255 / range, 0, 255);
+}
+
+// the two bits of a hat axis: negative, positive.
+void set_hat(WORD& buttons, WORD negative, WORD positive, int32_t value)
+{
+	buttons &= ~(negative|positive);
+	if (value < 0)
+		buttons |= negative;
+	else if (value > 0)
+		buttons |= positive;
+}
+
+input_event make_event(uint16_t type, uint16_t code, int32_t value)
+{
+	input_event e = {};
+	e.type = type;
+	e.code = code;
+	e.value = value;
+	return e;
+}
+
+} // namespace
+
+WORD evdev_button(uint16_t code)
+{
+	switch (code) {
+	case BTN_SOUTH:			return XINPUT_GAMEPAD_A;
+	case BTN_EAST:			return XINPUT_GAMEPAD_B;
+	case BTN_NORTH:			return XINPUT_GAMEPAD_Y;
+	case BTN_WEST:			return XINPUT_GAMEPAD_X;
+	case BTN_TL:			return XINPUT_GAMEPAD_LEFT_SHOULDER;
+	case BTN_TR:			return XINPUT_GAMEPAD_RIGHT_SHOULDER;
+	case BTN_SELECT:		return XINPUT_GAMEPAD_BACK;
+	case BTN_START:			return XINPUT_GAMEPAD_START;
+	case BTN_MODE:			return GAMEPAD_GUIDE;
+	case BTN_THUMBL:		return XINPUT_GAMEPAD_LEFT_THUMB;
+	case BTN_THUMBR:		return XINPUT_GAMEPAD_RIGHT_THUMB;
+	case BTN_DPAD_UP:		return XINPUT_GAMEPAD_DPAD_UP;
+	case BTN_DPAD_DOWN:		return XINPUT_GAMEPAD_DPAD_DOWN;
+	case BTN_DPAD_LEFT:		return XINPUT_GAMEPAD_DPAD_LEFT;
+	case BTN_DPAD_RIGHT:	return XINPUT_GAMEPAD_DPAD_RIGHT;
+	default:				return 0;
+	}
+}
+
+evdev_source_t::evdev_source_t(device_registry_t& devices)
+	: _registry(&devices)
+{
+}
+
+evdev_source_t::~evdev_source_t()
+{
+	close();
+}
+
+bool evdev_source_t::open()
+{
+	close();
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	_wake = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+	if (_epoll < 0 || _wake < 0) {
+		close();
+		return false;
+	}
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = WAKE_ID;
+	if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &ev) < 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void evdev_source_t::close()
+{
+	for (auto id: _open) {
+		::close(_devices[id].fd);
+		_registry->detach(id);
+	}
+	for (auto fd: { _inotify, _wake, _epoll })
+		if (fd >= 0)
+			::close(fd);
+	_epoll = _wake = _inotify = -1;
+	_devices.clear();
+	_open.clear();
+	_lost.clear();
+	_backlog.clear();
+}
+
+bool evdev_source_t::watch(const char* dir)
+{
+	if (_epoll < 0 || _inotify >= 0)
+		return false;
+
+	// watched before the scan, so a pad plugged in meanwhile is not missed.
+	// IN_ATTRIB: udev gives access to a new node after it is created.
+	_inotify = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+	if (_inotify < 0)
+		return false;
+	if (inotify_add_watch(_inotify, dir, IN_CREATE|IN_ATTRIB) < 0) {
+		::close(_inotify);
+		_inotify = -1;
+		return false;
+	}
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = WATCH_ID;
+	epoll_ctl(_epoll, EPOLL_CTL_ADD, _inotify, &ev);
+
+	_dir = dir;
+	scan(_dir);
+	return true;
+}
+
+void evdev_source_t::scan(const std::string& dir)
+{
+	auto d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (auto e = readdir(d))
+		added(e->d_name, strlen(e->d_name));
+	closedir(d);
+}
+
+void evdev_source_t::added(const char* name, size_t length)
+{
+	if (length < 5 || strncmp(name, "event", 5) != 0)
+		return;
+
+	auto path = _dir + "/" + std::string(name, length);
+	for (auto id: _open)
+		if (_devices[id].path == path)
+			return;
+	add_device(path.c_str());
+}
+
+device_id_t evdev_source_t::add_device(const char* path)
+{
+	auto fd = ::open(path, O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+	if (fd < 0)
+		return device_registry_t::NONE;
+
+	unsigned long keys[KEY_CNT / LONG_BITS + 1] = {};
+	if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 || !test_bit(keys, BTN_GAMEPAD)) {
+		::close(fd);
+		return device_registry_t::NONE;
+	}
+
+	// the serial number if the driver knows it, else the port, which stays
+	// the same when the pad is plugged in again; the node number does not.
+	char uniq[256] = {};
+	char phys[256] = {};
+	ioctl(fd, EVIOCGUNIQ(sizeof(uniq) - 1), uniq);
+	ioctl(fd, EVIOCGPHYS(sizeof(phys) - 1), phys);
+	std::string key = "evdev/";
+	key += uniq[0] ? uniq : phys[0] ? phys : path;
+	// two pads of one port, or of a driver without either.
+	for (auto id: _open)
+		if (_registry->key(id) == key)
+			key += std::string("/") + path;
+
+	auto id = add(fd, path, key);
+	if (id == device_registry_t::NONE) {
+		::close(fd);
+		return id;
+	}
+	sync(_devices[id]);
+
+	char name[256] = {};
+	ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+	GP_LOG_INFO("evdev: \"{}\" ({}) as device {}", name, path, id);
+	return id;
+}
+
+device_id_t evdev_source_t::add_stream(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return add(fd, "", "evdev/stream/" + std::to_string(_streams++));
+}
+
+device_id_t evdev_source_t::add(int fd, std::string path, const std::string& key)
+{
+	if (_epoll < 0)
+		return device_registry_t::NONE;
+
+	auto id = _registry->id(key);
+	if (id == device_registry_t::NONE)
+		return id;
+
+	epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.u64 = (uint64_t)id;
+	if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return device_registry_t::NONE;
+
+	if (id >= (int)_devices.size())
+		_devices.resize(id + 1);
+	auto& d = _devices[id];
+	d = device_t();
+	d.fd = fd;
+	d.path = std::move(path);
+	insert_sorted(_open, id);
+	_registry->attach(id);
+
+	auto axis = [&](uint16_t code, axis_kind_t kind, int32_t min, int32_t max) {
+		d.axes[code] = axis_t{ kind, min, max - min };
+	};
+	axis(ABS_X, lx, -32768, 32767);
+	axis(ABS_Y, ly, -32768, 32767);
+	axis(ABS_RX, rx, -32768, 32767);
+	axis(ABS_RY, ry, -32768, 32767);
+	axis(ABS_Z, lt, 0, 255);
+	axis(ABS_RZ, rt, 0, 255);
+	axis(ABS_BRAKE, lt, 0, 255);
+	axis(ABS_GAS, rt, 0, 255);
+	axis(ABS_HAT0X, hat_x, -1, 1);
+	axis(ABS_HAT0Y, hat_y, -1, 1);
+	return id;
+}
+
+void evdev_source_t::remove(device_id_t id)
+{
+	auto& d = _devices[id];
+	epoll_ctl(_epoll, EPOLL_CTL_DEL, d.fd, nullptr);
+	::close(d.fd);
+	if (!d.path.empty())
+		GP_LOG_INFO("evdev: {} removed, device {}", d.path, id);
+
+	// a pad plugged in again before the next poll() is reported lost first.
+	if (d.connected)
+		_lost.push_back(id);
+	d = device_t();
+	erase_sorted(_open, id);
+	_registry->detach(id);
+}
+
+void evdev_source_t::sync(device_t& d)
+{
+	// a stream cannot be asked; its next report tells the state.
+	if (d.path.empty())
+		return;
+
+	unsigned long abs[ABS_CNT / LONG_BITS + 1] = {};
+	unsigned long keys[KEY_CNT / LONG_BITS + 1] = {};
+	ioctl(d.fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs);
+	ioctl(d.fd, EVIOCGKEY(sizeof(keys)), keys);
+
+	d.pending = {};
+	for (uint16_t code = 0; code < ABS_CNT; ++code) {
+		auto& axis = d.axes[code];
+		input_absinfo info;
+		if (axis.kind == none || !test_bit(abs, code) || ioctl(d.fd, EVIOCGABS(code), &info) < 0)
+			continue;
+		axis.min = info.minimum;
+		axis.range = info.maximum - info.minimum;
+		apply(d, make_event(EV_ABS, code, info.value));
+	}
+	for (uint16_t code = BTN_JOYSTICK; code <= BTN_DPAD_RIGHT; ++code)
+		apply(d, make_event(EV_KEY, code, test_bit(keys, code) ? 1 : 0));
+	apply(d, make_event(EV_SYN, SYN_REPORT, 0));
+}
+
+bool evdev_source_t::apply(device_t& d, const input_event& e)
+{
+	auto& pad = d.pending;
+
+	if (d.dropped) {
+		// the events up to the report are incomplete; the device is asked instead.
+		if (e.type != EV_SYN || e.code != SYN_REPORT)
+			return false;
+		d.dropped = false;
+		pad = d.state.Gamepad;
+		if (!d.path.empty()) {
+			auto buttons = d.state.Gamepad.wButtons;
+			sync(d);
+			return buttons != d.state.Gamepad.wButtons;
+		}
+		return false;
+	}
+
+	switch (e.type) {
+	case EV_KEY:
+		if (e.code == BTN_TL2 && d.digital_lt)
+			pad.bLeftTrigger = e.value ? 255 : 0;
+		else if (e.code == BTN_TR2 && d.digital_rt)
+			pad.bRightTrigger = e.value ? 255 : 0;
+		else if (auto bit = evdev_button(e.code))
+			pad.wButtons = e.value ? (pad.wButtons | bit) : (pad.wButtons & ~bit);
+		return false;
+
+	case EV_ABS: {
+		if (e.code >= ABS_CNT)
+			return false;
+		auto& axis = d.axes[e.code];
+		switch (axis.kind) {
+		case lx:	pad.sThumbLX = scale_stick(e.value, axis.min, axis.range); break;
+		// evdev is positive downward, XInput upward.
+		case ly:	pad.sThumbLY = (SHORT)(-1 - scale_stick(e.value, axis.min, axis.range)); break;
+		case rx:	pad.sThumbRX = scale_stick(e.value, axis.min, axis.range); break;
+		case ry:	pad.sThumbRY = (SHORT)(-1 - scale_stick(e.value, axis.min, axis.range)); break;
+		case lt:
+			d.digital_lt = false;
+			pad.bLeftTrigger = scale_trigger(e.value, axis.min, axis.range);
+			break;
+		case rt:
+			d.digital_rt = false;
+			pad.bRightTrigger = scale_trigger(e.value, axis.min, axis.range);
+			break;
+		case hat_x:	set_hat(pad.wButtons, XINPUT_GAMEPAD_DPAD_LEFT, XINPUT_GAMEPAD_DPAD_RIGHT, e.value); break;
+		case hat_y:	set_hat(pad.wButtons, XINPUT_GAMEPAD_DPAD_UP, XINPUT_GAMEPAD_DPAD_DOWN, e.value); break;
+		default:	break;
+		}
+		return false;
+	}
+
+	case EV_SYN:
+		if (e.code == SYN_DROPPED) {
+			d.dropped = true;
+			return false;
+		}
+		if (e.code != SYN_REPORT)
+			return false;
+		if (d.connected && memcmp(&pad, &d.state.Gamepad, sizeof(pad)) == 0)
+			return false;
+		{
+			bool buttons = !d.connected || pad.wButtons != d.state.Gamepad.wButtons;
+			d.state.Gamepad = pad;
+			++d.state.dwPacketNumber;
+			d.connected = true;
+			return buttons;
+		}
+
+	default:
+		return false;
+	}
+}
+
+bool evdev_source_t::pump(device_t& d)
+{
+	for (;;) {
+		while (d.end - d.begin >= sizeof(input_event)) {
+			input_event e;
+			memcpy(&e, d.buffer + d.begin, sizeof(e));
+			d.begin += sizeof(e);
+			if (apply(d, e))
+				return true; // the rest waits for the next tick
+		}
+
+		// a partial record moves to the front, to be completed by the next read.
+		auto left = d.end - d.begin;
+		memmove(d.buffer, d.buffer + d.begin, left);
+		d.begin = 0;
+		d.end = left;
+
+		auto n = ::read(d.fd, d.buffer + d.end, BUFFER - d.end);
+		if (n > 0) {
+			d.end += (size_t)n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		// 0 is the end of a stream, ENODEV an unplugged device.
+		return n < 0 && errno == EAGAIN;
+	}
+}
+
+bool evdev_source_t::wait(int timeout)
+{
+	// the events already read are applied without sleeping.
+	if (!_backlog.empty())
+		timeout = 0;
+
+	// the pads beyond the events of a call are left for the next one.
+	epoll_event events[64];
+	auto n = epoll_wait(_epoll, events, (int)std::size(events), timeout);
+
+	bool woken = false;
+	_ready.swap(_backlog);
+	_backlog.clear();
+	for (int k = 0; k < n; ++k) {
+		auto id = events[k].data.u64;
+		if (id == WAKE_ID) {
+			uint64_t count;
+			while (::read(_wake, &count, sizeof(count)) > 0)
+				;
+			woken = true;
+		}
+		else if (id == WATCH_ID) {
+			alignas(inotify_event) char buf[4096];
+			ssize_t len;
+			while ((len = ::read(_inotify, buf, sizeof(buf))) > 0) {
+				for (auto p = buf; p < buf + len; ) {
+					auto e = (const inotify_event*)p;
+					if (e->len > 0)
+						added(e->name, strnlen(e->name, e->len));
+					p += sizeof(inotify_event) + e->len;
+				}
+			}
+		}
+		else {
+			_ready.push_back((device_id_t)id);
+		}
+	}
+
+	// a pad with a backlog may have an event too.
+	std::sort(_ready.begin(), _ready.end());
+	_ready.erase(std::unique(_ready.begin(), _ready.end()), _ready.end());
+	for (auto id: _ready) {
+		if (_devices[id].fd < 0)
+			continue;
+		auto& d = _devices[id];
+		if (!pump(d))
+			remove(id);
+		else if (d.end - d.begin >= sizeof(input_event))
+			_backlog.push_back(id);
+	}
+	_ready.clear();
+	return !woken;
+}
+
+void evdev_source_t::wake()
+{
+	uint64_t one = 1;
+	::write(_wake, &one, sizeof(one));
+}
+
+DWORD evdev_source_t::read(DWORD slot, XINPUT_STATE* state)
+{
+	if (!connected((device_id_t)slot))
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*state = _devices[slot].state;
+	return ERROR_SUCCESS;
+}
+
+int evdev_source_t::count() const
+{
+	int n = 0;
+	for (auto id: _open)
+		if (_devices[id].connected)
+			++n;
+	return n;
+}
+
+void check_evdev(uint32_t* pstatus, evdev_source_t& source, poller_t& poller, latency_stats_t* latency)
+{
+	auto status = *pstatus;
+
+	snapshot_t<settings_t>::reader_t settings(g_settings);
+	uint64_t version = 0;
+	poll_scheduler_t scheduler(poller.polling());
+	bool active = false;
+	poller.attach(source.devices());
+
+	for (;;) {
+		// without a moving stick nothing happens until the next event, and a
+		// reloaded configuration can wait for it too.
+		int timeout = active ? (int)std::max<uint32_t>(1, (scheduler.min_interval() + 500) / 1000) : -1;
+		source.wait(timeout);
+		if (status != *pstatus)
+			break;
+
+		if (version != g_settings.version()) {
+			version = g_settings.version();
+			poller.configure(settings.enter());
+			settings.leave();
+		}
+
+		auto polled = now_ns();
+		poller.begin(polled / 1000, polled);
+		source.poll(
+			[&](device_id_t i, const XINPUT_STATE& input, bool packet_changed) {
+				poller.state(i, input, packet_changed);
+			},
+			[&](device_id_t i) {
+				poller.disconnect(i);
+			});
+		poller.end();
+		if (latency)
+			latency->record(latency_stage_t::poll, now_ns() - polled);
+		active = poller.active();
+	}
+}
+
+} // namespace gpmouse
+
+#endif // defined(__linux__)
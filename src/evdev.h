@@ -0,0 +1,173 @@
+#ifndef GPMOUSE_EVDEV_H
+#define GPMOUSE_EVDEV_H
+#pragma once
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <linux/input.h>
+
+#include "platform.h"
+
+#include "source.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+class poller_t;
+class latency_stats_t;
+
+// The bit of wButtons an evdev key code stands for, 0 if none.
+// The codes of Documentation/input/gamepad.rst, by the position of the
+// button: BTN_NORTH is Y and BTN_WEST is X, as on an Xbox pad.
+WORD evdev_button(uint16_t code);
+
+// The pads of the Linux input subsystem, in the model of XInput.
+// The kernel sends the pads as events, so nothing is polled: wait() sleeps
+// in epoll_wait until a pad, a hot-plug or wake() has something, and reads
+// every event there is. A pad is a device node (/dev/input/event*) or any
+// stream of input_event records, such as a pipe replaying a capture.
+// Every report (SYN_REPORT) which changes the pad advances its packet
+// number, and a report which changes the buttons ends the reads of its pad
+// until the next wait(), so that no press between two ticks is lost.
+// A pad is a device of devices, known by the unique id or the physical
+// path the driver gives it, so it gets its id back when plugged in again.
+// The slots of read() are the device ids.
+// One thread only, but wake().
+class evdev_source_t: public input_source_t
+{
+public:
+	explicit evdev_source_t(device_registry_t& devices);
+	evdev_source_t(const evdev_source_t&) = delete;
+	evdev_source_t& operator=(const evdev_source_t&) = delete;
+	~evdev_source_t();
+
+	// the epoll and the eventfd of wake(). false if they cannot be made.
+	bool open();
+	void close();
+
+	// adds the gamepads of dir now and when they are plugged in later.
+	bool watch(const char* dir = "/dev/input");
+	// opens a device node and adds it if it is a gamepad.
+	// Returns its device id, or NONE.
+	device_id_t add_device(const char* path);
+	// adds a stream of input_event records, which the source then owns.
+	// A stream has no absinfo: the sticks are taken as -32768..32767, the
+	// triggers as 0..255 and the hats as -1..1, the ranges of xpad.
+	// Returns its device id, or NONE if devices is full.
+	device_id_t add_stream(int fd);
+
+	// reads the events of the pads, after sleeping up to timeout [ms] for
+	// them (-1: until there are some). false if woken up by wake().
+	bool wait(int timeout);
+	// makes the current or the next wait() return. Any thread.
+	void wake();
+
+	DWORD read(DWORD slot, XINPUT_STATE* state) override;
+
+	// Calls on_disconnect(id) for every pad which has been lost since the
+	// last call, then on_state(id, state, changed) for every connected pad
+	// in the order of the ids, where changed tells whether it has a report
+	// since the last call, as slot_tracker_t::poll() does.
+	// Costs the pads of the source only, not the empty ids.
+	template <typename F, typename G>
+	void poll(F&& on_state, G&& on_disconnect);
+
+	bool connected(device_id_t id) const {
+		return id >= 0 && id < (int)_devices.size() && _devices[id].connected;
+	}
+	int count() const;
+	const device_registry_t& devices() const { return *_registry; }
+	// some pad has events read but not yet applied; wait() will not sleep.
+	bool backlog() const { return !_backlog.empty(); }
+
+private:
+	enum axis_kind_t: uint8_t { none, lx, ly, rx, ry, lt, rt, hat_x, hat_y };
+
+	struct axis_t
+	{
+		axis_kind_t kind = none;
+		int32_t min = 0;
+		int32_t range = 0;	// max - min
+	};
+
+	static constexpr size_t BUFFER = 64 * sizeof(input_event);
+
+	struct device_t
+	{
+		int fd = -1;
+		std::string path;	// empty for a stream
+		bool connected = false;	// has a state
+		bool dropped = false;	// SYN_DROPPED: the events are skipped up to the next report
+		bool digital_lt = true;	// BTN_TL2 is the trigger, as there is no axis for it
+		bool digital_rt = true;
+		DWORD reported = 0;		// the packet number at the last poll()
+		XINPUT_GAMEPAD pending = {};	// the events since the last report
+		XINPUT_STATE state = {};
+		axis_t axes[ABS_CNT];
+		// the bytes read but not applied yet; a pipe may split a record.
+		uint8_t buffer[BUFFER];
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	device_id_t add(int fd, std::string path, const std::string& key);
+	void remove(device_id_t id);
+	void sync(device_t& d);
+	void scan(const std::string& dir);
+	void added(const char* name, size_t length);
+	// reads and applies the events of a pad. false at the end of the stream.
+	bool pump(device_t& d);
+	// applies an event; true if it is a report which changes the buttons.
+	bool apply(device_t& d, const input_event& e);
+
+	device_registry_t* _registry;
+	int _epoll = -1;
+	int _wake = -1;
+	int _inotify = -1;
+	std::string _dir;
+	uint32_t _streams = 0;	// the number of streams added, their keys
+	// by device id; the ids of the other sources stay closed.
+	std::vector<device_t> _devices;
+	std::vector<device_id_t> _open;		// ascending
+	std::vector<device_id_t> _lost;		// since the last poll()
+	std::vector<device_id_t> _backlog;	// with records left in their buffer
+	std::vector<device_id_t> _ready;	// of a wait()
+};
+
+template <typename F, typename G>
+void evdev_source_t::poll(F&& on_state, G&& on_disconnect)
+{
+	for (auto id: _lost)
+		on_disconnect(id);
+	_lost.clear();
+
+	for (auto id: _open) {
+		auto& d = _devices[id];
+		if (!d.connected)
+			continue;
+		bool changed = d.reported != d.state.dwPacketNumber;
+		d.reported = d.state.dwPacketNumber;
+		on_state(id, d.state, changed);
+	}
+}
+
+// check_xinput over the evdev pads: a tick for every batch of events, and
+// ticks at the active rate of polling while some stick or trigger is out of
+// its deadzone, as the cursor has to keep moving. While every pad rests, it
+// sleeps in epoll_wait without a timeout. The pads take their controller
+// profiles by the device keys of source.
+// Returns when *pstatus changes; source.wake() has to follow the change.
+void check_evdev(uint32_t* pstatus, evdev_source_t& source, poller_t& poller, latency_stats_t* latency = nullptr);
+
+} // namespace gpmouse
+
+#endif // defined(__linux__)
+
+#endif // ndef GPMOUSE_EVDEV_H
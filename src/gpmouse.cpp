@@ -5,13 +5,26 @@
 #include "framework.h"
 #include "gpmouse.h"
 #include "config.h"
+#include "poll.h"
+#include "output.h"
+#include "stick.h"
+#include "process.h"
+#include "bindings.h"
+#include "alloc.h"
+#include "log.h"
+#include "repeat.h"
+#include "settings.h"
+#include "engine.h"
+#include "record.h"
+#include "latency.h"
 #include <string>
 #include <thread>
 #include <array>
 #include <bitset>
-#include <regex>
 #include <format>
 #include <unordered_map>
+#include <unordered_set>
+#include <mutex>
 #include <stdint.h>
 #include <assert.h>
 
@@ -19,9 +32,11 @@
 #include <psapi.h>
 #include <xinput.h>
 #include <shellapi.h>
+#include <timeapi.h>
 
 #pragma comment(lib, "Synchronization.lib")
 #pragma comment(lib, "xinput.lib")
+#pragma comment(lib, "winmm.lib")
 #ifdef ENABLE_GUIDE_BUTTON
     static DWORD (WINAPI *XInputGetStateEx)(DWORD user_index, XINPUT_STATE* state);
     static HMODULE xinput_dll = 0;
@@ -35,562 +50,320 @@
 using namespace gpmouse;
 
 
-
-#define INTERVAL 10
-#define FPS (1000/INTERVAL)
-
-struct point_t
-{
-    float x;
-    float y;
-};
-bool operator==(const point_t& a, const point_t& b)
-{
-    return a.x == b.x && a.y == b.y;
-}
-
-enum class mouse_button_t : uint32_t
-{
-    invalid = 0,
-    left = 0x0002,
-    right = 0x0008,
-    middle = 0x0020,
-};
-
-enum class stick_mode_t : uint32_t
-{
-    mouse = 0,
-    touch = 2,
-    multi_touch = 3,
-    MAX = 3,
-};
-struct input_state_t
-{
-    stick_mode_t stick_mode;
-    std::bitset<256> keys;
-    bool single; // {^̓ȂĂȂ
-    //std::bitset<4> modifiers;
-    uint16_t modifiers;
-    uint16_t vk_buttons[16]; // ݃{^ǂ̃L[ɃoChĂ邩B
-    point_t touch_start[2];
-    POINTER_TOUCH_INFO touch[2];
-};
-input_state_t g_input_state = {};
-
-
-
 UINT send_input(UINT n, INPUT* inputs)
 {
 #ifdef _DEBUG
-    auto logger = get_logger();
-    logger->debug("---------- send_input ------------");
-    logger->debug("number of input: {}", n);
+    GP_LOG_DEBUG("---------- send_input ------------");
+    GP_LOG_DEBUG("number of input: {}", n);
     for (auto i = inputs; i - inputs < n; ++i) {
         if (i->type == INPUT_MOUSE) {
             // TODO:
-            logger->debug("<mouse_input>");
+            GP_LOG_DEBUG("<mouse_input>");
         }
         else if (i->type == INPUT_KEYBOARD) {
             bool up = i->ki.dwFlags == KEYEVENTF_KEYUP;
-            logger->debug("<kbd_input {} {}>", vk_name(i->ki.wVk), up ? "Up" : "Down");
+            GP_LOG_DEBUG("<kbd_input {} {}>", vk_name(i->ki.wVk), up ? "Up" : "Down");
         }
         //logger->debug("i.type
     }
-    logger->debug("----------------------------------");
+    GP_LOG_DEBUG("----------------------------------");
 #endif
     return SendInput(n, inputs, sizeof(INPUT));
 }
-UINT send_input(std::vector<INPUT>& inputs)
+class sendinput_sink_t: public output_sink_t
 {
-    return send_input(inputs.size(), inputs.data());
-}
+public:
+    UINT send(UINT n, INPUT* inputs) override {
+        return send_input(n, inputs);
+    }
+};
 
-void calibrate_stick_params(stick_params_t& params, const XINPUT_GAMEPAD& in)
-{
-    params.cursor.cx = in.sThumbLX;
-    params.cursor.cy = in.sThumbLY;
-    params.scroll.cx = in.sThumbRX;
-    params.scroll.cy = in.sThumbRY;
-    params.initialized = true;
-    // TODO: check Xbh handle XbhŎQƂ̂ŁAoAKv
-}
 
-void move_cursor(const point_t& move)
-{
-    INPUT i = {};
-    i.type = INPUT_MOUSE;
-    i.mi.dx = (int)move.x;
-    i.mi.dy = (int)(move.y * -1);
-    i.mi.dwFlags = MOUSEEVENTF_MOVE;
-    send_input(1, &i);
-}
-void left_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input)
+// Win32 implementation of the window and process queries.
+// Every cached process is watched by a thread pool wait, so the name is
+// dropped from the cache when the process exits and its id is reused.
+class win32_window_system_t: public window_system_t
 {
-    auto x = input.sThumbLX - cfg.cx;
-    auto y = input.sThumbLY - cfg.cy;
-
-    if (x*x + y*y <= cfg.deadzone * cfg.deadzone)
-        return;
-
-    float accel = 0.0f;
-    if (cfg.left_trigger == trigger_function_t::acceleration)
-        accel = std::max<float>(accel, input.bLeftTrigger);
-    if (cfg.right_trigger == trigger_function_t::acceleration)
-        accel = std::max<float>(accel, input.bRightTrigger);
-    //OutputDebugStringA(std::format("raw accel: {}\n", accel).c_str());
-
-    if (cfg.accel_type == accel_type_t::linear)
-        accel = accel * (cfg.accel_max - 1) / 255 + 1;
-    else {
-        //OutputDebugStringA(std::format("exp(accel): {}, max: {}, exp(255): {}\n", exp((double)accel), cfg.accel_max, exp(255)).c_str());
-        //accel = exp(accel - 255) * (cfg.accel_max - 1) + 1;
-        accel = pow(cfg.accel_max, accel/255.);
-    }
-    //OutputDebugStringA(std::format("accel: {}\n", accel).c_str());
-
-    float brake = 0.0f;
-    if (cfg.left_trigger == trigger_function_t::deacceleration)
-        brake = std::max<float>(brake, input.bLeftTrigger);
-    if (cfg.right_trigger == trigger_function_t::deacceleration)
-        brake = std::max<float>(brake, input.bRightTrigger);
-    brake = brake * (cfg.deaccel_max - 1) / 255 + 1;
-
-    // Remark: dy ̌vZ SM_CXSCREEN gĂ̂͊ԈႢł͂ȂB
-    //   SM_CXSCREEN ŌvZƁAcƉŃJ[\̃Xs[hĂ܂߁A
-    //   Y SM_CXSCREEN ŌvZĂBXN[́̕AcƉ
-    //   ĂĂ肪Ȃ߁ASM_CYSCREEN gB
-    auto dx = cfg.base_speed * x * accel / (GetSystemMetrics(SM_CXSCREEN) * brake);
-    auto dy = cfg.base_speed * y * accel / (GetSystemMetrics(SM_CXSCREEN) * brake);
-
-    if (g_input_state.stick_mode == stick_mode_t::mouse) {
-        INPUT i = {};
-        i.type = INPUT_MOUSE;
-        i.mi.dx = (int)dx;
-        i.mi.dy = (int)(dy * -1);
-        i.mi.dwFlags = MOUSEEVENTF_MOVE;
-        //i.mi.time = 0;
-        send_input(1, &i);
+public:
+    ~win32_window_system_t() {
+        unwatch_all();
     }
-    else {
+
+    void attach(process_cache_t* cache) {
+        _cache = cache;
     }
-}
-void vscroll(float s)
-{
-    INPUT input;
-    input.type = INPUT_MOUSE;
-    input.mi.mouseData = (DWORD)s;
-    input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-    input.mi.time = 0;
-    send_input(1, &input);
-}
-void hscroll(float s)
-{
-    INPUT input;
-    input.type = INPUT_MOUSE;
-    input.mi.mouseData = (DWORD)s;
-    input.mi.dwFlags = MOUSEEVENTF_HWHEEL;
-    input.mi.time = 0;
-    send_input(1, &input);
-}
-void right_stick(const stick_t& cfg, const XINPUT_GAMEPAD& input)
-{
-    auto x = input.sThumbRX - cfg.cx;
-    auto y = input.sThumbRY - cfg.cy;
-
-    if (x * x + y * y <= cfg.deadzone * cfg.deadzone)
-        return;
-
-    float accel = 0.0f;
-    if (cfg.left_trigger == trigger_function_t::acceleration)
-        accel = std::max<float>(accel, input.bLeftTrigger);
-    if (cfg.right_trigger == trigger_function_t::acceleration)
-        accel = std::max<float>(accel, input.bRightTrigger);
-    accel = accel * (cfg.accel_max - 1) / 255 + 1;
-
-    float brake = 0.0f;
-    if (cfg.left_trigger == trigger_function_t::deacceleration)
-        brake = std::max<float>(brake, input.bLeftTrigger);
-    if (cfg.right_trigger == trigger_function_t::deacceleration)
-        brake = std::max<float>(brake, input.bRightTrigger);
-    brake = brake * (cfg.deaccel_max - 1) / 255 + 1;
-
-    if (g_input_state.stick_mode == stick_mode_t::mouse) {
-        hscroll((float)(x * cfg.base_speed * accel)/(FPS * brake));
-        vscroll((float)(y * cfg.base_speed * accel)/(FPS * brake));
+
+    window_t window_under_cursor() override {
+        POINT pt;
+        if (!GetCursorPos(&pt))
+            return 0;
+        return (window_t)WindowFromPoint(pt);
     }
-    else {
-        g_input_state.stick_mode = stick_mode_t::multi_touch;
 
-        if (g_input_state.touch_start[0] == g_input_state.touch_start[1]) {
-            // ^b`̊Jn
-        }
-        else {
-            //auto new_location = {  }
-            //sendtouch
-        }
+    window_t foreground_window() override {
+        return (window_t)GetForegroundWindow();
     }
-}
 
+    process_id_t process_id(window_t window) override {
+        if (window == 0)
+            return 0;
 
-DWORD get_process_id_under_cursor()
-{
-    POINT pt;
-    GetCursorPos(&pt);
-
-    auto hwnd = WindowFromPoint(pt);
-    if (!hwnd)
-        return 0;
-
-    DWORD pid;
-    if (GetWindowThreadProcessId(hwnd, &pid) == 0)
-        return 0;
-    
-    return pid;
-}
+        DWORD pid;
+        if (GetWindowThreadProcessId((HWND)window, &pid) == 0)
+            return 0;
 
-DWORD get_foreground_process_id()
-{
-    auto hwnd = GetForegroundWindow();
-    if (!hwnd)
-        return 0;
+        return pid;
+    }
 
-    DWORD pid;
-    if (GetWindowThreadProcessId(hwnd, &pid) == 0)
-        return 0;
+    bool executable_name(process_id_t pid, std::string& name) override;
+    void unwatch_all();
 
-    return pid;
-}
+private:
+    struct watch_t
+    {
+        win32_window_system_t* self;
+        process_id_t pid;
+        HANDLE process;
+        HANDLE wait;
+    };
+
+    static void CALLBACK on_process_exit(PVOID context, BOOLEAN timeout);
 
-std::string get_executable_name(DWORD process_id)
+    process_cache_t* _cache = nullptr;
+    std::mutex _lock;
+    std::unordered_set<watch_t*> _watches;
+};
+
+bool win32_window_system_t::executable_name(process_id_t pid, std::string& name)
 {
-    struct handle_t {
-        handle_t(HANDLE handle):
-            _handle(handle) {}
-        ~handle_t() {
-            CloseHandle(_handle);
-        }
-        operator HANDLE() const { return _handle; }
-        operator bool() const { return _handle != 0; }
-        HANDLE _handle;
-    }
-    process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, process_id);
+    auto process = OpenProcess(PROCESS_QUERY_INFORMATION|SYNCHRONIZE, FALSE, pid);
     if (!process)
-        return "";
+        return false;
 
     char buf[MAX_PATH];
-    if (GetModuleFileNameExA(process, 0, buf, ARRAYSIZE(buf)) == MAX_PATH)
-        return "";
+    auto len = GetModuleFileNameExA(process, 0, buf, ARRAYSIZE(buf));
+    if (len == 0 || len == MAX_PATH) {
+        CloseHandle(process);
+        return false;
+    }
 
     // Though there should be at least one '\\' in buf from windows path format specification.
     auto p = strrchr(buf, '\\');
-    if (p == 0)
-        return "";
-
-    return p + 1;
-}
-
-
-void gp_handle_analogue_input(const stick_params_t& config, const XINPUT_GAMEPAD& input)
-{
-    left_stick(config.cursor, input);
-    right_stick(config.scroll, input);
-}
-
-keystate_t g_prev_keys = {};
+    name = p ? p + 1 : "";
 
-keystate_t translate_input(WORD input)
-{
-#ifdef _DEBUG
-    auto log = get_logger();
-#endif
-    key_binding_t v{.buttons=input};
-    auto [lb, ub] = std::equal_range(g_key_bindings.begin(), g_key_bindings.end(), v);
-    
-    auto N = __popcnt16(input);
-
-    keystate_t keys = {};
-    if (lb == ub) { // the combination of buttons is not defined
-        // X̃{^̃L[oCfBOgݍ킹
-        DWORD i, mask = input;
-        while (BitScanForward(&i, mask)) {
-            auto& b = g_single_button[i];
-            b.fill(keys);
-            mask ^= (1ul << i);
-        }
-    }
-    //else if (lb->process.empty()) { // input ɃAvP[VŗL̃oCfBO͂Ȃ        
-    else if (lb->executable == 0) { // input ɃAvP[VŗL̃oCfBO͂Ȃ        
-        lb->fill(keys);
+    if (_cache == nullptr) {
+        CloseHandle(process);
+        return false;
     }
-    else {
-        auto pid = get_process_id_under_cursor();
-        auto cursor_process = get_executable_name(pid);
-
-        pid = get_foreground_process_id();
-        auto foreground_process = get_executable_name(pid);
 
-#ifdef _DEBUG
-        log->info("finding custom rule");
-        log->info("cursor: \"{}\", foreground: \"{}\", input: {:04X}", cursor_process, foreground_process, input);
-#endif
-
-        for (auto i = lb; i != ub; ++i) {
-#if defined(_DEBUG) // && _MSC_VER == ??
-            if (i->executable == 0)
-                log->info("No custom rule matched");
-            else
-                log->info("Testing \"{}\"", *(std::string*)((char*)i->executable + 48));
-#endif
-            auto& process = i->foreground_window() ? foreground_process : cursor_process;
-            if (i->executable != 0 && !std::regex_match(process, *i->executable))
-                continue;
-            i->fill(keys);
-            break;
-        }
+    // the lock is held until the wait is registered, so the callback never sees a half made watch.
+    std::lock_guard lock(_lock);
+    auto watch = new watch_t{ this, pid, process, 0 };
+    if (!RegisterWaitForSingleObject(&watch->wait, process, on_process_exit, watch, INFINITE, WT_EXECUTEONLYONCE)) {
+        CloseHandle(process);
+        delete watch;
+        return false; // not watched, not cached
     }
-    return keys;
+    _watches.insert(watch);
+    return true;
 }
 
-int keycount(const keystate_t& current, const keystate_t& prev)
+void CALLBACK win32_window_system_t::on_process_exit(PVOID context, BOOLEAN)
 {
-    int N = 0;
-    for (int i = 0; i < 4; ++i) {
-        N += __popcnt64(~current.keys[i] & prev.keys[i]);
-        N += __popcnt64(current.keys[i] & ~prev.keys[i]);
+    auto watch = (watch_t*)context;
+    auto self = watch->self;
+    {
+        std::lock_guard lock(self->_lock);
+        if (self->_watches.erase(watch) == 0)
+            return; // unwatch_all() owns it
     }
-    return N;
+
+    self->_cache->invalidate_process(watch->pid);
+    UnregisterWait(watch->wait);
+    CloseHandle(watch->process);
+    delete watch;
 }
 
-void make_mouse_button_input(INPUT& i, uint8_t vk, bool up)
+void win32_window_system_t::unwatch_all()
 {
-    memset(&i, 0, sizeof(INPUT));
-    i.type = INPUT_MOUSE;
-
-    if (vk == VK_XBUTTON1 || vk == VK_XBUTTON2) {
-        i.mi.mouseData = vk - VK_XBUTTON1 + 1;
-        i.mi.dwFlags = up ? MOUSEEVENTF_XUP : MOUSEEVENTF_XDOWN;
+    std::unordered_set<watch_t*> watches;
+    {
+        std::lock_guard lock(_lock);
+        watches.swap(_watches);
     }
-    else {
-        auto button = vk == VK_LBUTTON ? mouse_button_t::left :
-                        vk == VK_RBUTTON ? mouse_button_t::right :
-                        vk == VK_MBUTTON ? mouse_button_t::middle : mouse_button_t::invalid;
-        assert(button != mouse_button_t::invalid);
 
-        i.mi.dwFlags = up ? ((uint32_t)button << 1) : (uint32_t)button;
+    for (auto watch: watches) {
+        UnregisterWaitEx(watch->wait, INVALID_HANDLE_VALUE); // waits for a running callback
+        CloseHandle(watch->process);
+        delete watch;
     }
 }
 
-void make_kbd_input(INPUT& i, uint8_t vk, bool up) {
-    auto logger = get_logger();
-    logger->debug("{:<20} {}", vk_name(vk), up ? "Up" : "Down");
-
-    memset(&i, 0, sizeof(INPUT));
-    i.type = INPUT_KEYBOARD;
-    i.ki.wVk = vk;
-    i.ki.wScan = MapVirtualKeyW(vk, MAPVK_VK_TO_VSC);
-    if (up)
-        i.ki.dwFlags = KEYEVENTF_KEYUP;
-    if (is_extended_key(vk))
-        i.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+win32_window_system_t g_window_system;
+process_cache_t g_process_cache(g_window_system);
+HWINEVENTHOOK g_foreground_hook = 0;
+
+void CALLBACK on_foreground_changed(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD)
+{
+    g_process_cache.invalidate_foreground();
 }
 
-void gp_handle_buttons_input(WORD buttons, keystate_t& state)
+bool window_hooks_initialize()
 {
-    auto logger = get_logger();
-    logger->debug("buttons: {:04X}", buttons);
-
-    auto input = translate_input(buttons);
-    auto N = keycount(input, state);
-    if (N == 0)
-        return;
-
-    logger->debug("number of inputs: {}", N);
-    std::vector<INPUT> inputs(N);
-    int n = 0;
-    DWORD k;
-
-    // TODO: SHIFT ςȂł up down Ă
-    logger->debug("------ buttons -------");
-    logger->debug("     {:<16} {:<16} {:<16} {:<16}", "input", "state", "up", "down");
-    logger->debug("[00] {:016X} {:016X} {:016X} {:016X}", input.keys[0], state.keys[0], ~input.keys[0] & state.keys[0], input.keys[0] & ~state.keys[0]);
-    logger->debug("[40] {:016X} {:016X} {:016X} {:016X}", input.keys[1], state.keys[1], ~input.keys[1] & state.keys[1], input.keys[1] & ~state.keys[1]);
-    logger->debug("[80] {:016X} {:016X} {:016X} {:016X}", input.keys[2], state.keys[2], ~input.keys[2] & state.keys[2], input.keys[2] & ~state.keys[2]);
-    logger->debug("[C0] {:016X} {:016X} {:016X} {:016X}", input.keys[3], state.keys[3], ~input.keys[3] & state.keys[3], input.keys[3] & ~state.keys[3]);
-    logger->debug("---------------------");
-
-    // mouse up
-    for (int i = 0; i < 4; ++i) {
-        auto r = (~input.keys[i] & state.keys[i]) & MOUSE_EVENTS_MASK[i];
-        logger->debug("mouse up: {:016X} = {:016X} & {:016X} & {:016X}", r, ~input.keys[i], state.keys[i], MOUSE_EVENTS_MASK[i]);
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_mouse_button_input(inputs[n++], vk, true);
-            r ^= (1ull << k);
-        }
-    }
-    // non-modifier key up
-    for (int i = 0; i < 4; ++i) {
-        auto r = (~input.keys[i] & state.keys[i]) & keys_mask(i);
-        logger->debug("non-modifier up: {:016X} = {:016X} & {:016X} & {:016X}", r, ~input.keys[i], state.keys[i], keys_mask(i));
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_kbd_input(inputs[n++], vk, true);
-            r ^= (1ull << k);
-        }
-    }
-    // modifier key up
-    for (int i = 0; i < 4; ++i) {
-        auto r = (~input.keys[i] & state.keys[i]) & MODIFIERS_MASK[i];
-        logger->debug("modifier up: {:016X} = {:016X} & {:016X} & {:016X}", r, ~input.keys[i], state.keys[i], MODIFIERS_MASK[i]);
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_kbd_input(inputs[n++], vk, true);
-            r ^= (1ull << k);
-        }
-    }
-    // modifier key down
-    for (int i = 0; i < 4; ++i) {
-        auto r = (input.keys[i] & ~state.keys[i]) & MODIFIERS_MASK[i];
-        logger->debug("modifier down: {:016X}", r);
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_kbd_input(inputs[n++], vk, false);
-            r ^= (1ull << k);
-        }
-    }
-    // non-modifier key down
-    for (int i = 0; i < 4; ++i) {
-        auto r = (input.keys[i] & ~state.keys[i]) & keys_mask(i);
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_kbd_input(inputs[n++], vk, false);
-            r ^= (1ull << k);
-        }
-    }
-    // mouse down
-    for (int i = 0; i < 4; ++i) {
-        auto r = (input.keys[i] & ~state.keys[i]) & MOUSE_EVENTS_MASK[i];
-        while (BitScanForward64(&k, r)) {
-            uint8_t vk = 64 * i + k;
-            make_mouse_button_input(inputs[n++], vk, false);
-            r ^= (1ull << k);
-        }
-    }
-    send_input(inputs);
+    g_window_system.attach(&g_process_cache);
 
-    state = input;
+    // WINEVENT_OUTOFCONTEXT: called on this thread from its message loop.
+    g_foreground_hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+        0, on_foreground_changed, 0, 0, WINEVENT_OUTOFCONTEXT);
+    return g_foreground_hook != 0;
 }
 
-void repeat_keys(const keystate_t& state)
+void window_hooks_finalize()
 {
-    // TODO: repeatable L[̓AvP[VɂĕςǂB
-    //       AvP[VŏɃs[g邱Ƃ邽߁B
-    int N = 0;
-    for (int i = 0, n = 0; i < std::size(state.keys); ++i) {
-        auto bits = state.keys[i] & repeatable_keys(i);
-        N += __popcnt64(bits);
-    }
-    std::vector<INPUT> inputs(N);
-
-    for (int i = 0, n = 0; i < std::size(state.keys); ++i) {
-        auto bits = state.keys[i] & repeatable_keys(i);
-        DWORD k;
-        while (BitScanForward64(&k, bits)) {
-            uint8_t vk = 64 * i + k;
-            make_kbd_input(inputs[n++], vk, false);
-            bits ^= (1ull << k);
-        }
-    }
-    send_input(inputs);
+    if (g_foreground_hook)
+        UnhookWinEvent(g_foreground_hook);
+    g_foreground_hook = 0;
+
+    g_window_system.unwatch_all();
+    g_window_system.attach(nullptr);
 }
 
-void handle_xinput(uint32_t* pstatus, concurrent_queue<xinput_t>* _queue)
-{
-    const uint32_t handle_interval = 1000/16;
-    const uint64_t repeat_mask = 0x1;
 
+void handle_xinput(uint32_t* pstatus, xinput_queue_t* _queue)
+{
     auto status = *pstatus;
     auto& queue = *_queue;
+    auto& signal = queue.signal();
 
     xinput_t input;
-    keystate_t prev[XUSER_MAX_COUNT];
+    sendinput_sink_t sink;
+    button_handler_t handler(sink, g_process_cache, &g_latency);
+    snapshot_t<settings_t>::reader_t settings(g_settings);
 
     if (!InitializeTouchInjection(2, TOUCH_FEEDBACK_DEFAULT))
         return; // TODO:
 
     try {
-        for (uint64_t n = 0;; ++n) {
-            if (WaitOnAddress(pstatus, &status, sizeof(uint32_t), handle_interval)) {
-                if (status != *pstatus)
-                    break;
-            }
-
-            if (queue.try_pop(input)) {
-                n = 0;
-                do {
-                    gp_handle_buttons_input(input.buttons, prev[input.device]);
-                }
-                while (queue.try_pop(input));
-            }
-            else if ((n & repeat_mask) == 0) {
-                for (auto& state: prev)
-                    if (!state.empty())
-                        repeat_keys(state);
-            }
+        for (;;) {
+            // Read the signal before the queue, so a state pushed after the
+            // queue is drained makes the wait return at once.
+            auto seen = signal.value();
+            if (status != *pstatus)
+                break;
+
+            // a reloaded configuration applies from the next state on.
+            auto& s = settings.enter();
+            auto now = GetTickCount64();
+            handler.repeat(now);
+
+            while (queue.pop(input))
+                handler.handle(s, input, now);
+            settings.leave();
+
+            // sleeps until the next repeat, or until a button changes if no key is repeating.
+            auto deadline = handler.next_deadline();
+            auto timeout = deadline == repeat_scheduler_t::NEVER ? signal_t::INFINITE_WAIT
+                : (uint32_t)(deadline - std::min<uint64_t>(deadline, GetTickCount64()));
+            signal.wait(seen, timeout);
         }
     }
     catch (std::exception& exc) {
-        auto log = get_logger();
-        log->error("exception in handle thread: {}", exc.what());
+        GP_LOG_ERROR("exception in handle thread: {}", exc.what());
         exit(1);
     }
     catch (...) {
-        auto log = get_logger();
-        log->error("unknown exception in handle thread");
+        GP_LOG_ERROR("unknown exception in handle thread");
         exit(100);
     }
-    auto log = get_logger();
-    log->info("Exit handler thread");
+    GP_LOG_INFO("Exit handler thread");
 }
 
-void check_xinput(uint32_t* pstatus, concurrent_queue<xinput_t>* _queue)
+class xinput_source_t: public input_source_t
+{
+public:
+    DWORD read(DWORD slot, XINPUT_STATE* state) override {
+        return XInputGetState(slot, state);
+    }
+};
+
+recorder_t g_recorder;
+latency_stats_t g_latency;
+
+void check_xinput(uint32_t* pstatus, xinput_queue_t* _queue, analog_output_t* output)
 {
     DWORD status = *pstatus;
-    DWORD packet_numbers[XUSER_MAX_COUNT] = {};
-    auto& queue = *_queue;
 
-    XINPUT_STATE input;
+    snapshot_t<settings_t>::reader_t settings(g_settings);
+    uint64_t version = 0;
+    poller_t poller(*_queue, *output, &g_latency);
+
+    poll_scheduler_t scheduler(poller.polling());
+    xinput_source_t source;
+    // the four slots of XInput are devices 0-3.
+    device_registry_t devices;
+    slot_tracker_t slots(poller.polling(), source, devices);
+    poller.attach(devices);
+    auto interval = scheduler.interval();
+    bool high_resolution = false;
+
     for (;;) {
-        if (WaitOnAddress(pstatus, &status, sizeof(uint32_t), 8)) {
+        // WaitOnAddress cannot sleep less than a millisecond.
+        DWORD timeout = std::max<DWORD>(1, (interval + 500) / 1000);
+        if (WaitOnAddress(pstatus, &status, sizeof(uint32_t), timeout)) {
             if (status != *pstatus)
                 break;
         }
 
-        auto timestamp = GetTickCount();
-
-        for (int i = 0; i < XUSER_MAX_COUNT; ++i) {
-            auto& s_params = g_stick_params[i];
-
-            auto err = XInputGetState(i, &input);
-            if (err == ERROR_SUCCESS) {
-                auto& in = input.Gamepad;
-
-                if (!s_params.initialized || in.wButtons == (XINPUT_GAMEPAD_START|XINPUT_GAMEPAD_BACK))
-                    calibrate_stick_params(s_params, input.Gamepad);
-                gp_handle_analogue_input(s_params, in);
-
-                if (packet_numbers[i] != input.dwPacketNumber) {
-                    packet_numbers[i] = input.dwPacketNumber;
-                    xinput_t item{ i, timestamp, in.wButtons };
-                    queue.push(item);
-                }
-            }
-            else if (s_params.initialized) {
-                s_params.initialized = false;
-                packet_numbers[i] = 0;
-            }
+        if (version != g_settings.version()) {
+            version = g_settings.version();
+            poller.configure(settings.enter());
+            settings.leave();
+        }
+
+        auto polled = now_ns();
+        auto start = polled / 1000;
+        poller.begin(start, polled);
+        g_recorder.tick(start);
+
+        slots.poll(start,
+            [&](device_id_t i, const XINPUT_STATE& input, bool packet_changed) {
+                g_recorder.state(i, input, packet_changed);
+                poller.state(i, input, packet_changed);
+            },
+            [&](device_id_t i) {
+                g_recorder.disconnect(i);
+                poller.disconnect(i);
+            });
+
+        poller.end();
+        auto busy = now_ns() - polled;
+        g_latency.record(latency_stage_t::poll, busy);
+
+        auto prev_interval = interval;
+        interval = scheduler.update(start, poller.active(), poller.changed(), busy / 1000);
+        if (interval == prev_interval)
+            continue;
+
+        // The default timer resolution (15.6 ms) is too coarse for the high rate,
+        // but raising it costs power system wide, so raise it only while not idle.
+        if (high_resolution == scheduler.idle()) {
+            high_resolution = !high_resolution;
+            high_resolution ? timeBeginPeriod(1) : timeEndPeriod(1);
         }
+
+        GP_LOG_DEBUG("polling rate: {:.0f} Hz, cpu load: {:.3f}%", scheduler.rate(), scheduler.cpu_load() * 100);
     }
+
+    if (high_resolution)
+        timeEndPeriod(1);
+}
+
+void output_analog(uint32_t* pstatus, analog_output_t* output)
+{
+    sendinput_sink_t sink;
+    output->run(pstatus, sink);
+
+    GP_LOG_INFO("Exit output thread");
 }
 
 bool xinput_initialize()
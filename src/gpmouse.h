@@ -1,8 +1,11 @@
 #pragma once
 
 #include <stdint.h>
-#include <concurrent_queue.h>
 #include "resource.h"
+#include "output.h"
+#include "queue.h"
+#include "record.h"
+#include "latency.h"
 
 
 #define GP_STATUS_INITIALIZING	0u
@@ -15,18 +18,16 @@
 //	uint32_t 
 //};
 
-struct xinput_t
-{
-	int device;
-	DWORD timestamp;
-	WORD buttons;
-};
-
-using Concurrency::concurrent_queue;
-
-
-extern void check_xinput(uint32_t* pstatus, concurrent_queue<xinput_t>* queue);
-extern void handle_xinput(uint32_t* pstatus, concurrent_queue<xinput_t>* queue);
+extern void check_xinput(uint32_t* pstatus, gpmouse::xinput_queue_t* queue, gpmouse::analog_output_t* output);
+extern void handle_xinput(uint32_t* pstatus, gpmouse::xinput_queue_t* queue);
+extern void output_analog(uint32_t* pstatus, gpmouse::analog_output_t* output);
 extern bool xinput_initialize();
 extern bool xinput_finalize();
+extern bool window_hooks_initialize();
+extern void window_hooks_finalize();
+
+// records what check_xinput sees while it is open.
+extern gpmouse::recorder_t g_recorder;
+// the latencies of the button changes of check_xinput and handle_xinput.
+extern gpmouse::latency_stats_t g_latency;
 
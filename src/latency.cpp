@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <algorithm>
+#include <bit>
+#include <fmt/format.h>
+#include <string>
+
+#include "latency.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+constexpr size_t SUB_BUCKETS = 1 << latency_histogram_t::SUB_BITS;
+
+// [ns] -> "12.3us"
+std::string format_duration(uint64_t ns)
+{
+	if (ns < 1000)
+		return fmt::format("{}ns", ns);
+	if (ns < 1000000)
+		return fmt::format("{:.1f}us", ns / 1e3);
+	if (ns < 1000000000)
+		return fmt::format("{:.2f}ms", ns / 1e6);
+	return fmt::format("{:.2f}s", ns / 1e9);
+}
+
+} // namespace
+
+size_t latency_histogram_t::bucket(uint64_t ns)
+{
+	if (ns >= LIMIT)
+		return BUCKETS - 1;
+	// the values below 2 * SUB_BUCKETS have a bucket of their own.
+	if (ns < 2 * SUB_BUCKETS)
+		return (size_t)ns;
+	// the power of two, then the SUB_BITS bits below the highest bit.
+	auto bits = (int)std::bit_width(ns);
+	auto sub = (ns >> (bits - 1 - SUB_BITS)) & (SUB_BUCKETS - 1);
+	return ((size_t)(bits - SUB_BITS) << SUB_BITS) | (size_t)sub;
+}
+
+uint64_t latency_histogram_t::lower_bound(size_t bucket)
+{
+	if (bucket < 2 * SUB_BUCKETS)
+		return bucket;
+	auto bits = (int)(bucket >> SUB_BITS) + SUB_BITS;
+	return (SUB_BUCKETS | (bucket & (SUB_BUCKETS - 1))) << (bits - 1 - SUB_BITS);
+}
+
+latency_histogram_t::summary_t latency_histogram_t::summary() const
+{
+	uint64_t counts[BUCKETS];
+	uint64_t count = 0;
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		counts[i] = _buckets[i].load(std::memory_order_relaxed);
+		count += counts[i];
+	}
+
+	summary_t s;
+	s.count = count;
+	if (count == 0)
+		return s;
+	s.mean = _sum.load(std::memory_order_relaxed) / std::max<uint64_t>(1, _count.load(std::memory_order_relaxed));
+	s.max = _max.load(std::memory_order_relaxed);
+
+	// the upper bound of the bucket which holds the n-th smallest duration,
+	// but no more than the largest one.
+	auto percentile = [&](uint64_t per_mille) {
+		auto n = (count * per_mille + 999) / 1000;
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKETS; ++i) {
+			seen += counts[i];
+			if (seen >= n)
+				return i + 1 < BUCKETS ? std::min(lower_bound(i + 1) - 1, s.max) : s.max;
+		}
+		return s.max;
+	};
+	s.p50 = percentile(500);
+	s.p90 = percentile(900);
+	s.p99 = percentile(990);
+	s.p999 = percentile(999);
+	return s;
+}
+
+const char* latency_stage_name(latency_stage_t stage)
+{
+	switch (stage) {
+	case latency_stage_t::poll:			return "poll";
+	case latency_stage_t::enqueue:		return "enqueue";
+	case latency_stage_t::dequeue:		return "dequeue";
+	case latency_stage_t::translate:	return "translate";
+	case latency_stage_t::emit:			return "emit";
+	case latency_stage_t::total:		return "total";
+	default:							return "?";
+	}
+}
+
+void latency_stats_t::dump(spdlog::logger& logger) const
+{
+	for (size_t i = 0; i < STAGES; ++i) {
+		auto stage = (latency_stage_t)i;
+		auto s = histogram(stage).summary();
+		if (s.count == 0)
+			continue;
+		logger.info("latency {:<9} n={} mean={} p50={} p90={} p99={} p99.9={} max={}",
+			latency_stage_name(stage), s.count, format_duration(s.mean),
+			format_duration(s.p50), format_duration(s.p90), format_duration(s.p99),
+			format_duration(s.p999), format_duration(s.max));
+	}
+}
+
+} // namespace gpmouse
@@ -0,0 +1,111 @@
+#ifndef GPMOUSE_LATENCY_H
+#define GPMOUSE_LATENCY_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include <spdlog/spdlog.h>
+
+#include "queue.h"
+
+
+namespace gpmouse
+{
+
+// Counts of durations [ns] in fixed buckets: four buckets for each power of
+// two, so a bucket is at most 25% wide, from 1 ns up to LIMIT.
+// One thread records, any thread may read; a reader may see a record in the
+// count and not yet in the sum, which does not matter for a report.
+class latency_histogram_t
+{
+public:
+	static constexpr int SUB_BITS = 2;
+	static constexpr int MAX_BITS = 36;	// 68 s
+	static constexpr size_t BUCKETS = ((MAX_BITS - SUB_BITS) << SUB_BITS) + (1 << SUB_BITS);
+	static constexpr uint64_t LIMIT = 1ull << MAX_BITS;
+
+	struct summary_t
+	{
+		uint64_t count = 0;
+		uint64_t mean = 0;
+		uint64_t p50 = 0;
+		uint64_t p90 = 0;
+		uint64_t p99 = 0;
+		uint64_t p999 = 0;
+		uint64_t max = 0;
+	};
+
+	// the recording thread only, without a lock.
+	void record(uint64_t ns) {
+		add(_buckets[bucket(ns)], 1);
+		add(_count, 1);
+		add(_sum, ns);
+		if (ns > _max.load(std::memory_order_relaxed))
+			_max.store(ns, std::memory_order_relaxed);
+	}
+
+	// the percentiles are the upper bounds of their buckets.
+	summary_t summary() const;
+
+	static size_t bucket(uint64_t ns);
+	// the smallest duration of a bucket.
+	static uint64_t lower_bound(size_t bucket);
+
+private:
+	// the counters are written by the recording thread only.
+	static void add(std::atomic<uint64_t>& c, uint64_t v) {
+		c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64_t> _count = 0;
+	std::atomic<uint64_t> _sum = 0;
+	std::atomic<uint64_t> _max = 0;
+	std::atomic<uint64_t> _buckets[BUCKETS] = {};
+};
+
+// The way of a button change from the pad to SendInput. Each stage is
+// recorded by the thread where it ends, from the timestamp where it begins.
+enum class latency_stage_t
+{
+	poll,		// a tick of the polling thread: reading the pads and pushing the changes
+	enqueue,	// the poll of a button state -> pushed to the queue
+	dequeue,	// the poll -> popped by the handler thread
+	translate,	// popped -> translated into keys
+	emit,		// translated -> the keys sent
+	total,		// the poll -> the keys sent
+	count
+};
+
+const char* latency_stage_name(latency_stage_t stage);
+
+// The histograms of every stage, checked against a regression by comparing
+// the dumps of two builds.
+class latency_stats_t
+{
+public:
+	static constexpr size_t STAGES = (size_t)latency_stage_t::count;
+
+	void record(latency_stage_t stage, uint64_t ns) {
+		_stages[(size_t)stage].histogram.record(ns);
+	}
+	const latency_histogram_t& histogram(latency_stage_t stage) const {
+		return _stages[(size_t)stage].histogram;
+	}
+
+	// a line for each stage which has some record, at info level.
+	void dump(spdlog::logger& logger) const;
+
+private:
+	// the stages of the polling and the handler threads on their own lines.
+	struct alignas(CACHE_LINE) stage_t
+	{
+		latency_histogram_t histogram;
+	};
+	stage_t _stages[STAGES];
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_LATENCY_H
@@ -0,0 +1,459 @@
+#include "platform.h"
+#include <stdint.h>
+
+#include <iterator>
+#include <map>
+#include <vector>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+
+#define TOML_TOML11
+#ifdef TOML_TOML11
+	#include <toml.hpp>
+#else
+	#include <toml++/toml.hpp>
+#endif // def TOML_TOML11
+
+#include <magic_enum.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <fmt/format.h>
+
+#include "config.h"
+#include "bindings.h"
+#include "settings.h"
+#include "cache.h"
+
+
+namespace gpmouse
+{
+
+struct app_t {
+	app_id_t id;
+	uint8_t priority;
+};
+
+std::vector<std::string> split_string(const std::string& s, const std::string& delims = " ,&|")
+{
+	std::vector<std::string> ret;
+	return boost::split(ret, s, boost::is_any_of(delims));
+}
+
+#ifdef TOML_TOML11
+template <typename TC, typename K>
+float as_float(const toml::basic_value<TC>& v, const K& k, float default_value)
+{
+	if (v.is_empty())
+		return default_value;
+
+	try {
+		return toml::find<float>(v, k);
+	}
+	catch (toml::type_error& exc) {
+		return toml::find<int64_t>(v, k);
+	}
+	catch (std::out_of_range& exc) {
+		return default_value;
+	}
+}
+
+template <typename TC>
+trigger_config_t load_curve(const toml::basic_value<TC>& v, const char* key, const trigger_config_t& defval)
+{
+	namespace me = magic_enum;
+
+	if (v.is_empty())
+		return defval;
+	auto t = toml::find_or_default<toml::basic_value<TC>>(v, key);
+	if (t.is_empty())
+		return defval;
+
+	trigger_config_t c = defval;
+	c.deadzone = (uint8_t)std::min<uint32_t>(255, toml::find_or<uint32_t>(t, "deadzone", defval.deadzone));
+	c.saturation = (uint8_t)std::min<uint32_t>(255, toml::find_or<uint32_t>(t, "saturation", defval.saturation));
+	c.minval = as_float(t, "min", defval.minval);
+	c.maxval = as_float(t, "max", defval.maxval);
+
+	auto type = toml::find_or<std::string>(t, "type", "");
+	if (!type.empty())
+		c.type = me::enum_cast<analog_function_t>(type, me::case_insensitive).value();
+
+	return c;
+}
+
+// The curves default to the shape implied by accel_type, accel_max and deaccel_max.
+template <typename TC>
+stick_t load_curves(stick_t c, const toml::basic_value<TC>& v)
+{
+	c.accel = load_curve(v, "accel", {
+		.maxval = c.accel_max,
+		.type = c.accel_type == accel_type_t::linear ? analog_function_t::linear : analog_function_t::exp,
+	});
+	c.brake = load_curve(v, "brake", { .maxval = c.deaccel_max });
+	c.magnitude = load_curve(v, "magnitude", c.magnitude);
+	c.bake();
+	return c;
+}
+
+template <typename TC>
+//stick_t load_stick_params(const toml::basic_value<TC>& v, uint32_t deadzone=2500,
+//	acceleration_t accel_type=acceleration_t::exponential,
+//	float base_speed=0.8, float accel_max=8, float deaccel_max=4, 
+//	trigger_function_t lt=trigger_function_t::nop, 
+//	trigger_function_t rt=trigger_function_t::nop)
+stick_t load_stick_params(const toml::basic_value<TC>& v, const stick_t& defval=stick_t())
+{
+	namespace me = magic_enum;
+
+	static const char* trigger_funcion_aliases[][2] = {
+		{ "accel", "acceleration" },
+		{ "deaccel", "deacceleration" },
+	};
+
+	stick_t c = defval;
+
+	if (v.is_empty())
+		return load_curves(c, v);
+
+	c.deadzone = toml::find_or<uint32_t>(v, "deadzone", defval.deadzone);
+	c.accel_type = defval.accel_type;
+	c.base_speed = as_float(v, "base_speed", defval.base_speed);
+	c.accel_max = as_float(v, "accel_max", defval.accel_max);
+	c.deaccel_max = as_float(v, "deaccel_max", defval.deaccel_max);
+
+	try {
+		auto lt = toml::find<std::string>(v, "left_trigger");
+		for (auto pair: trigger_funcion_aliases)
+			if (boost::iequals(lt, pair[0])) {
+				lt = pair[1];
+				break;
+			}
+		c.left_trigger = me::enum_cast<trigger_function_t>(lt, me::case_insensitive).value();
+	}
+	catch (std::out_of_range&) {
+		c.left_trigger = defval.left_trigger;
+	}
+
+	try {
+		auto rt = toml::find<std::string>(v, "right_trigger");
+		for (auto pair: trigger_funcion_aliases)
+			if (boost::iequals(rt, pair[0])) {
+				rt = pair[1];
+				break;
+			}
+		c.right_trigger = me::enum_cast<trigger_function_t>(rt, me::case_insensitive).value();
+	}
+	catch (std::out_of_range&) {
+		c.left_trigger = defval.right_trigger;
+	}
+
+	return load_curves(c, v);
+}
+
+template <typename TC>
+repeat_config_t load_repeat(const toml::basic_value<TC>& v, const repeat_config_t& defval)
+{
+	repeat_config_t c = defval;
+	if (v.is_empty())
+		return c;
+
+	c.delay = toml::find_or<uint32_t>(v, "delay", defval.delay);
+	c.interval = toml::find_or<uint32_t>(v, "interval", defval.interval);
+
+	auto keys = toml::find_or_default<toml::basic_value<TC>>(v, "keys");
+	if (keys.is_string()) {
+		c.keys = {};
+		for (auto& k: split_string(keys.as_string()))
+			c.keys.press(parse_vk_code(k));
+	}
+	else if (!keys.is_empty()) {
+		c.keys = {};
+		for (auto& k: keys.as_array())
+			c.keys.press(parse_vk_code(k.as_string()));
+	}
+	return c;
+}
+
+void load_buttons(const std::vector<toml::value>& buttons, key_binding_t (&single_button)[16])
+{
+	memset(single_button, 0, sizeof(single_button));
+	for (auto& b: buttons) {
+		auto button = parse_button(b["button"].as_string());
+		
+		DWORD i;
+		if (!BitScanForward(&i, button))
+			throw std::runtime_error("unknown button");
+
+		auto& k = single_button[i];
+		k.buttons = button;
+		k.priority = USHRT_MAX;
+		
+		auto modifiers = b["modifiers"];
+		if (modifiers.is_string()) {
+			for (auto m: split_string(modifiers.as_string()))
+				k.add_modifier(m);
+		}
+		else if (!modifiers.is_empty()) {
+			for (auto m: modifiers.as_array())
+				k.add_modifier(m.as_string());
+		}
+
+		auto keys = b["keys"];
+		if (keys.is_string()) {
+			auto ks = split_string(keys.as_string());
+			if (ks.size() > std::size(k.keys))
+				throw std::runtime_error("too many keys");
+			for (int i = 0; i < ks.size(); ++i)
+				k.keys[i] = parse_vk_code(ks[i]);
+		}
+		else if (!keys.is_empty()) {
+			auto ks = keys.as_array();
+			if (ks.size() > std::size(k.keys))
+				throw std::runtime_error("too many keys");
+			for (int i = 0; i < ks.size(); ++i)
+				k.keys[i] = parse_vk_code(ks[i].as_string());
+		}
+	}
+}
+
+// the bindings and the single buttons of c, sorted and compiled.
+void load_bindings(const std::vector<toml::value>& bindings, const std::map<std::string, app_t>& apps, controller_profile_t& c)
+{
+	c.key_bindings.clear();
+	for (auto& binding: bindings) {
+		key_binding_t k = {};
+
+		auto priority = toml::find_or(binding, "priority", 255);
+		k.priority = (priority << 8);
+
+		auto app = toml::find_or_default<std::string>(binding, "app");
+		if (!app.empty()) {
+			auto ri = apps.find(app);
+			if (ri == apps.end()) {
+				// TODO: log? throw?
+				continue;
+			}
+			k.app = ri->second.id;
+			k.priority += ri->second.priority;
+		}
+		else
+			k.priority += UCHAR_MAX;
+		k.foreground_window(toml::find_or_default<bool>(binding, "foreground_window"));
+		k.oneshot(toml::find_or_default<bool>(binding, "oneshot"));
+
+		auto m = binding["modifiers"];
+		if (m.is_string()) {
+			for (auto mod: split_string(m.as_string()))
+				k.add_modifier(mod);
+		}
+		else if (!m.is_empty()) {
+			auto mods = m.as_array();
+			for (auto& mod: mods)
+				k.add_modifier(mod.as_string());
+		}
+
+		auto b = binding["buttons"];
+		if (b.is_string()) {
+			for (auto button: split_string(b.as_string()))
+				k.buttons |= parse_button(button);
+		}
+		else if (!b.is_empty()) {
+			auto buttons = b.as_array();
+			for (auto& button: buttons)
+				k.buttons |= parse_button(button.as_string());
+		}
+
+		auto keys = binding["keys"];
+		if (keys.is_string()) {
+			auto ks = split_string(keys.as_string());
+			if (ks.size() > std::size(k.keys))
+				throw std::runtime_error("too many keys");
+			for (int i = 0; i < ks.size(); ++i)
+				k.keys[i] = parse_vk_code(ks[i]);
+		}
+		else if (!keys.is_empty()) {
+			auto ks = keys.as_array();
+			assert(std::size(k.keys) == 4);
+			if (ks.size() > std::size(k.keys))
+				throw std::runtime_error("too many keys");
+			for (int i = 0; i < ks.size(); ++i)
+				k.keys[i] = parse_vk_code(ks[i].as_string());
+		}
+
+		c.key_bindings.push_back(std::move(k));
+	}
+
+	for (auto& sb: c.single_button)
+		if (sb.buttons != 0)
+			c.key_bindings.push_back(sb);
+
+	std::sort(
+		c.key_bindings.begin(),
+		c.key_bindings.end(),
+		[](auto& a, auto& b){
+			return a.buttons < b.buttons ||
+				a.buttons == b.buttons && a.priority < b.priority; 
+		}
+	);
+	c.binding_table.build(c.key_bindings, c.single_button);
+	c.binding_profiles.clear();
+}
+
+void configure_input(const toml::value& cfg, settings_t& s)
+{
+	std::map<std::string, app_t> apps;
+
+	auto accel = magic_enum::enum_cast<trigger_function_t>("accel");
+	auto acceleration = magic_enum::enum_cast<trigger_function_t>("acceleration");
+
+	auto& c = *s.controllers[0];
+	auto cursor = toml::find_or_default<toml::value>(cfg, "cursor");
+	c.stick_params.cursor = load_stick_params(cursor, { .deadzone=1000, .base_speed=0.3, });
+
+	auto scroll = toml::find_or_default<toml::value>(cfg, "scroll");
+	c.stick_params.scroll = load_stick_params(scroll, { .deadzone = 5000, .accel_type = accel_type_t::linear, .base_speed = 0.01, .accel_max = 16, });
+
+	auto polling = toml::find_or_default<toml::value>(cfg, "polling");
+	s.polling.active_rate = as_float(polling, "active_rate", polling_t().active_rate);
+	s.polling.idle_rate = as_float(polling, "idle_rate", polling_t().idle_rate);
+	s.polling.idle_delay = polling.is_empty() ? polling_t().idle_delay
+		: toml::find_or<uint32_t>(polling, "idle_delay", polling_t().idle_delay);
+	s.polling.probe_interval = polling.is_empty() ? polling_t().probe_interval
+		: toml::find_or<uint32_t>(polling, "probe_interval", polling_t().probe_interval);
+
+	auto buttons = toml::find<std::vector<toml::value>>(cfg, "bindings", "buttons");
+	load_buttons(buttons, c.single_button);
+
+	s.repeat = load_repeat(toml::find_or_default<toml::value>(cfg, "repeat"), default_repeat());
+
+	std::vector<std::tuple<uint8_t, app_id_t, repeat_config_t>> app_repeats;
+	auto apps_cfg = toml::find<std::vector<toml::value>>(cfg, "bindings", "applications");
+	for (auto& app: apps_cfg) {
+		auto name = app["name"].as_string();
+		app_t a {
+			s.app_matcher.add(name, app["pattern"].as_string()),
+			toml::find_or(app, "priority", UCHAR_MAX - 1), 
+		};
+		auto repeat = toml::find_or_default<toml::value>(app, "repeat");
+		if (!repeat.is_empty())
+			app_repeats.emplace_back(a.priority, a.id, load_repeat(repeat, s.repeat));
+		apps.emplace(name, std::move(a));
+	}
+
+	std::stable_sort(app_repeats.begin(), app_repeats.end(),
+		[](auto& a, auto& b){ return std::get<0>(a) < std::get<0>(b); });
+	s.app_repeats.clear();
+	for (auto& [priority, id, repeat]: app_repeats)
+		s.app_repeats.emplace_back(id, repeat);
+
+	auto bindings = toml::find<std::vector<toml::value>>(cfg, "bindings", "binding");
+	load_bindings(bindings, apps, c);
+
+	// [[controllers]]: what a profile does not set is taken from the top level.
+	s.controllers.resize(1);
+	s.controller_matches.clear();
+	auto controllers = toml::find_or_default<std::vector<toml::value>>(cfg, "controllers");
+	if (controllers.size() >= MAX_CONTROLLERS)
+		throw std::runtime_error("too many controllers");
+	for (auto& controller: controllers) {
+		auto p = std::make_unique<controller_profile_t>();
+		p->name = toml::find_or_default<std::string>(controller, "name");
+		p->stick_params = c.stick_params;
+		if (auto v = toml::find_or_default<toml::value>(controller, "cursor"); !v.is_empty())
+			p->stick_params.cursor = load_stick_params(v, c.stick_params.cursor);
+		if (auto v = toml::find_or_default<toml::value>(controller, "scroll"); !v.is_empty())
+			p->stick_params.scroll = load_stick_params(v, c.stick_params.scroll);
+
+		if (controller.contains("buttons"))
+			load_buttons(toml::find<std::vector<toml::value>>(controller, "buttons"), p->single_button);
+		else
+			std::copy(std::begin(c.single_button), std::end(c.single_button), p->single_button);
+		load_bindings(controller.contains("binding")
+			? toml::find<std::vector<toml::value>>(controller, "binding") : bindings, apps, *p);
+
+		controller_match_t m = { (uint8_t)s.controllers.size() };
+		for (auto& id: toml::find_or_default<std::vector<int64_t>>(controller, "slots"))
+			m.ids.push_back((device_id_t)id);
+		for (auto& key: toml::find_or_default<std::vector<std::string>>(controller, "devices"))
+			m.keys.push_back(key);
+		s.controller_matches.push_back(std::move(m));
+		s.controllers.push_back(std::move(p));
+	}
+} // configure_input()
+
+void load_log_config(const toml::value& cfg, log_config_t& log)
+{
+	auto logging_cfg = toml::find<toml::value>(cfg, "logging");
+
+	log.directory = toml::find_or<std::string>(logging_cfg, "directory", log.directory);
+	log.max_size = toml::find_or<size_t>(logging_cfg, "max_size", log.max_size);
+	log.max_files = toml::find_or<size_t>(logging_cfg, "max_files", log.max_files);
+	log.level = toml::find_or_default<std::string>(logging_cfg, "level");
+	log.pattern = toml::find_or_default<std::string>(logging_cfg, "pattern");
+
+	auto format = toml::find_or_default<std::string>(logging_cfg, "format");
+	if (!format.empty()) {
+		// logger->set_formatter(
+	}
+} // load_log_config()
+
+#else
+
+#endif // def TOML_TOML11
+
+std::string read_file(const std::wstring& path)
+{
+	std::ifstream in(file_path(path), std::ios::binary);
+	if (!in)
+		throw std::runtime_error(fmt::format("failed to open {}", to_utf8(path)));
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void load_config(const std::string& text, const std::string& name, settings_t& s)
+{
+	std::istringstream in(text);
+	auto cfg = toml::parse(in, name, toml::spec::v(1, 1, 0));
+
+	load_log_config(cfg, s.log);
+	configure_input(cfg, s);
+}
+
+void configure()
+{
+	// the paths go through file_path() and to_utf8(): the conversions of
+	// std::filesystem depend on the locale.
+	auto dir = application_directory();
+	auto cfg_file = dir + L"gpmouse.toml";
+	auto cache_file = dir + L"gpmouse.cache";
+
+	std::unique_ptr<settings_t> s;
+	if (!std::filesystem::is_regular_file(file_path(cfg_file))) {
+		s = std::make_unique<settings_t>();
+		default_config(*s);
+	}
+	else {
+		// the cache skips parsing, sorting and compiling the patterns of an unchanged file.
+		auto source = read_file(cfg_file);
+		auto key = settings_cache_key(source);
+		s = load_settings_cache(cache_file, key);
+		if (s)
+			configure_log(s->log);
+		else {
+			s = std::make_unique<settings_t>();
+			std::istringstream in(source);
+			auto cfg = toml::parse(in, to_utf8(cfg_file), toml::spec::v(1, 1, 0));
+
+			load_log_config(cfg, s->log);
+			configure_log(s->log);
+			configure_input(cfg, *s);
+			save_settings_cache(cache_file, *s, key);
+		}
+	}
+	g_settings.publish(std::move(s));
+}
+
+} // namespace gpmouse
@@ -0,0 +1,51 @@
+#ifndef GPMOUSE_LOG_H
+#define GPMOUSE_LOG_H
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include "config.h"
+#include "alloc.h"
+
+
+// Logging of the input threads.
+// Calls below GP_LOG_LEVEL are compiled out, and the others check the level
+// of the logger before their arguments are evaluated, so a disabled call
+// costs one comparison. An enabled call may allocate on the input path.
+#ifndef GP_LOG_LEVEL
+#	ifdef _DEBUG
+#		define GP_LOG_LEVEL SPDLOG_LEVEL_DEBUG
+#	else
+#		define GP_LOG_LEVEL SPDLOG_LEVEL_INFO
+#	endif
+#endif
+
+namespace gpmouse
+{
+
+// Logger of the calling thread, without copying the shared_ptr of get_logger().
+// The logger lives until the process exits.
+inline spdlog::logger* thread_logger()
+{
+	thread_local spdlog::logger* logger = get_logger().get();
+	return logger;
+}
+
+} // namespace gpmouse
+
+#define GP_LOG(lvl, ...) \
+	do { \
+		if constexpr ((lvl) >= GP_LOG_LEVEL) { \
+			[[maybe_unused]] ::gpmouse::allow_alloc_scope_t gp_allow_alloc_; \
+			auto gp_logger_ = ::gpmouse::thread_logger(); \
+			if (gp_logger_->should_log((spdlog::level::level_enum)(lvl))) \
+				gp_logger_->log((spdlog::level::level_enum)(lvl), __VA_ARGS__); \
+		} \
+	} while (0)
+
+#define GP_LOG_DEBUG(...)	GP_LOG(SPDLOG_LEVEL_DEBUG, __VA_ARGS__)
+#define GP_LOG_INFO(...)	GP_LOG(SPDLOG_LEVEL_INFO, __VA_ARGS__)
+#define GP_LOG_WARN(...)	GP_LOG(SPDLOG_LEVEL_WARN, __VA_ARGS__)
+#define GP_LOG_ERROR(...)	GP_LOG(SPDLOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // ndef GPMOUSE_LOG_H
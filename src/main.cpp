@@ -10,11 +10,14 @@
 #include <wchar.h>
 #include <windows.h>
 #include <windowsx.h>
+#include <shellapi.h>
 
 #include "framework.h"
 #include "resource.h"
 #include "gpmouse.h"
 #include "config.h"
+#include "settings.h"
+#include "replay.h"
 
 #define APP_MUTEX L"{022E64D2-8A69-49D1-8764-150040109CA2}"
 #define WM_TASKTRAY (WM_APP + 1)
@@ -53,6 +56,101 @@ std::tuple<bool, HANDLE> has_prev_instance()
     return { ec == ERROR_ALREADY_EXISTS, h };
 }
 
+FILETIME last_write_time(const std::wstring& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data);
+    return data.ftLastWriteTime;
+}
+
+// Asks the window to reload gpmouse.toml when the file is written.
+// An editor may write the file several times on save, so the reload waits
+// until the file has been quiet for RELOAD_DELAY.
+void watch_config(uint32_t* pstatus, HWND hwnd)
+{
+    constexpr DWORD POLL_INTERVAL = 250; // ms, to see *pstatus
+    constexpr DWORD RELOAD_DELAY = 200;  // ms
+
+    auto dir = gpmouse::application_directory();
+    auto path = dir + L"gpmouse.toml";
+    auto status = *pstatus;
+    auto change = FindFirstChangeNotificationW(dir.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE|FILE_NOTIFY_CHANGE_FILE_NAME);
+    if (change == INVALID_HANDLE_VALUE)
+        return;
+
+    auto loaded = last_write_time(path);
+    bool pending = false;
+    while (status == *pstatus) {
+        auto r = WaitForSingleObject(change, pending ? RELOAD_DELAY : POLL_INTERVAL);
+        if (r == WAIT_OBJECT_0) {
+            // another file in the directory, e.g. a log, may have been written.
+            auto t = last_write_time(path);
+            if (CompareFileTime(&t, &loaded) != 0) {
+                loaded = t;
+                pending = true;
+            }
+            if (!FindNextChangeNotification(change))
+                break;
+        }
+        else if (r == WAIT_TIMEOUT && pending) {
+            pending = false;
+            PostMessage(hwnd, WM_COMMAND, MAKEWPARAM(IDM_RELOAD, 0), 0);
+        }
+        else if (r != WAIT_TIMEOUT)
+            break;
+    }
+    FindCloseChangeNotification(change);
+}
+
+// Command line options.
+//   --record <file>              records the session (record.h)
+//   --replay <file> <output>     replays a recording without a window and exits
+struct options_t
+{
+    std::wstring record;
+    std::wstring replay;
+    std::wstring replay_output;
+};
+
+options_t parse_command_line()
+{
+    options_t options;
+    int argc = 0;
+    auto argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv == nullptr)
+        return options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (arg == L"--record" && i + 1 < argc)
+            options.record = argv[++i];
+        else if (arg == L"--replay" && i + 2 < argc) {
+            options.replay = argv[++i];
+            options.replay_output = argv[++i];
+        }
+    }
+    LocalFree(argv);
+    return options;
+}
+
+int replay(const options_t& options)
+{
+    using namespace gpmouse;
+
+    snapshot_t<settings_t>::reader_t settings(g_settings);
+    replay_stats_t stats;
+    auto ok = replay_file(options.replay, options.replay_output, settings.enter(), stats);
+    settings.leave();
+    if (!ok) {
+        get_logger()->error("failed to replay the recording");
+        return 1;
+    }
+
+    get_logger()->info("replayed {} ticks, {} states in {} ms: {} input events{}",
+        stats.ticks, stats.states, stats.duration / 1000, stats.inputs, stats.broken ? ", the recording is broken" : "");
+    return 0;
+}
+
 }  // namespace
 
 BOOL Cls_OnCreate(HWND hwnd, LPCREATESTRUCT UNUSED(cs))
@@ -93,19 +191,22 @@ void Cls_OnCommand(HWND hwnd, int id, HWND hWndCtl, UINT codeNotify)
 {
     switch (id) {
     case IDM_RELOAD:
+        // the input threads keep the previous settings if the file is broken.
         try {
-            // TODO: configure is not thread safe.
             gpmouse::configure();
         }
         catch (std::exception& exc) {
-            MessageBoxA(0, exc.what(), "error", MB_OK);
-            exit(-1);
+            MessageBoxA(0, exc.what(), "error", MB_OK|MB_ICONWARNING);
         }
         catch (...) {
-            exit(-2);
+            MessageBoxA(0, "unknown error", "error", MB_OK|MB_ICONWARNING);
         }
         break;
 
+    case IDM_LATENCY:
+        g_latency.dump(*get_logger());
+        break;
+
     case IDM_QUIT:
         PostMessage(hwnd, WM_QUIT, 0, 0);
         break;
@@ -195,6 +296,20 @@ int WINAPI wWinMain(HINSTANCE instance, HINSTANCE UNUSED(prev), LPTSTR cmdline,
 {
     using namespace gpmouse;
 
+    auto options = parse_command_line();
+    if (!options.replay.empty()) {
+        try {
+            configure();
+        }
+        catch (std::exception& exc) {
+            MessageBoxA(0, exc.what(), "error", MB_OK|MB_ICONERROR);
+            return -1;
+        }
+        auto ret = replay(options);
+        spdlog::shutdown();
+        return ret;
+    }
+
     auto [prev, mutex] = has_prev_instance();
     if (prev)
         return 1; // TODO:
@@ -213,12 +328,21 @@ int WINAPI wWinMain(HINSTANCE instance, HINSTANCE UNUSED(prev), LPTSTR cmdline,
         return -1;
     }
 
+    if (!window_hooks_initialize())
+        return (int)GetLastError();
+
+    if (!options.record.empty() && !g_recorder.open(options.record))
+        get_logger()->error("failed to open the recording");
+
     uint32_t status = GP_STATUS_INITIALIZING;
-    concurrent_queue<xinput_t> queue;
+    xinput_queue_t queue(overflow_t::coalesce);
+    analog_output_t output;
     std::thread handler_thread(handle_xinput, &status, &queue);
-    std::thread check_thread(check_xinput, &status, &queue);
+    std::thread output_thread(output_analog, &status, &output);
+    std::thread check_thread(check_xinput, &status, &queue, &output);
 
     auto hwnd = create_tray_window(instance);
+    std::thread watch_thread(watch_config, &status, hwnd);
 
     MSG msg;
     while (GetMessage(&msg, nullptr, 0, 0)) {
@@ -228,11 +352,24 @@ int WINAPI wWinMain(HINSTANCE instance, HINSTANCE UNUSED(prev), LPTSTR cmdline,
     // TODO: close window
 
     UPDATE_GP_STATUS(status, GP_STATUS_TERMINATING);
+    output.stop();
+    queue.signal().notify();
 
     check_thread.join();
     handler_thread.join();
+    watch_thread.join();
+
+    if (g_recorder.is_open()) {
+        g_recorder.close();
+        auto stats = g_recorder.stats();
+        get_logger()->info("recorded {} bytes, {} ticks dropped", stats.written, stats.dropped);
+    }
+    output_thread.join();
+    g_latency.dump(*get_logger());
     
+    window_hooks_finalize();
     xinput_finalize();
+    spdlog::shutdown(); // flushes the async logger
 
     ReleaseMutex(mutex);
     CloseHandle(mutex);
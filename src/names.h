@@ -0,0 +1,149 @@
+#ifndef GPMOUSE_NAMES_H
+#define GPMOUSE_NAMES_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <array>
+#include <bit>
+#include <stdexcept>
+#include <string_view>
+
+
+namespace gpmouse
+{
+
+constexpr char ascii_upper(char c)
+{
+	return 'a' <= c && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+}
+
+constexpr bool iequals(std::string_view a, std::string_view b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (ascii_upper(a[i]) != ascii_upper(b[i]))
+			return false;
+	return true;
+}
+
+// Removes prefix from s if s starts with it, ignoring case.
+constexpr std::string_view strip_prefix(std::string_view s, std::string_view prefix)
+{
+	if (s.size() >= prefix.size() && iequals(s.substr(0, prefix.size()), prefix))
+		s.remove_prefix(prefix.size());
+	return s;
+}
+
+template <typename V>
+struct name_entry_t
+{
+	std::string_view name;
+	V value;
+};
+
+// Case-insensitive name -> value table, built at compile time.
+// It is a perfect hash (hash and displace): the hash of a name selects a
+// bucket, and the displacement of the bucket puts its names in free slots.
+// A lookup hashes the name once and compares it with a single entry.
+// The names must be unique, ASCII and not empty; otherwise the constructor
+// fails to compile.
+template <typename V, size_t N>
+class name_table_t
+{
+public:
+	using entry_t = name_entry_t<V>;
+
+	static constexpr size_t SLOTS = std::bit_ceil(N * 2);
+	static constexpr size_t BUCKETS = std::bit_ceil((N + 3) / 4);
+
+	consteval explicit name_table_t(const std::array<entry_t, N>& entries) {
+		// the entries grouped by bucket, i.e. a counting sort by bucket.
+		uint64_t hashes[N] = {};
+		size_t offsets[BUCKETS + 1] = {};
+		for (size_t i = 0; i < N; ++i) {
+			if (entries[i].name.empty())
+				throw std::logic_error("empty name");
+			hashes[i] = hash(entries[i].name);
+			++offsets[bucket(hashes[i]) + 1];
+		}
+		for (size_t b = 0; b < BUCKETS; ++b)
+			offsets[b + 1] += offsets[b];
+		size_t members[N] = {};
+		size_t next[BUCKETS] = {};
+		for (size_t i = 0; i < N; ++i) {
+			auto b = bucket(hashes[i]);
+			members[offsets[b] + next[b]++] = i;
+		}
+
+		// the largest buckets first, while most slots are free.
+		bool placed[BUCKETS] = {};
+		for (size_t n = 0; n < BUCKETS; ++n) {
+			size_t b = BUCKETS;
+			for (size_t i = 0; i < BUCKETS; ++i)
+				if (!placed[i] && (b == BUCKETS || next[i] > next[b]))
+					b = i;
+			placed[b] = true;
+			place(entries, hashes, members + offsets[b], next[b], b);
+		}
+	}
+
+	// Returns defval if name is not in the table.
+	constexpr V find(std::string_view name, V defval = {}) const {
+		auto h = hash(name);
+		auto& e = _slots[slot(h, _displacement[bucket(h)])];
+		return iequals(e.name, name) ? e.value : defval;
+	}
+
+private:
+	static constexpr uint64_t hash(std::string_view name) {
+		// FNV-1a, then a finalizer so that the bucket and the slot do not depend
+		// on the same bits.
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (auto c: name) {
+			h ^= (uint8_t)ascii_upper(c);
+			h *= 0x100000001b3ull;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		return h;
+	}
+	static constexpr size_t bucket(uint64_t h) {
+		return (size_t)(h >> 48) & (BUCKETS - 1);
+	}
+	static constexpr size_t slot(uint64_t h, uint32_t displacement) {
+		// the step is odd, so the displacements visit every slot.
+		auto step = (uint32_t)(h >> 32) | 1;
+		return ((uint32_t)h + displacement * step) & (SLOTS - 1);
+	}
+
+	constexpr void place(const std::array<entry_t, N>& entries, const uint64_t (&hashes)[N],
+		const size_t* members, size_t n, size_t b) {
+		for (uint32_t d = 0; d < 0x10000; ++d) {
+			bool ok = true;
+			for (size_t i = 0; ok && i < n; ++i) {
+				auto s = slot(hashes[members[i]], d);
+				ok = _slots[s].name.empty();
+				for (size_t j = 0; ok && j < i; ++j)
+					ok = slot(hashes[members[j]], d) != s;
+			}
+			if (!ok)
+				continue;
+
+			_displacement[b] = (uint16_t)d;
+			for (size_t i = 0; i < n; ++i)
+				_slots[slot(hashes[members[i]], d)] = entries[members[i]];
+			return;
+		}
+		throw std::logic_error("duplicate names");
+	}
+
+	uint16_t _displacement[BUCKETS] = {};
+	entry_t _slots[SLOTS] = {}; // free if the name is empty
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_NAMES_H
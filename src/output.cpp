@@ -0,0 +1,135 @@
+#include "platform.h"
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "output.h"
+
+#ifdef _MSC_VER
+#	pragma comment(lib, "Synchronization.lib")
+#endif
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// Longer gaps (e.g. the first sample after idling at a low polling rate)
+// are not integrated as a whole to avoid a sudden jump.
+constexpr uint32_t MAX_ELAPSED_INTERVALS = 4;
+
+template <typename T>
+T take_whole(float velocity, float elapsed, float& remainder)
+{
+	if (velocity == 0) {
+		remainder = 0;
+		return 0;
+	}
+	auto total = velocity * elapsed + remainder;
+	auto whole = (T)total;
+	remainder = total - whole;
+	return whole;
+}
+
+} // namespace
+
+UINT recording_sink_t::send(UINT n, INPUT* in)
+{
+	inputs.insert(inputs.end(), in, in + n);
+	batches.push_back(n);
+	return n;
+}
+
+motion_integrator_t::motion_integrator_t(uint32_t reference_interval):
+	_reference(reference_interval)
+{
+}
+
+analog_frame_t motion_integrator_t::integrate(uint64_t now, const analog_motion_t& v)
+{
+	auto elapsed = _last == 0 || now <= _last ? _reference : now - _last;
+	elapsed = std::min<uint64_t>(elapsed, _reference * MAX_ELAPSED_INTERVALS);
+	_last = now;
+
+	auto scale = (float)elapsed / _reference;
+	return {
+		.dx = take_whole<LONG>(v.dx, scale, _remainder.dx),
+		.dy = take_whole<LONG>(v.dy, scale, _remainder.dy),
+		.hwheel = take_whole<int>(v.hwheel, scale, _remainder.hwheel),
+		.vwheel = take_whole<int>(v.vwheel, scale, _remainder.vwheel),
+	};
+}
+
+void motion_integrator_t::reset()
+{
+	_last = 0;
+	_remainder = {};
+}
+
+void analog_output_t::submit(const analog_frame_t& frame)
+{
+	AcquireSRWLockExclusive(&_lock);
+	_pending += frame;
+	++_sequence;
+	ReleaseSRWLockExclusive(&_lock);
+
+	WakeByAddressSingle(&_sequence);
+}
+
+void analog_output_t::stop()
+{
+	AcquireSRWLockExclusive(&_lock);
+	++_sequence;
+	ReleaseSRWLockExclusive(&_lock);
+
+	WakeByAddressAll(&_sequence);
+}
+
+UINT analog_output_t::flush(output_sink_t& sink)
+{
+	AcquireSRWLockExclusive(&_lock);
+	auto frame = _pending;
+	_pending = {};
+	_flushed = _sequence;
+	ReleaseSRWLockExclusive(&_lock);
+
+	INPUT inputs[3] = {};
+	UINT n = 0;
+	if (frame.dx != 0 || frame.dy != 0) {
+		auto& i = inputs[n++];
+		i.type = INPUT_MOUSE;
+		i.mi.dx = frame.dx;
+		i.mi.dy = frame.dy;
+		i.mi.dwFlags = MOUSEEVENTF_MOVE;
+	}
+	if (frame.hwheel != 0) {
+		auto& i = inputs[n++];
+		i.type = INPUT_MOUSE;
+		i.mi.mouseData = (DWORD)frame.hwheel;
+		i.mi.dwFlags = MOUSEEVENTF_HWHEEL;
+	}
+	if (frame.vwheel != 0) {
+		auto& i = inputs[n++];
+		i.type = INPUT_MOUSE;
+		i.mi.mouseData = (DWORD)frame.vwheel;
+		i.mi.dwFlags = MOUSEEVENTF_WHEEL;
+	}
+	if (n == 0)
+		return 0;
+	return sink.send(n, inputs);
+}
+
+void analog_output_t::run(uint32_t* pstatus, output_sink_t& sink)
+{
+	auto status = *pstatus;
+	for (;;) {
+		auto flushed = _flushed;
+		WaitOnAddress(&_sequence, &flushed, sizeof(uint32_t), INFINITE);
+		if (status != *pstatus)
+			break;
+		flush(sink);
+	}
+}
+
+} // namespace gpmouse
@@ -0,0 +1,127 @@
+#ifndef GPMOUSE_OUTPUT_H
+#define GPMOUSE_OUTPUT_H
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+
+#include "platform.h"
+
+
+namespace gpmouse
+{
+
+// Destination of the injected input events.
+class output_sink_t
+{
+public:
+	virtual ~output_sink_t() = default;
+	virtual UINT send(UINT n, INPUT* inputs) = 0;
+};
+
+// Keeps every batch instead of injecting it.
+class recording_sink_t: public output_sink_t
+{
+public:
+	UINT send(UINT n, INPUT* inputs) override;
+
+	std::vector<INPUT> inputs;
+	std::vector<UINT> batches; // number of inputs in each send() call
+};
+
+// Input events of one send() call, on the stack instead of the heap.
+// A key is either released or pressed by one call and there are 256 virtual
+// keys, so the events made from a keystate_t always fit.
+struct input_batch_t
+{
+	static constexpr UINT CAPACITY = 256;
+
+	INPUT inputs[CAPACITY];
+	UINT size = 0;
+
+	INPUT& push() {
+		assert(size < CAPACITY);
+		return inputs[size++];
+	}
+	bool empty() const {
+		return size == 0;
+	}
+};
+
+// Cursor and wheel motion of one tick.
+struct analog_frame_t
+{
+	LONG dx = 0;
+	LONG dy = 0;
+	int hwheel = 0;
+	int vwheel = 0;
+
+	bool empty() const {
+		return dx == 0 && dy == 0 && hwheel == 0 && vwheel == 0;
+	}
+	analog_frame_t& operator+=(const analog_frame_t& f) {
+		dx += f.dx;
+		dy += f.dy;
+		hwheel += f.hwheel;
+		vwheel += f.vwheel;
+		return *this;
+	}
+};
+
+// Cursor and wheel velocity of one pad, in counts per reference interval.
+struct analog_motion_t
+{
+	float dx = 0;
+	float dy = 0;
+	float hwheel = 0;
+	float vwheel = 0;
+};
+
+// Turns the velocity of one pad into whole counts.
+// The velocity is scaled by the time elapsed since the previous sample, so
+// the speed does not depend on the polling rate, and the fraction which does
+// not make a whole count is carried over to the next sample instead of being
+// truncated away.
+class motion_integrator_t
+{
+public:
+	// reference_interval : the interval the velocities are tuned for [us]
+	explicit motion_integrator_t(uint32_t reference_interval);
+
+	analog_frame_t integrate(uint64_t now, const analog_motion_t& velocity);
+	void reset();
+
+private:
+	uint32_t _reference;
+	uint64_t _last = 0;
+	analog_motion_t _remainder;
+};
+
+// Hands the analog motion over from the polling thread to the output thread.
+// The polling thread only merges its frame into the pending one, and the
+// output thread injects everything pending with a single send() call, so
+// polling never waits on the injection.
+class analog_output_t
+{
+public:
+	// called from the polling thread once per tick.
+	void submit(const analog_frame_t& frame);
+
+	// output thread. returns when *pstatus changes and stop() is called.
+	void run(uint32_t* pstatus, output_sink_t& sink);
+	void stop();
+
+	// sends the pending frame. returns the number of input events sent.
+	UINT flush(output_sink_t& sink);
+
+private:
+	SRWLOCK _lock = SRWLOCK_INIT;
+	analog_frame_t _pending;
+	uint32_t _sequence = 0; // incremented for every submit() and stop()
+	uint32_t _flushed = 0;  // _sequence at the last flush()
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_OUTPUT_H
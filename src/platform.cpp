@@ -0,0 +1,246 @@
+#include <stdint.h>
+#include <string.h>
+#include <array>
+#include <filesystem>
+#include <string>
+
+#include "platform.h"
+
+#if defined(__linux__)
+#	include <unistd.h>
+#endif
+
+
+namespace gpmouse
+{
+
+#if defined(_WIN32)
+
+int screen_width()
+{
+	return GetSystemMetrics(SM_CXSCREEN);
+}
+
+uint16_t scan_code(uint8_t vk)
+{
+	return (uint16_t)MapVirtualKeyW(vk, MAPVK_VK_TO_VSC);
+}
+
+std::wstring executable_path()
+{
+	std::array<wchar_t, 32767 + 1> buf;
+	auto len = GetModuleFileNameW(0, buf.data(), (DWORD)buf.size());
+	if (len == 0 || len == buf.size())
+		return L"";
+	return std::wstring(buf.data(), len);
+}
+
+bool keyboard_repeat(int& delay, DWORD& speed)
+{
+	return SystemParametersInfoW(SPI_GETKEYBOARDDELAY, 0, &delay, 0)
+		&& SystemParametersInfoW(SPI_GETKEYBOARDSPEED, 0, &speed, 0);
+}
+
+std::string to_utf8(const std::wstring& s)
+{
+	if (s.empty())
+		return {};
+	auto n = WideCharToMultiByte(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0, nullptr, nullptr);
+	std::string utf8(n, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, s.data(), (int)s.size(), utf8.data(), n, nullptr, nullptr);
+	return utf8;
+}
+
+std::wstring from_utf8(const std::string& s)
+{
+	if (s.empty())
+		return {};
+	auto n = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+	std::wstring wide(n, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), wide.data(), n);
+	return wide;
+}
+
+std::filesystem::path file_path(const std::wstring& path)
+{
+	return std::filesystem::path(path);
+}
+
+FILE* open_file(const std::wstring& path, const char* mode)
+{
+	auto wmode = std::wstring(mode, mode + strlen(mode));
+	FILE* file = nullptr;
+	return _wfopen_s(&file, path.c_str(), wmode.c_str()) == 0 ? file : nullptr;
+}
+
+#else
+
+namespace {
+
+// MapVirtualKeyW(vk, MAPVK_VK_TO_VSC) of the US layout. An extended key has
+// the code of its twin on the keypad; KEYEVENTF_EXTENDEDKEY tells them apart.
+constexpr std::array<uint8_t, 256> make_scan_codes()
+{
+	std::array<uint8_t, 256> t = {};
+	auto row = [&](const char* keys, uint8_t first) {
+		for (auto p = keys; *p; ++p)
+			t[(uint8_t)*p] = (uint8_t)(first + (p - keys));
+	};
+	row("1234567890", 0x02);
+	row("QWERTYUIOP", 0x10);
+	row("ASDFGHJKL", 0x1E);
+	row("ZXCVBNM", 0x2C);
+	for (int i = 0; i < 10; ++i)
+		t[VK_F1 + i] = (uint8_t)(0x3B + i);
+	t[VK_F11] = 0x57;
+	t[VK_F12] = 0x58;
+
+	t[VK_ESCAPE] = 0x01;
+	t[VK_BACK] = 0x0E;
+	t[VK_TAB] = 0x0F;
+	t[VK_RETURN] = 0x1C;
+	t[VK_SPACE] = 0x39;
+	t[VK_CAPITAL] = 0x3A;
+	t[VK_NUMLOCK] = 0x45;
+	t[VK_SCROLL] = 0x46;
+	t[VK_SNAPSHOT] = 0x54;
+
+	t[VK_SHIFT] = t[VK_LSHIFT] = 0x2A;
+	t[VK_RSHIFT] = 0x36;
+	t[VK_CONTROL] = t[VK_LCONTROL] = t[VK_RCONTROL] = 0x1D;
+	t[VK_MENU] = t[VK_LMENU] = t[VK_RMENU] = 0x38;
+	t[VK_LWIN] = 0x5B;
+	t[VK_RWIN] = 0x5C;
+	t[VK_APPS] = 0x5D;
+
+	t[VK_OEM_MINUS] = 0x0C;
+	t[VK_OEM_PLUS] = 0x0D;
+	t[VK_OEM_4] = 0x1A;
+	t[VK_OEM_6] = 0x1B;
+	t[VK_OEM_1] = 0x27;
+	t[VK_OEM_7] = 0x28;
+	t[VK_OEM_3] = 0x29;
+	t[VK_OEM_5] = 0x2B;
+	t[VK_OEM_COMMA] = 0x33;
+	t[VK_OEM_PERIOD] = 0x34;
+	t[VK_OEM_2] = 0x35;
+	t[VK_OEM_102] = 0x56;
+
+	t[VK_NUMPAD7] = t[VK_HOME] = 0x47;
+	t[VK_NUMPAD8] = t[VK_UP] = 0x48;
+	t[VK_NUMPAD9] = t[VK_PRIOR] = 0x49;
+	t[VK_SUBTRACT] = 0x4A;
+	t[VK_NUMPAD4] = t[VK_LEFT] = 0x4B;
+	t[VK_NUMPAD5] = 0x4C;
+	t[VK_NUMPAD6] = t[VK_RIGHT] = 0x4D;
+	t[VK_ADD] = 0x4E;
+	t[VK_NUMPAD1] = t[VK_END] = 0x4F;
+	t[VK_NUMPAD2] = t[VK_DOWN] = 0x50;
+	t[VK_NUMPAD3] = t[VK_NEXT] = 0x51;
+	t[VK_NUMPAD0] = t[VK_INSERT] = 0x52;
+	t[VK_DECIMAL] = t[VK_DELETE] = 0x53;
+	t[VK_MULTIPLY] = 0x37;
+	t[VK_DIVIDE] = 0x35;
+	return t;
+}
+
+constexpr auto SCAN_CODES = make_scan_codes();
+
+} // namespace
+
+int screen_width()
+{
+	return 1920;
+}
+
+uint16_t scan_code(uint8_t vk)
+{
+	return SCAN_CODES[vk];
+}
+
+std::wstring executable_path()
+{
+	// the link is in the bytes of the file system, UTF-8 by convention;
+	// path::wstring() would convert it by the locale.
+	std::error_code ec;
+	auto path = std::filesystem::read_symlink("/proc/self/exe", ec);
+	return ec ? L"" : from_utf8(path.native());
+}
+
+bool keyboard_repeat(int&, DWORD&)
+{
+	return false;
+}
+
+// std::filesystem converts wide strings by the locale, which is "C" unless
+// the program sets it, and throws on anything but ASCII: wchar_t is UTF-32
+// here, so both ways are done by hand.
+std::string to_utf8(const std::wstring& s)
+{
+	std::string utf8;
+	utf8.reserve(s.size());
+	for (auto w: s) {
+		auto c = (uint32_t)w;
+		if (c > 0x10ffff || (0xd800 <= c && c < 0xe000))
+			c = 0xfffd;
+		if (c < 0x80)
+			utf8 += (char)c;
+		else if (c < 0x800) {
+			utf8 += (char)(0xc0 | c >> 6);
+			utf8 += (char)(0x80 | (c & 0x3f));
+		}
+		else if (c < 0x10000) {
+			utf8 += (char)(0xe0 | c >> 12);
+			utf8 += (char)(0x80 | (c >> 6 & 0x3f));
+			utf8 += (char)(0x80 | (c & 0x3f));
+		}
+		else {
+			utf8 += (char)(0xf0 | c >> 18);
+			utf8 += (char)(0x80 | (c >> 12 & 0x3f));
+			utf8 += (char)(0x80 | (c >> 6 & 0x3f));
+			utf8 += (char)(0x80 | (c & 0x3f));
+		}
+	}
+	return utf8;
+}
+
+std::wstring from_utf8(const std::string& s)
+{
+	std::wstring wide;
+	wide.reserve(s.size());
+	for (size_t i = 0; i < s.size(); ) {
+		auto b = (uint8_t)s[i++];
+		uint32_t c;
+		int n;
+		if (b < 0x80) { c = b; n = 0; }
+		else if ((b & 0xe0) == 0xc0) { c = b & 0x1f; n = 1; }
+		else if ((b & 0xf0) == 0xe0) { c = b & 0x0f; n = 2; }
+		else if ((b & 0xf8) == 0xf0) { c = b & 0x07; n = 3; }
+		else { wide += (wchar_t)0xfffd; continue; }
+
+		int k = 0;
+		for (; k < n && i < s.size() && ((uint8_t)s[i] & 0xc0) == 0x80; ++k)
+			c = c << 6 | ((uint8_t)s[i++] & 0x3f);
+		// truncated, overlong, a surrogate or past U+10FFFF.
+		static constexpr uint32_t MIN[] = { 0, 0x80, 0x800, 0x10000 };
+		if (k < n || c < MIN[n] || c > 0x10ffff || (0xd800 <= c && c < 0xe000))
+			c = 0xfffd;
+		wide += (wchar_t)c;
+	}
+	return wide;
+}
+
+std::filesystem::path file_path(const std::wstring& path)
+{
+	// a narrow string is taken as it is.
+	return std::filesystem::path(to_utf8(path));
+}
+
+FILE* open_file(const std::wstring& path, const char* mode)
+{
+	return fopen(file_path(path).c_str(), mode);
+}
+
+#endif
+
+} // namespace gpmouse
@@ -0,0 +1,53 @@
+#ifndef GPMOUSE_PLATFORM_H
+#define GPMOUSE_PLATFORM_H
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#	include <xinput.h>
+#else
+#	include "win32_compat.h"
+#endif
+
+
+namespace gpmouse
+{
+
+// What the engine asks the system for, apart from the pads (input_source_t),
+// the injection (output_sink_t) and the windows (window_system_t).
+// platform.cpp implements them for each platform.
+
+// the width of the primary screen [pixel], the divisor of the cursor speed.
+// 1920 where there is no screen to ask.
+int screen_width();
+
+// the scan code (set 1) of a virtual key, 0 if it has none.
+uint16_t scan_code(uint8_t vk);
+
+// the path of the running executable.
+std::wstring executable_path();
+
+// a wide string in UTF-8 and back, whatever the locale. An invalid
+// character becomes U+FFFD.
+std::string to_utf8(const std::wstring& s);
+std::wstring from_utf8(const std::string& s);
+
+// a path the engine keeps as a wide string, for the file functions: as it is
+// on Windows, to_utf8() elsewhere.
+std::filesystem::path file_path(const std::wstring& path);
+// fopen() of file_path(path).
+FILE* open_file(const std::wstring& path, const char* mode);
+
+// the keyboard repeat of the control panel.
+// delay : 0 (250 ms) - 3 (1 s), speed : 0 (about 2.5 Hz) - 31 (about 30 Hz)
+// false where the system has no such setting.
+bool keyboard_repeat(int& delay, DWORD& speed);
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_PLATFORM_H
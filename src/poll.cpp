@@ -0,0 +1,118 @@
+#include "platform.h"
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+#include "poll.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+constexpr float LOAD_SMOOTHING = 0.05f;
+
+uint32_t rate_to_interval(float rate)
+{
+	if (rate <= 0)
+		return 1000000;
+	return (uint32_t)std::clamp(1e6f / rate, 1.0f, 1e6f);
+}
+
+bool out_of_deadzone(int x, int y, uint16_t deadzone)
+{
+	return x*x + y*y > deadzone * deadzone;
+}
+
+} // namespace
+
+poll_scheduler_t::poll_scheduler_t(const polling_t& cfg):
+	_cfg(&cfg)
+{
+	_interval = max_interval();
+}
+
+uint32_t poll_scheduler_t::min_interval() const
+{
+	return rate_to_interval(_cfg->active_rate);
+}
+
+uint32_t poll_scheduler_t::max_interval() const
+{
+	return std::max(rate_to_interval(_cfg->idle_rate), min_interval());
+}
+
+uint32_t poll_scheduler_t::update(uint64_t now, bool active, bool changed, uint64_t busy)
+{
+	if (_last_tick != 0 && now > _last_tick) {
+		auto load = std::min(1.0f, (float)busy / (float)(now - _last_tick));
+		_load += (load - _load) * LOAD_SMOOTHING;
+	}
+	_last_tick = now;
+
+	if (active || changed) {
+		// jump to the full rate at once, so that the first movement is not delayed.
+		_last_activity = now;
+		_interval = min_interval();
+	}
+	else if (now - _last_activity >= _cfg->idle_delay * 1000ull) {
+		// back off gradually toward the idle rate.
+		_interval = std::min(_interval * 2, max_interval());
+	}
+	return _interval;
+}
+
+slot_tracker_t::slot_tracker_t(const polling_t& cfg, input_source_t& source, device_registry_t& devices):
+	_cfg(&cfg),
+	_source(&source),
+	_devices(&devices)
+{
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i)
+		_slots[i].device = devices.id("xinput/" + std::to_string(i));
+}
+
+int slot_tracker_t::count() const
+{
+	int n = 0;
+	for (auto& slot: _slots)
+		if (slot.connected)
+			++n;
+	return n;
+}
+
+bool is_active(const stick_params_t& params, const XINPUT_GAMEPAD& in)
+{
+	return out_of_deadzone(in.sThumbLX - params.cursor.cx, in.sThumbLY - params.cursor.cy, params.cursor.deadzone)
+		|| out_of_deadzone(in.sThumbRX - params.scroll.cx, in.sThumbRY - params.scroll.cy, params.scroll.deadzone)
+		|| in.bLeftTrigger > XINPUT_GAMEPAD_TRIGGER_THRESHOLD
+		|| in.bRightTrigger > XINPUT_GAMEPAD_TRIGGER_THRESHOLD;
+}
+
+uint64_t now_ns()
+{
+#if defined(_WIN32)
+	static const auto freq = []{
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return f.QuadPart;
+	}();
+
+	LARGE_INTEGER c;
+	QueryPerformanceCounter(&c);
+	return (uint64_t)(c.QuadPart / freq * 1000000000 + c.QuadPart % freq * 1000000000 / freq);
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t now_us()
+{
+	return now_ns() / 1000;
+}
+
+} // namespace gpmouse
@@ -0,0 +1,127 @@
+#ifndef GPMOUSE_POLL_H
+#define GPMOUSE_POLL_H
+#pragma once
+
+#include <stdint.h>
+
+#include "platform.h"
+
+#include "config.h"
+#include "source.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+// Decides how long check_xinput sleeps between two ticks.
+// The caller passes the current time in, so the policy can be driven by
+// any monotonic clock (or by a synthetic one).
+class poll_scheduler_t
+{
+public:
+	explicit poll_scheduler_t(const polling_t& cfg);
+
+	// now     : current time [us]
+	// active  : some stick or trigger is out of its deadzone
+	// changed : the packet number of some pad has changed since the last tick
+	// busy    : time spent to poll the pads in this tick [us]
+	// returns the interval to the next tick [us].
+	uint32_t update(uint64_t now, bool active, bool changed, uint64_t busy);
+
+	uint32_t interval() const { return _interval; }
+	float rate() const { return 1e6f / _interval; }
+	// ratio of the time spent in ticks to the wall time (smoothed)
+	float cpu_load() const { return _load; }
+	bool idle() const { return _interval >= max_interval(); }
+
+	uint32_t min_interval() const;
+	uint32_t max_interval() const;
+
+private:
+	const polling_t* _cfg;
+	uint32_t _interval;
+	uint64_t _last_activity = 0;
+	uint64_t _last_tick = 0;
+	float _load = 0;
+};
+
+// Tracks which XInput slots have a pad connected.
+// Reading an empty slot is much more expensive than reading a connected one,
+// so connected slots are read on every tick, while empty slots are only
+// probed once per probe_interval.
+// Each slot is a device of devices ("xinput/<slot>"), attached while a pad
+// is connected to it. The ids are taken in the order of the slots, so they
+// are the slots when XInput is the first source.
+class slot_tracker_t
+{
+public:
+	slot_tracker_t(const polling_t& cfg, input_source_t& source, device_registry_t& devices);
+
+	// Calls on_state(id, state, changed) for every connected slot, where
+	// changed tells whether the packet number differs from the last read,
+	// and on_disconnect(id) for every slot which has just been lost.
+	// id is the device id of the slot.
+	template <typename F, typename G>
+	void poll(uint64_t now, F&& on_state, G&& on_disconnect);
+
+	bool connected(int i) const { return _slots[i].connected; }
+	device_id_t device(int i) const { return _slots[i].device; }
+	int count() const;
+
+private:
+	struct slot_t
+	{
+		device_id_t device = device_registry_t::NONE;
+		bool connected = false;
+		DWORD packet_number = 0;
+		uint64_t next_probe = 0;
+	};
+
+	const polling_t* _cfg;
+	input_source_t* _source;
+	device_registry_t* _devices;
+	slot_t _slots[XUSER_MAX_COUNT];
+};
+
+template <typename F, typename G>
+void slot_tracker_t::poll(uint64_t now, F&& on_state, G&& on_disconnect)
+{
+	XINPUT_STATE state;
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i) {
+		auto& slot = _slots[i];
+		if (slot.device == device_registry_t::NONE)
+			continue; // more pads than the registry takes
+		if (!slot.connected && now < slot.next_probe)
+			continue;
+
+		if (_source->read(i, &state) != ERROR_SUCCESS) {
+			if (slot.connected) {
+				slot.connected = false;
+				slot.packet_number = 0;
+				_devices->detach(slot.device);
+				on_disconnect(slot.device);
+			}
+			slot.next_probe = now + _cfg->probe_interval * 1000ull;
+			continue;
+		}
+
+		bool changed = !slot.connected || slot.packet_number != state.dwPacketNumber;
+		if (!slot.connected)
+			_devices->attach(slot.device);
+		slot.connected = true;
+		slot.packet_number = state.dwPacketNumber;
+		on_state(slot.device, state, changed);
+	}
+}
+
+bool is_active(const stick_params_t& params, const XINPUT_GAMEPAD& in);
+
+// monotonic clock in nanoseconds, from the performance counter
+uint64_t now_ns();
+// now_ns() in microseconds
+uint64_t now_us();
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_POLL_H
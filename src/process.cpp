@@ -0,0 +1,103 @@
+#include <stdint.h>
+
+#include "process.h"
+#include "alloc.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// Past this, drop the whole cache instead of remembering every process.
+constexpr size_t MAX_PENDING = 256;
+
+} // namespace
+
+process_cache_t::process_cache_t(window_system_t& ws):
+	_ws(&ws)
+{
+}
+
+std::string_view process_cache_t::under_cursor()
+{
+	if (_dirty.load(std::memory_order_acquire))
+		apply_invalidations();
+	return executable_name(_ws->process_id(_ws->window_under_cursor()));
+}
+
+std::string_view process_cache_t::foreground()
+{
+	if (_dirty.load(std::memory_order_acquire))
+		apply_invalidations();
+	if (!_foreground_valid) {
+		_foreground = _ws->process_id(_ws->foreground_window());
+		_foreground_valid = true;
+	}
+	return executable_name(_foreground);
+}
+
+std::string_view process_cache_t::executable_name(process_id_t pid)
+{
+	auto n = _names.find(pid);
+	if (n != _names.end()) {
+		++_stats.hits;
+		return n->second;
+	}
+
+	++_stats.misses;
+	allow_alloc_scope_t miss;
+	_uncached.clear();
+	if (pid != 0 && _ws->executable_name(pid, _uncached))
+		return _names.emplace(pid, std::move(_uncached)).first->second;
+	return _uncached;
+}
+
+void process_cache_t::invalidate_foreground()
+{
+	std::lock_guard lock(_lock);
+	_foreground_changed = true;
+	_dirty.store(true, std::memory_order_release);
+}
+
+void process_cache_t::invalidate_process(process_id_t pid)
+{
+	std::lock_guard lock(_lock);
+	if (_exited.size() < MAX_PENDING)
+		_exited.push_back(pid);
+	else
+		_clear = true;
+	_dirty.store(true, std::memory_order_release);
+}
+
+void process_cache_t::clear()
+{
+	std::lock_guard lock(_lock);
+	_clear = true;
+	_dirty.store(true, std::memory_order_release);
+}
+
+void process_cache_t::apply_invalidations()
+{
+	std::lock_guard lock(_lock);
+	_dirty.store(false, std::memory_order_relaxed);
+
+	if (_clear || _foreground_changed)
+		_foreground_valid = false;
+
+	if (_clear)
+		_names.clear();
+	else {
+		for (auto pid: _exited) {
+			_names.erase(pid);
+			if (pid == _foreground)
+				_foreground_valid = false;
+		}
+	}
+
+	_clear = false;
+	_foreground_changed = false;
+	_exited.clear();
+}
+
+} // namespace gpmouse
@@ -0,0 +1,96 @@
+#ifndef GPMOUSE_PROCESS_H
+#define GPMOUSE_PROCESS_H
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+
+namespace gpmouse
+{
+
+using window_t = uintptr_t;
+using process_id_t = uint32_t;
+
+class process_cache_t;
+
+// Queries on windows and processes used to find the application of a binding.
+class window_system_t
+{
+public:
+	virtual ~window_system_t() = default;
+
+	virtual window_t window_under_cursor() = 0;
+	virtual window_t foreground_window() = 0;
+	virtual process_id_t process_id(window_t window) = 0;
+	// Returns false if the name must not be cached, i.e. the exit of the
+	// process will not be notified with process_cache_t::invalidate_process().
+	virtual bool executable_name(process_id_t pid, std::string& name) = 0;
+};
+
+// Neither a window under the cursor nor in the foreground, as in a replay or
+// where there is no window system to ask: only the bindings of no
+// application apply.
+class no_window_system_t: public window_system_t
+{
+public:
+	window_t window_under_cursor() override { return 0; }
+	window_t foreground_window() override { return 0; }
+	process_id_t process_id(window_t) override { return 0; }
+	bool executable_name(process_id_t, std::string&) override { return false; }
+};
+
+// Process -> executable name cache, plus the process of the foreground window.
+// Window -> process is not cached: GetWindowThreadProcessId is cheap, while a
+// window handle can be reused by another process at any time.
+// Lookups are made by a single thread (the handler thread). The invalidate
+// functions can be called from any thread; they are applied on the next lookup.
+class process_cache_t
+{
+public:
+	struct stats_t
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+
+	explicit process_cache_t(window_system_t& ws);
+
+	// The executable name of the window, empty if there is none.
+	// The name stays valid until the next lookup, which may drop it.
+	std::string_view under_cursor();
+	std::string_view foreground();
+
+	void invalidate_foreground();
+	void invalidate_process(process_id_t pid);
+	void clear();
+
+	const stats_t& stats() const { return _stats; }
+
+private:
+	std::string_view executable_name(process_id_t pid);
+	void apply_invalidations();
+
+	window_system_t* _ws;
+	std::unordered_map<process_id_t, std::string> _names;
+	std::string _uncached;	// the last name which may not be cached
+	bool _foreground_valid = false;
+	process_id_t _foreground = 0;
+	stats_t _stats;
+
+	// pending invalidations
+	std::atomic<bool> _dirty = false;
+	std::mutex _lock;
+	bool _clear = false;
+	bool _foreground_changed = false;
+	std::vector<process_id_t> _exited;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_PROCESS_H
@@ -0,0 +1,278 @@
+#ifndef GPMOUSE_QUEUE_H
+#define GPMOUSE_QUEUE_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <bit>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#elif defined(__linux__)
+#	include <time.h>
+#	include <unistd.h>
+#	include <sys/syscall.h>
+#	include <linux/futex.h>
+#else
+#	include <chrono>
+#	include <thread>
+#endif
+
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+constexpr size_t CACHE_LINE = 64;
+
+// Bounded single producer / single consumer ring.
+// The indices of both sides are on their own cache lines, and each side
+// keeps a copy of the other side's index so it only reads the shared one
+// when the ring looks full (or empty).
+template <typename T, size_t N>
+class spsc_ring_t
+{
+	static_assert(N != 0 && (N & (N - 1)) == 0, "the capacity must be a power of 2");
+
+public:
+	// producer
+	bool try_push(const T& v) {
+		auto head = _head.load(std::memory_order_relaxed);
+		if (head - _tail_cache == N) {
+			_tail_cache = _tail.load(std::memory_order_acquire);
+			if (head - _tail_cache == N)
+				return false;
+		}
+		_items[head & (N - 1)] = v;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer
+	bool try_pop(T& v) {
+		auto tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head_cache) {
+			_head_cache = _head.load(std::memory_order_acquire);
+			if (tail == _head_cache)
+				return false;
+		}
+		v = _items[tail & (N - 1)];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// number of items pushed so far, producer
+	size_t pushed() const {
+		return _head.load(std::memory_order_relaxed);
+	}
+	// number of items popped so far, consumer
+	size_t popped() const {
+		return _tail.load(std::memory_order_relaxed);
+	}
+
+	// number of items, exact only when called from either side.
+	size_t size() const {
+		auto tail = _tail.load(std::memory_order_acquire);
+		return _head.load(std::memory_order_acquire) - tail;
+	}
+	static constexpr size_t capacity() {
+		return N;
+	}
+
+private:
+	alignas(CACHE_LINE) std::atomic<size_t> _head = 0;
+	size_t _tail_cache = 0;		// producer's copy of _tail
+	alignas(CACHE_LINE) std::atomic<size_t> _tail = 0;
+	size_t _head_cache = 0;		// consumer's copy of _head
+	alignas(CACHE_LINE) T _items[N];
+};
+
+// Counter a thread can sleep on until another thread bumps it.
+// WaitOnAddress on Windows, a futex on Linux.
+class signal_t
+{
+public:
+	static constexpr uint32_t INFINITE_WAIT = UINT32_MAX;
+
+	uint32_t value() const {
+		return _value.load(std::memory_order_acquire);
+	}
+
+	void notify() {
+		_value.fetch_add(1, std::memory_order_release);
+#if defined(_WIN32)
+		WakeByAddressAll(&_value);
+#elif defined(__linux__)
+		syscall(SYS_futex, &_value, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#endif
+	}
+
+	// sleeps while value() == seen, at most timeout [ms].
+	// may return early, the caller checks value() again.
+	void wait(uint32_t seen, uint32_t timeout) {
+#if defined(_WIN32)
+		WaitOnAddress(&_value, &seen, sizeof(seen), timeout == INFINITE_WAIT ? INFINITE : timeout);
+#elif defined(__linux__)
+		timespec ts = { (time_t)(timeout / 1000), (long)(timeout % 1000) * 1000000 };
+		syscall(SYS_futex, &_value, FUTEX_WAIT_PRIVATE, seen, timeout == INFINITE_WAIT ? nullptr : &ts, nullptr, 0);
+#else
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+		while (value() == seen && (timeout == INFINITE_WAIT || std::chrono::steady_clock::now() < deadline))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+	}
+
+private:
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+	std::atomic<uint32_t> _value = 0;
+};
+
+struct xinput_t
+{
+	device_id_t device;
+	uint32_t timestamp;	// now_ns() of the poll, modulo 2^32 (4.3 s)
+	uint16_t buttons;
+	uint8_t controller;	// the controller profile of the device, below MAX_CONTROLLERS
+};
+
+enum class overflow_t
+{
+	drop,		// the state which does not fit is lost
+	coalesce,	// the latest state of each device is kept aside until the handler takes it
+};
+
+// Button states from the polling thread to the handler thread.
+class xinput_queue_t
+{
+public:
+	static constexpr size_t CAPACITY = 64;
+	static constexpr int DEVICES = MAX_DEVICES;
+
+	struct stats_t
+	{
+		uint64_t pushed = 0;
+		uint64_t overflows = 0;
+		uint64_t max_depth = 0;
+	};
+
+	explicit xinput_queue_t(overflow_t policy = overflow_t::coalesce):
+		_policy(policy)
+	{
+	}
+
+	// producer. returns false if the state is dropped.
+	bool push(const xinput_t& v) {
+		auto& latest = _latest[v.device];
+		// Once a device overflows, its states go aside until the handler takes
+		// them, so an older state in the ring never comes after a newer one.
+		if (_policy == overflow_t::coalesce) {
+			auto p = latest.load(std::memory_order_acquire);
+			if (p != 0) {
+				latest.store(pack(v), std::memory_order_release);
+				mark(v.device);
+				count(_overflows);
+				return true;
+			}
+		}
+
+		if (_ring.try_push(v)) {
+			count(_pushed);
+			auto depth = _ring.size();
+			if (depth > _max_depth.load(std::memory_order_relaxed))
+				_max_depth.store(depth, std::memory_order_relaxed);
+			return true;
+		}
+
+		count(_overflows);
+		if (_policy == overflow_t::drop)
+			return false;
+		// the side slot is empty, so pop() does not read the position now.
+		_since[v.device].store(_ring.pushed(), std::memory_order_relaxed);
+		latest.store(pack(v), std::memory_order_release);
+		mark(v.device);
+		return true;
+	}
+
+	// consumer
+	bool pop(xinput_t& v) {
+		if (_ring.try_pop(v))
+			return true;
+
+		// A state set aside is taken only after everything pushed before it.
+		// Only the devices with a state aside are looked at.
+		auto popped = _ring.popped();
+		for (int w = 0; w < ASIDE_WORDS; ++w) {
+			for (auto bits = _aside[w].load(std::memory_order_acquire); bits != 0; bits &= bits - 1) {
+				auto i = w * 64 + std::countr_zero(bits);
+				auto p = _latest[i].load(std::memory_order_acquire);
+				if (p == 0 || popped < _since[i].load(std::memory_order_relaxed))
+					continue;
+				// the bit is cleared first: a state set aside after the exchange sets it again.
+				_aside[w].fetch_and(~(1ull << (i % 64)), std::memory_order_acq_rel);
+				p = _latest[i].exchange(0, std::memory_order_acq_rel);
+				v = unpack(i, p);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// notified by the producer after pushing, and on shutdown.
+	signal_t& signal() {
+		return _signal;
+	}
+
+	size_t depth() const {
+		return _ring.size();
+	}
+	stats_t stats() const {
+		return {
+			_pushed.load(std::memory_order_relaxed),
+			_overflows.load(std::memory_order_relaxed),
+			_max_depth.load(std::memory_order_relaxed),
+		};
+	}
+
+private:
+	// bit 0 : valid, bits 1-7 : controller, bits 16-31 : buttons,
+	// bits 32-63 : timestamp
+	static_assert(MAX_CONTROLLERS <= 0x80);
+	static constexpr int ASIDE_WORDS = (DEVICES + 63) / 64;
+
+	static uint64_t pack(const xinput_t& v) {
+		return 1 | ((uint64_t)(v.controller & 0x7f) << 1)
+			| ((uint64_t)v.buttons << 16) | ((uint64_t)v.timestamp << 32);
+	}
+	// after every store to _latest, as pop() may have just cleared the bit.
+	void mark(device_id_t device) {
+		_aside[device / 64].fetch_or(1ull << (device % 64), std::memory_order_release);
+	}
+	static xinput_t unpack(device_id_t device, uint64_t p) {
+		return { device, (uint32_t)(p >> 32), (uint16_t)(p >> 16), (uint8_t)((p >> 1) & 0x7f) };
+	}
+	// the counters are written by the producer only.
+	static void count(std::atomic<uint64_t>& c) {
+		c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	spsc_ring_t<xinput_t, CAPACITY> _ring;
+	overflow_t _policy;
+	alignas(CACHE_LINE) std::atomic<uint64_t> _latest[DEVICES] = {};
+	// the ring position each state in _latest waits for: the number of
+	// states pushed when its device overflowed, counted in full so that it
+	// never wraps. Written only while the slot is empty, before the state,
+	// and kept by the states coalesced into it.
+	std::atomic<size_t> _since[DEVICES] = {};
+	// a bit for each device with a state in _latest
+	alignas(CACHE_LINE) std::atomic<uint64_t> _aside[ASIDE_WORDS] = {};
+	alignas(CACHE_LINE) signal_t _signal;
+	alignas(CACHE_LINE) std::atomic<uint64_t> _pushed = 0;
+	std::atomic<uint64_t> _overflows = 0;
+	std::atomic<uint64_t> _max_depth = 0;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_QUEUE_H
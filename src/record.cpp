@@ -0,0 +1,380 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "record.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+constexpr char MAGIC[4] = { 'G', 'P', 'M', 'R' };
+
+enum : uint8_t
+{
+	TAG_TICK = 0x00,
+	TAG_DISCONNECT = 0x01,
+	TAG_GAP = 0x02,
+	TAG_STATE = 0x80,
+};
+
+enum : uint8_t
+{
+	FIELD_BUTTONS = 1 << 0,
+	FIELD_LEFT_TRIGGER = 1 << 1,
+	FIELD_RIGHT_TRIGGER = 1 << 2,
+	FIELD_THUMB_LX = 1 << 3,
+	FIELD_THUMB_LY = 1 << 4,
+	FIELD_THUMB_RX = 1 << 5,
+	FIELD_THUMB_RY = 1 << 6,
+};
+
+// the largest tick record, and the largest state record.
+constexpr size_t MAX_TICK = 1 + 10;
+constexpr size_t MAX_STATE = 1 + 5 + 5 + 2 + 1 + 1 + 4 * 3;
+// every connected device may have a state in a tick.
+constexpr size_t MAX_TICK_RECORDS = MAX_TICK + 1 + MAX_DEVICES * MAX_STATE;
+
+// Writes the buffers to the file at least this often [us], so a recording of
+// a crashed session has its last seconds.
+constexpr uint64_t FLUSH_INTERVAL = 1000000;
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+} // namespace
+
+void record_encoder_t::header(std::vector<uint8_t>& out)
+{
+	out.insert(out.end(), MAGIC, MAGIC + sizeof(MAGIC));
+	for (int i = 0; i < 4; ++i)
+		out.push_back((uint8_t)(RECORD_VERSION >> (8 * i)));
+}
+
+void record_encoder_t::tick(std::vector<uint8_t>& out, uint64_t now)
+{
+	if (!_started) {
+		_started = true;
+		_last_tick = now;
+	}
+	out.push_back(TAG_TICK);
+	put_varint(out, now - _last_tick);
+	_last_tick = now;
+}
+
+void record_encoder_t::state(std::vector<uint8_t>& out, device_id_t device, const XINPUT_STATE& s)
+{
+	auto& prev = _prev[device];
+	auto& p = prev.Gamepad;
+	auto& g = s.Gamepad;
+
+	uint8_t mask = 0;
+	if (g.wButtons != p.wButtons) mask |= FIELD_BUTTONS;
+	if (g.bLeftTrigger != p.bLeftTrigger) mask |= FIELD_LEFT_TRIGGER;
+	if (g.bRightTrigger != p.bRightTrigger) mask |= FIELD_RIGHT_TRIGGER;
+	if (g.sThumbLX != p.sThumbLX) mask |= FIELD_THUMB_LX;
+	if (g.sThumbLY != p.sThumbLY) mask |= FIELD_THUMB_LY;
+	if (g.sThumbRX != p.sThumbRX) mask |= FIELD_THUMB_RX;
+	if (g.sThumbRY != p.sThumbRY) mask |= FIELD_THUMB_RY;
+
+	out.push_back(TAG_STATE | mask);
+	put_varint(out, (uint64_t)device);
+	put_varint(out, (uint32_t)(s.dwPacketNumber - prev.dwPacketNumber));
+	if (mask & FIELD_BUTTONS) {
+		out.push_back((uint8_t)g.wButtons);
+		out.push_back((uint8_t)(g.wButtons >> 8));
+	}
+	if (mask & FIELD_LEFT_TRIGGER)
+		out.push_back(g.bLeftTrigger);
+	if (mask & FIELD_RIGHT_TRIGGER)
+		out.push_back(g.bRightTrigger);
+	if (mask & FIELD_THUMB_LX)
+		put_varint(out, zigzag(g.sThumbLX - p.sThumbLX));
+	if (mask & FIELD_THUMB_LY)
+		put_varint(out, zigzag(g.sThumbLY - p.sThumbLY));
+	if (mask & FIELD_THUMB_RX)
+		put_varint(out, zigzag(g.sThumbRX - p.sThumbRX));
+	if (mask & FIELD_THUMB_RY)
+		put_varint(out, zigzag(g.sThumbRY - p.sThumbRY));
+
+	prev = s;
+	_known[device] = true;
+}
+
+void record_encoder_t::disconnect(std::vector<uint8_t>& out, device_id_t device)
+{
+	out.push_back(TAG_DISCONNECT);
+	put_varint(out, (uint64_t)device);
+	_prev[device] = {};
+	_known[device] = false;
+}
+
+void record_encoder_t::gap(std::vector<uint8_t>& out)
+{
+	out.push_back(TAG_GAP);
+	memset(_prev, 0, sizeof(_prev));
+	memset(_known, 0, sizeof(_known));
+}
+
+bool record_decoder_t::open(const uint8_t* data, size_t size)
+{
+	_p = data;
+	_end = data + size;
+	_broken = false;
+	_time = 0;
+	memset(_prev, 0, sizeof(_prev));
+
+	if (size < 8 || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+		return fail();
+	uint32_t version = data[4] | data[5] << 8 | data[6] << 16 | (uint32_t)data[7] << 24;
+	if (version != RECORD_VERSION)
+		return fail();
+	_p += 8;
+	return true;
+}
+
+bool record_decoder_t::varint(uint64_t& v)
+{
+	v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (_p == _end)
+			return fail();
+		auto b = *_p++;
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+	}
+	return fail();
+}
+
+bool record_decoder_t::next(record_event_t& e)
+{
+	if (_broken || _p == _end)
+		return false;
+
+	auto tag = *_p++;
+	uint64_t v;
+	e.time = _time;
+	if (tag == TAG_TICK) {
+		if (!varint(v))
+			return false;
+		_time += v;
+		e.kind = record_event_t::tick;
+		e.time = _time;
+		e.device = -1;
+		return true;
+	}
+	if (tag == TAG_GAP) {
+		memset(_prev, 0, sizeof(_prev));
+		e.kind = record_event_t::gap;
+		e.device = -1;
+		return true;
+	}
+
+	uint64_t device;
+	if (!varint(device) || device >= MAX_DEVICES)
+		return fail();
+	e.device = (int)device;
+	auto& prev = _prev[device];
+
+	if (tag == TAG_DISCONNECT) {
+		prev = {};
+		e.kind = record_event_t::disconnect;
+		return true;
+	}
+	if ((tag & TAG_STATE) == 0)
+		return fail();
+
+	auto mask = tag & ~TAG_STATE;
+	auto s = prev;
+	auto& g = s.Gamepad;
+	if (!varint(v))
+		return false;
+	s.dwPacketNumber += (uint32_t)v;
+	if (mask & FIELD_BUTTONS) {
+		if (_end - _p < 2)
+			return fail();
+		g.wButtons = (WORD)(_p[0] | _p[1] << 8);
+		_p += 2;
+	}
+	if (mask & FIELD_LEFT_TRIGGER) {
+		if (_p == _end)
+			return fail();
+		g.bLeftTrigger = *_p++;
+	}
+	if (mask & FIELD_RIGHT_TRIGGER) {
+		if (_p == _end)
+			return fail();
+		g.bRightTrigger = *_p++;
+	}
+	SHORT* thumbs[] = { &g.sThumbLX, &g.sThumbLY, &g.sThumbRX, &g.sThumbRY };
+	for (int i = 0; i < 4; ++i) {
+		if ((mask & (FIELD_THUMB_LX << i)) == 0)
+			continue;
+		if (!varint(v))
+			return false;
+		*thumbs[i] = (SHORT)(*thumbs[i] + unzigzag((uint32_t)v));
+	}
+
+	prev = s;
+	e.kind = record_event_t::state;
+	e.xinput = s;
+	return true;
+}
+
+recorder_t::recorder_t()
+{
+}
+
+recorder_t::~recorder_t()
+{
+	close();
+}
+
+bool recorder_t::open(const std::wstring& path)
+{
+	if (_file)
+		return false;
+	_file = open_file(path, "wb");
+	if (!_file)
+		return false;
+
+	// every buffer is allocated here, so recording never allocates.
+	for (auto& b: _buffers) {
+		b.clear();
+		b.reserve(BUFFER_SIZE);
+		_free.try_push(&b);
+	}
+	_free.try_pop(_current);
+	_encoder = {};
+	_encoder.header(*_current);
+	_dropping = false;
+	_stop = false;
+
+	_writer = std::thread(&recorder_t::write_loop, this);
+	return true;
+}
+
+void recorder_t::close()
+{
+	if (!_file)
+		return;
+
+	flush();
+	_stop = true;
+	_signal.notify();
+	_writer.join();
+
+	fclose(_file);
+	_file = nullptr;
+
+	// the buffers go back to the free ring on the next open().
+	buffer_t* b;
+	while (_free.try_pop(b))
+		;
+}
+
+bool recorder_t::writable()
+{
+	if (_current && _current->size() + MAX_TICK_RECORDS > BUFFER_SIZE)
+		flush();
+	if (!_current)
+		_free.try_pop(_current);
+	return _current != nullptr;
+}
+
+void recorder_t::tick(uint64_t now)
+{
+	if (!_file)
+		return;
+
+	if (now - _last_flush >= FLUSH_INTERVAL) {
+		_last_flush = now;
+		flush();
+	}
+
+	// a tick and the states of every device always fit in the buffer, so only
+	// whole ticks are dropped.
+	if (!writable()) {
+		_dropping = true;
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (_dropping) {
+		_dropping = false;
+		_encoder.gap(*_current);
+	}
+	_encoder.tick(*_current, now);
+}
+
+void recorder_t::state(device_id_t device, const XINPUT_STATE& s, bool changed)
+{
+	if (!_current || _dropping)
+		return;
+	if (changed || !_encoder.known(device))
+		_encoder.state(*_current, device, s);
+}
+
+void recorder_t::disconnect(device_id_t device)
+{
+	if (!_current || _dropping)
+		return;
+	_encoder.disconnect(*_current, device);
+}
+
+void recorder_t::flush()
+{
+	if (!_current || _current->empty())
+		return;
+
+	// there are as many ring slots as buffers, so this never fails.
+	_full.try_push(_current);
+	_current = nullptr;
+	_signal.notify();
+}
+
+void recorder_t::write_loop()
+{
+	for (;;) {
+		auto seen = _signal.value();
+		// read before the ring, so the buffers flushed before close() are written.
+		bool stop = _stop;
+
+		buffer_t* b;
+		while (_full.try_pop(b)) {
+			if (fwrite(b->data(), 1, b->size(), _file) == b->size())
+				_written.fetch_add(b->size(), std::memory_order_relaxed);
+			b->clear();
+			_free.try_push(b);
+		}
+		fflush(_file);
+
+		if (stop)
+			break;
+		_signal.wait(seen, signal_t::INFINITE_WAIT);
+	}
+}
+
+recorder_t::stats_t recorder_t::stats() const
+{
+	return { _written.load(std::memory_order_relaxed), _dropped.load(std::memory_order_relaxed) };
+}
+
+} // namespace gpmouse
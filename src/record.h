@@ -0,0 +1,154 @@
+#ifndef GPMOUSE_RECORD_H
+#define GPMOUSE_RECORD_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+
+#include "queue.h"
+
+
+namespace gpmouse
+{
+
+// Session recording: what check_xinput saw, tick by tick.
+//
+// File format (little endian): "GPMR", uint32 version, then records, each
+// starting with a tag byte:
+//   0x00 tick        varint dt : a poll tick, dt [us] after the previous one
+//   0x01 disconnect  varint device
+//   0x02 gap         records were lost; every device restarts from zero
+//   0x80|mask state  varint device, varint packet delta, then the fields in
+//                    mask: bit 0 buttons (uint16), 1 left trigger (uint8),
+//                    2 right trigger (uint8), 3-6 thumb LX, LY, RX, RY
+//                    (zigzag varint delta)
+// A state or a disconnect belongs to the last tick before it. A state holds
+// only the fields which differ from the previous state of its device; a device
+// without a state in a tick keeps the previous one.
+// A device is a device id (devices.h), below MAX_DEVICES; the XInput slots
+// are devices 0-3, as the slots were before there were device ids.
+
+constexpr uint32_t RECORD_VERSION = 1;
+
+struct record_event_t
+{
+	enum kind_t: uint8_t { tick, state, disconnect, gap };
+
+	kind_t kind;
+	device_id_t device;
+	uint64_t time;	// [us] since the first tick
+	XINPUT_STATE xinput;
+};
+
+// Appends records to a byte buffer.
+class record_encoder_t
+{
+public:
+	void header(std::vector<uint8_t>& out);
+	void tick(std::vector<uint8_t>& out, uint64_t now);
+	void state(std::vector<uint8_t>& out, device_id_t device, const XINPUT_STATE& s);
+	void disconnect(std::vector<uint8_t>& out, device_id_t device);
+	// after records were dropped: forget the previous states.
+	void gap(std::vector<uint8_t>& out);
+
+	// a device needs a state in this tick even though its packet did not change.
+	bool known(device_id_t device) const { return device >= 0 && device < MAX_DEVICES && _known[device]; }
+
+private:
+	bool _started = false;
+	uint64_t _last_tick = 0;
+	XINPUT_STATE _prev[MAX_DEVICES] = {};
+	bool _known[MAX_DEVICES] = {};
+};
+
+// Reads the records of a whole file.
+class record_decoder_t
+{
+public:
+	// false if the header is not a recording of this version.
+	bool open(const uint8_t* data, size_t size);
+	// false at the end, or on a broken record.
+	bool next(record_event_t& e);
+	bool broken() const { return _broken; }
+
+private:
+	bool varint(uint64_t& v);
+	bool fail() {
+		_broken = true;
+		return false;
+	}
+
+	const uint8_t* _p = nullptr;
+	const uint8_t* _end = nullptr;
+	bool _broken = false;
+	uint64_t _time = 0;
+	XINPUT_STATE _prev[MAX_DEVICES] = {};
+};
+
+// Records the ticks of the polling thread into a file.
+// The polling thread only encodes into a buffer of a fixed pool; full
+// buffers go to a writer thread through a ring, so the polling thread never
+// waits on the disk. If the writer falls behind and no buffer is free, the
+// records are dropped and a gap record is written once a buffer is back.
+class recorder_t
+{
+public:
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+	static constexpr size_t BUFFERS = 16;
+
+	struct stats_t
+	{
+		uint64_t written = 0;	// bytes
+		uint64_t dropped = 0;	// ticks
+	};
+
+	recorder_t();
+	~recorder_t();
+
+	bool open(const std::wstring& path);
+	// flushes what has been recorded and stops the writer thread.
+	void close();
+	bool is_open() const { return _file != nullptr; }
+
+	// polling thread
+	void tick(uint64_t now);
+	void state(device_id_t device, const XINPUT_STATE& s, bool changed);
+	void disconnect(device_id_t device);
+	// hands the current buffer to the writer, e.g. at the end of a tick.
+	void flush();
+
+	stats_t stats() const;
+
+private:
+	using buffer_t = std::vector<uint8_t>;
+
+	bool writable();
+	void write_loop();
+
+	FILE* _file = nullptr;
+	std::thread _writer;
+	std::atomic<bool> _stop = false;
+	signal_t _signal;
+
+	record_encoder_t _encoder;
+	buffer_t* _current = nullptr;
+	bool _dropping = false;
+	uint64_t _last_flush = 0;
+	spsc_ring_t<buffer_t*, BUFFERS> _full;	// polling -> writer
+	spsc_ring_t<buffer_t*, BUFFERS> _free;	// writer -> polling
+	buffer_t _buffers[BUFFERS];
+
+	std::atomic<uint64_t> _written = 0;
+	std::atomic<uint64_t> _dropped = 0;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_RECORD_H
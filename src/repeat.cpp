@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+#include <bit>
+
+#include "repeat.h"
+#include "alloc.h"
+
+
+namespace gpmouse
+{
+
+repeat_scheduler_t::repeat_scheduler_t()
+{
+	std::fill(std::begin(_slots), std::end(_slots), NIL);
+}
+
+void repeat_scheduler_t::press(device_id_t device, uint8_t vk, uint64_t now, const repeat_config_t& cfg)
+{
+	// the timers are linked by index, so they can move.
+	if (!has_timers(device)) {
+		allow_alloc_scope_t first_press;
+		_timers.resize((size_t)(device + 1) * KEYS);
+	}
+
+	auto t = id(device, vk);
+	if (_timers[t].armed)
+		unlink(t);
+	if (_armed == 0)
+		_current = now;
+	// advance(now) must have been called, or the timer can be a turn off.
+	assert(now >= _current && now - _current < SLOTS - MAX_PERIOD);
+
+	_timers[t].interval = std::clamp<uint32_t>(cfg.interval, 1, MAX_PERIOD);
+	link(t, std::max(now, _current) + std::clamp<uint32_t>(cfg.delay, 1, MAX_PERIOD));
+}
+
+void repeat_scheduler_t::release(device_id_t device, uint8_t vk)
+{
+	if (!has_timers(device))
+		return;
+	auto t = id(device, vk);
+	if (_timers[t].armed)
+		unlink(t);
+}
+
+void repeat_scheduler_t::release_all(device_id_t device)
+{
+	if (!has_timers(device))
+		return;
+	for (int vk = 0; vk < KEYS; ++vk)
+		release(device, (uint8_t)vk);
+}
+
+uint64_t repeat_scheduler_t::next_deadline() const
+{
+	if (_armed == 0)
+		return NEVER;
+	auto slot = next_slot();
+	return _current + ((slot - _current) & (SLOTS - 1));
+}
+
+void repeat_scheduler_t::link(uint32_t t, uint64_t deadline)
+{
+	auto& timer = _timers[t];
+	auto slot = (uint32_t)(deadline & (SLOTS - 1));
+	timer.deadline = deadline;
+	timer.prev = NIL;
+	timer.next = _slots[slot];
+	if (timer.next != NIL)
+		_timers[timer.next].prev = t;
+	_slots[slot] = t;
+	_used[slot / 64] |= 1ull << (slot % 64);
+	timer.armed = true;
+	++_armed;
+}
+
+void repeat_scheduler_t::unlink(uint32_t t)
+{
+	auto& timer = _timers[t];
+	auto slot = (uint32_t)(timer.deadline & (SLOTS - 1));
+	if (timer.prev != NIL)
+		_timers[timer.prev].next = timer.next;
+	else
+		_slots[slot] = timer.next;
+	if (timer.next != NIL)
+		_timers[timer.next].prev = timer.prev;
+	if (_slots[slot] == NIL)
+		_used[slot / 64] &= ~(1ull << (slot % 64));
+	timer.armed = false;
+	--_armed;
+}
+
+void repeat_scheduler_t::catch_up(uint64_t now)
+{
+	// every armed timer is due, since none is more than MAX_PERIOD past _current.
+	uint32_t due = NIL;
+	for (uint32_t w = 0; w < SLOTS / 64; ++w) {
+		for (auto bits = _used[w]; bits != 0; bits &= bits - 1) {
+			auto slot = w * 64 + (uint32_t)std::countr_zero(bits);
+			for (auto t = _slots[slot]; t != NIL; ) {
+				auto next = _timers[t].next;
+				_timers[t].next = due;
+				due = t;
+				t = next;
+			}
+			_slots[slot] = NIL;
+		}
+		_used[w] = 0;
+	}
+	_armed = 0;
+
+	// the last repeats are within MAX_PERIOD before now.
+	_current = now + 1 - MAX_PERIOD;
+	while (due != NIL) {
+		auto t = due;
+		due = _timers[t].next;
+		auto& timer = _timers[t];
+		auto deadline = timer.deadline;
+		if (deadline <= now)
+			deadline += (now - deadline) / timer.interval * timer.interval;
+		link(t, deadline);
+	}
+}
+
+uint32_t repeat_scheduler_t::next_slot() const
+{
+	constexpr uint32_t WORDS = SLOTS / 64;
+	auto start = (uint32_t)(_current & (SLOTS - 1));
+
+	// the word of start, from start on
+	auto w = start / 64;
+	auto bits = _used[w] & (~0ull << (start % 64));
+	for (uint32_t i = 0; i <= WORDS; ++i) {
+		if (bits != 0)
+			return w * 64 + (uint32_t)std::countr_zero(bits);
+		w = (w + 1) % WORDS;
+		bits = _used[w];
+		// back to the word of start: only the bits before start are left.
+		if (i + 1 == WORDS)
+			bits &= (1ull << (start % 64)) - 1;
+	}
+	return SLOTS;
+}
+
+} // namespace gpmouse
@@ -0,0 +1,122 @@
+#ifndef GPMOUSE_REPEAT_H
+#define GPMOUSE_REPEAT_H
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "config.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+// Key repeat driven by a timer wheel.
+// Every (device, key) has one timer; the timers of a device are made when
+// it presses its first key. The wheel has one slot per millisecond and a
+// bitmap of the slots in use, so finding the next repeat costs a few bit
+// scans, and nothing runs while no key is repeating.
+// The caller passes the time in [ms], so the scheduler can run on a
+// virtual clock.
+class repeat_scheduler_t
+{
+public:
+	static constexpr int KEYS = 256;
+	static constexpr uint32_t SLOTS = 2048;
+	// delays and intervals are clamped to this, so every timer is
+	// within one turn of the wheel.
+	static constexpr uint32_t MAX_PERIOD = SLOTS / 2;
+	static constexpr uint64_t NEVER = UINT64_MAX;
+
+	repeat_scheduler_t();
+
+	// the key starts repeating after cfg.delay, then every cfg.interval.
+	// call advance(now) first.
+	void press(device_id_t device, uint8_t vk, uint64_t now, const repeat_config_t& cfg);
+	void release(device_id_t device, uint8_t vk);
+	void release_all(device_id_t device);
+
+	// calls fire(device, vk) for every repeat due at now, in time order.
+	template <typename F>
+	void advance(uint64_t now, F&& fire);
+
+	// time of the next repeat, NEVER if no key is repeating.
+	uint64_t next_deadline() const;
+	bool empty() const { return _armed == 0; }
+
+private:
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	struct timer_t
+	{
+		uint64_t deadline = 0;
+		uint32_t interval = 0;
+		uint32_t next = NIL;
+		uint32_t prev = NIL;
+		bool armed = false;
+	};
+
+	static uint32_t id(device_id_t device, uint8_t vk) {
+		return (uint32_t)device * KEYS + vk;
+	}
+	bool has_timers(device_id_t device) const {
+		return id(device, 0) < _timers.size();
+	}
+	void link(uint32_t t, uint64_t deadline);
+	void unlink(uint32_t t);
+	// first slot in use at or after the slot of _current, SLOTS if none.
+	uint32_t next_slot() const;
+	// moves _current up to now for a caller who is late, and every timer to
+	// its last repeat at or before now, so each fires once.
+	void catch_up(uint64_t now);
+
+	std::vector<timer_t> _timers;	// KEYS for each device
+	uint32_t _slots[SLOTS];
+	uint64_t _used[SLOTS / 64] = {};
+	uint64_t _current = 0;
+	uint32_t _armed = 0;
+};
+
+template <typename F>
+void repeat_scheduler_t::advance(uint64_t now, F&& fire)
+{
+	// A timer relinked below can be up to MAX_PERIOD past now, which the
+	// slots tell apart from the due ones only within a turn of _current.
+	if (_armed != 0 && now > _current && now - _current >= SLOTS - MAX_PERIOD)
+		catch_up(now);
+
+	while (_armed != 0) {
+		auto slot = next_slot();
+		auto deadline = _current + ((slot - _current) & (SLOTS - 1));
+		if (deadline > now)
+			break;
+
+		_current = deadline;
+		// every timer of the slot is due at deadline.
+		auto t = _slots[slot];
+		_slots[slot] = NIL;
+		_used[slot / 64] &= ~(1ull << (slot % 64));
+		while (t != NIL) {
+			auto next = _timers[t].next;
+			auto& timer = _timers[t];
+			timer.armed = false;
+			--_armed;
+
+			// Repeats missed while the thread was late are skipped, not sent in a burst.
+			auto again = deadline + timer.interval;
+			if (again <= now)
+				again += (now - again) / timer.interval * timer.interval + timer.interval;
+			link(t, again);
+
+			fire((device_id_t)(t / KEYS), (uint8_t)(t % KEYS));
+			t = next;
+		}
+	}
+	if (now > _current)
+		_current = now;
+}
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_REPEAT_H
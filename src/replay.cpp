@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "replay.h"
+#include "record.h"
+#include "engine.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// Counts what goes through to another sink.
+class counting_sink_t: public output_sink_t
+{
+public:
+	explicit counting_sink_t(output_sink_t& sink): _sink(&sink) {}
+	UINT send(UINT n, INPUT* inputs) override {
+		count += n;
+		return _sink->send(n, inputs);
+	}
+
+	uint64_t count = 0;
+
+private:
+	output_sink_t* _sink;
+};
+
+const char* mouse_button_name(DWORD flags, DWORD data, bool& up)
+{
+	up = false;
+	switch (flags) {
+	case MOUSEEVENTF_LEFTUP:	up = true; [[fallthrough]];
+	case MOUSEEVENTF_LEFTDOWN:	return "left";
+	case MOUSEEVENTF_RIGHTUP:	up = true; [[fallthrough]];
+	case MOUSEEVENTF_RIGHTDOWN:	return "right";
+	case MOUSEEVENTF_MIDDLEUP:	up = true; [[fallthrough]];
+	case MOUSEEVENTF_MIDDLEDOWN: return "middle";
+	case MOUSEEVENTF_XUP:		up = true; [[fallthrough]];
+	case MOUSEEVENTF_XDOWN:		return data == 1 ? "x1" : "x2";
+	default:					return nullptr;
+	}
+}
+
+} // namespace
+
+bool replay_recording(const uint8_t* data, size_t size, const settings_t& s,
+	output_sink_t& out, uint64_t* clock, replay_stats_t& stats)
+{
+	record_decoder_t decoder;
+	if (!decoder.open(data, size))
+		return false;
+
+	counting_sink_t sink(out);
+
+	xinput_queue_t queue(overflow_t::drop);
+	analog_output_t output;
+	poller_t poller(queue, output);
+	poller.configure(s);
+
+	no_window_system_t windows;
+	process_cache_t processes(windows);
+	button_handler_t handler(sink, processes);
+
+	// what the source would report in a tick, by device id.
+	std::vector<bool> changed;
+	std::vector<XINPUT_STATE> states;
+	std::vector<device_id_t> active;	// ascending
+	std::vector<device_id_t> lost;
+	bool in_tick = false;
+	uint64_t now = 0;
+
+	auto run_tick = [&]{
+		// the key repeats due before the tick, at their own deadlines.
+		for (auto d = handler.next_deadline(); d != repeat_scheduler_t::NEVER && d * 1000 < now; d = handler.next_deadline()) {
+			*clock = d * 1000;
+			handler.repeat(d);
+		}
+		*clock = now;
+
+		// the lost pads, then the others in the order of their ids, as the sources report them.
+		poller.begin(now, now * 1000);
+		for (auto i: lost)
+			poller.disconnect(i);
+		lost.clear();
+		for (auto i: active) {
+			poller.state(i, states[i], changed[i]);
+			changed[i] = false;
+		}
+		poller.end();
+		output.flush(sink);
+
+		// the handler thread, woken up by the tick.
+		auto ms = now / 1000;
+		handler.repeat(ms);
+		xinput_t input;
+		while (queue.pop(input))
+			handler.handle(s, input, ms);
+	};
+
+	record_event_t e;
+	while (decoder.next(e)) {
+		switch (e.kind) {
+		case record_event_t::tick:
+			if (in_tick)
+				run_tick();
+			in_tick = true;
+			now = e.time;
+			++stats.ticks;
+			break;
+		case record_event_t::state:
+			if (e.device >= (int)states.size()) {
+				changed.resize(e.device + 1);
+				states.resize(e.device + 1);
+			}
+			insert_sorted(active, e.device);
+			changed[e.device] = true;
+			states[e.device] = e.xinput;
+			++stats.states;
+			break;
+		case record_event_t::disconnect:
+			erase_sorted(active, e.device);
+			lost.push_back(e.device);
+			break;
+		case record_event_t::gap:
+			// the recorder lost some ticks; the pads are reported again from here.
+			lost.insert(lost.end(), active.begin(), active.end());
+			active.clear();
+			break;
+		}
+	}
+	if (in_tick)
+		run_tick();
+
+	stats.inputs = sink.count;
+	stats.duration = now;
+	stats.broken = decoder.broken();
+	return true;
+}
+
+UINT text_sink_t::send(UINT n, INPUT* inputs)
+{
+	auto t = (unsigned long long)*_clock;
+	for (auto i = inputs; i != inputs + n; ++i) {
+		if (i->type == INPUT_KEYBOARD) {
+			auto up = (i->ki.dwFlags & KEYEVENTF_KEYUP) != 0;
+			fprintf(_out, "%llu key %s %s\n", t, vk_name((uint8_t)i->ki.wVk), up ? "up" : "down");
+			continue;
+		}
+		if (i->type != INPUT_MOUSE)
+			continue;
+
+		auto& mi = i->mi;
+		bool up;
+		if (mi.dwFlags == MOUSEEVENTF_MOVE)
+			fprintf(_out, "%llu move %ld %ld\n", t, (long)mi.dx, (long)mi.dy);
+		else if (mi.dwFlags == MOUSEEVENTF_WHEEL)
+			fprintf(_out, "%llu wheel %d\n", t, (int)mi.mouseData);
+		else if (mi.dwFlags == MOUSEEVENTF_HWHEEL)
+			fprintf(_out, "%llu hwheel %d\n", t, (int)mi.mouseData);
+		else if (auto name = mouse_button_name(mi.dwFlags, mi.mouseData, up))
+			fprintf(_out, "%llu button %s %s\n", t, name, up ? "up" : "down");
+	}
+	return n;
+}
+
+bool replay_file(const std::wstring& recording, const std::wstring& output, const settings_t& s, replay_stats_t& stats)
+{
+	std::ifstream in(file_path(recording), std::ios::binary);
+	if (!in)
+		return false;
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	auto out = open_file(output, "w");
+	if (!out)
+		return false;
+
+	uint64_t clock = 0;
+	text_sink_t sink(out, &clock);
+	auto ok = replay_recording(data.data(), data.size(), s, sink, &clock, stats);
+	fclose(out);
+	return ok;
+}
+
+} // namespace gpmouse
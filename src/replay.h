@@ -0,0 +1,57 @@
+#ifndef GPMOUSE_REPLAY_H
+#define GPMOUSE_REPLAY_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+#include "settings.h"
+#include "output.h"
+
+
+namespace gpmouse
+{
+
+struct replay_stats_t
+{
+	uint64_t ticks = 0;
+	uint64_t states = 0;
+	uint64_t inputs = 0;	// input events sent to the sink
+	uint64_t duration = 0;	// of the recording [us]
+	bool broken = false;	// the recording ends with a broken record
+};
+
+// Feeds a recording (record.h) through the polling and the button pipeline
+// of gpmouse with a virtual clock: the ticks happen at their recorded times
+// and the key repeats at their deadlines, so the same recording and settings
+// always give the same events. No window is under the cursor nor in the
+// foreground, so only the bindings of no application apply.
+// *clock is set to the virtual time [us] before anything is sent to sink.
+// Returns false if data is not a recording.
+bool replay_recording(const uint8_t* data, size_t size, const settings_t& s,
+	output_sink_t& sink, uint64_t* clock, replay_stats_t& stats);
+
+// Writes the input events of a sink as text, one per line:
+//   <time us> key <name> down|up
+//   <time us> button <left|right|middle|x1|x2> down|up
+//   <time us> move <dx> <dy>
+//   <time us> wheel <delta> / hwheel <delta>
+class text_sink_t: public output_sink_t
+{
+public:
+	text_sink_t(FILE* out, const uint64_t* clock): _out(out), _clock(clock) {}
+	UINT send(UINT n, INPUT* inputs) override;
+
+private:
+	FILE* _out;
+	const uint64_t* _clock;
+};
+
+// gpmouse.exe --replay <recording> <output>
+bool replay_file(const std::wstring& recording, const std::wstring& output, const settings_t& s, replay_stats_t& stats);
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_REPLAY_H
@@ -0,0 +1,115 @@
+#ifndef GPMOUSE_SETTINGS_H
+#define GPMOUSE_SETTINGS_H
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "platform.h"
+
+#include "config.h"
+#include "apps.h"
+#include "bindings.h"
+#include "snapshot.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+// The sticks and the bindings of a kind of controller, compiled at load.
+// Profile 0 is the top level of gpmouse.toml, the others its [[controllers]].
+struct controller_profile_t
+{
+	std::string name;
+	// key_bindings  (buttons asc, priority asc) Ń\[gĂ
+	std::vector<key_binding_t> key_bindings;
+	key_binding_t single_button[16] = {};
+	// what every pad of the profile starts from; the calibration (cx, cy)
+	// of each pad is owned by the polling thread.
+	stick_params_t stick_params;
+
+	binding_table_t binding_table;
+	mutable binding_profiles_t binding_profiles{ binding_table };
+
+	controller_profile_t() = default;
+	controller_profile_t(const controller_profile_t&) = delete;
+	controller_profile_t& operator=(const controller_profile_t&) = delete;
+};
+
+// The pads which take a controller profile: those with one of ids (for
+// XInput, the slots), and those whose device key (devices.h) contains one
+// of keys.
+struct controller_match_t
+{
+	uint8_t controller;
+	std::vector<device_id_t> ids;
+	std::vector<std::string> keys;
+};
+
+// the controller profile of a pad: the first match, else 0.
+// key is empty when the pad is only known by its id, as in a replay.
+inline uint8_t select_controller(const std::vector<controller_match_t>& matches, device_id_t id, std::string_view key)
+{
+	for (auto& m: matches) {
+		for (auto i: m.ids)
+			if (i == id)
+				return m.controller;
+		if (key.empty())
+			continue;
+		for (auto& k: m.keys)
+			if (key.find(k) != std::string_view::npos)
+				return m.controller;
+	}
+	return 0;
+}
+
+// Everything configure() loads.
+// A settings_t is never modified once published, except for the caches
+// marked mutable, which only the handler thread uses.
+struct settings_t
+{
+	// at least one, below MAX_CONTROLLERS.
+	std::vector<std::unique_ptr<controller_profile_t>> controllers;
+	std::vector<controller_match_t> controller_matches;
+	polling_t polling;
+	repeat_config_t repeat;
+	// repeat settings of the applications which have their own, by priority.
+	std::vector<std::pair<app_id_t, repeat_config_t>> app_repeats;
+	log_config_t log;
+
+	mutable app_matcher_t app_matcher;
+
+	settings_t() {
+		controllers.push_back(std::make_unique<controller_profile_t>());
+	}
+	settings_t(const settings_t&) = delete;
+	settings_t& operator=(const settings_t&) = delete;
+
+	const repeat_config_t& repeat_config(const app_set_t& apps) const {
+		for (auto& [app, cfg]: app_repeats)
+			if (apps.test(app))
+				return cfg;
+		return repeat;
+	}
+	// a state queued before a reload may name a profile which is gone.
+	const controller_profile_t& controller(uint8_t i) const {
+		return *controllers[i < controllers.size() ? i : 0];
+	}
+};
+
+// the settings without gpmouse.toml.
+void default_config(settings_t& s);
+// Loads the text of gpmouse.toml into s, without the logger and the cache.
+// Throws if the text is broken. In loader.cpp, as configure().
+void load_config(const std::string& text, const std::string& name, settings_t& s);
+
+extern snapshot_t<settings_t> g_settings;
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_SETTINGS_H
@@ -0,0 +1,104 @@
+#ifndef GPMOUSE_SNAPSHOT_H
+#define GPMOUSE_SNAPSHOT_H
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <thread>
+
+
+namespace gpmouse
+{
+
+// Immutable object published to reader threads without locks.
+// Readers use the object between enter() and leave(), and stay out of it
+// while they sleep. publish() swaps the pointer, then waits until every
+// reader has left or entered again (a grace period) before it deletes the
+// old object, so a reader never sees it freed.
+template <typename T>
+class snapshot_t
+{
+public:
+	static constexpr int MAX_READERS = 8;
+
+	snapshot_t() = default;
+	snapshot_t(const snapshot_t&) = delete;
+	snapshot_t& operator=(const snapshot_t&) = delete;
+	~snapshot_t() {
+		delete _current.load();
+	}
+
+	// writer. blocks until the readers are done with the previous object.
+	void publish(std::unique_ptr<T> next) {
+		std::lock_guard lock(_writer);
+		auto prev = _current.exchange(next.release());
+		auto epoch = _epoch.fetch_add(1) + 1;
+		for (auto& r: _readers) {
+			for (;;) {
+				auto e = r.load();
+				if (e == OFFLINE || e >= epoch)
+					break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		delete prev;
+	}
+
+	// number of objects published so far.
+	uint64_t version() const {
+		return _epoch.load();
+	}
+
+	class reader_t
+	{
+	public:
+		explicit reader_t(snapshot_t& s): _s(&s) {
+			for (_id = 0; _id < MAX_READERS; ++_id) {
+				uint64_t unused = UNUSED;
+				if (s._readers[_id].compare_exchange_strong(unused, OFFLINE))
+					return;
+			}
+			assert(!"too many readers");
+			_s = nullptr;
+		}
+		~reader_t() {
+			if (_s)
+				_s->_readers[_id].store(UNUSED);
+		}
+		reader_t(const reader_t&) = delete;
+		reader_t& operator=(const reader_t&) = delete;
+
+		// the object stays valid until leave().
+		const T& enter() {
+			// seq_cst: either publish() sees this reader, or this reader sees the new object.
+			_s->_readers[_id].store(_s->_epoch.load());
+			return *_s->_current.load();
+		}
+		void leave() {
+			_s->_readers[_id].store(OFFLINE);
+		}
+
+	private:
+		snapshot_t* _s;
+		int _id;
+	};
+
+private:
+	static constexpr uint64_t OFFLINE = UINT64_MAX;
+	static constexpr uint64_t UNUSED = UINT64_MAX - 1;
+
+	std::atomic<T*> _current = nullptr;
+	std::atomic<uint64_t> _epoch = 0;
+	std::atomic<uint64_t> _readers[MAX_READERS] = {
+		UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED, UNUSED,
+	};
+	std::mutex _writer;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_SNAPSHOT_H
@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "source.h"
+
+
+namespace gpmouse
+{
+
+synthetic_source_t::synthetic_source_t(device_registry_t& devices):
+	_devices(&devices)
+{
+}
+
+DWORD synthetic_source_t::read(DWORD slot, XINPUT_STATE* state)
+{
+	++_reads;
+	if (slot >= _pads.size() || !_pads[slot].connected)
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*state = _pads[slot].state;
+	return ERROR_SUCCESS;
+}
+
+device_id_t synthetic_source_t::set(int i, const XINPUT_GAMEPAD& state)
+{
+	if (i >= (int)_pads.size())
+		_pads.resize(i + 1);
+	auto& pad = _pads[i];
+	if (pad.device == device_registry_t::NONE) {
+		pad.device = _devices->id("synthetic/" + std::to_string(i));
+		if (pad.device == device_registry_t::NONE)
+			return pad.device;
+	}
+
+	auto& s = pad.state;
+	if (!pad.connected || memcmp(&s.Gamepad, &state, sizeof(state)) != 0)
+		++s.dwPacketNumber;
+	s.Gamepad = state;
+	if (!pad.connected) {
+		pad.connected = true;
+		_devices->attach(pad.device);
+		insert_sorted(_connected, i);
+	}
+	return pad.device;
+}
+
+void synthetic_source_t::disconnect(int i)
+{
+	if (i >= (int)_pads.size() || !_pads[i].connected)
+		return;
+	auto& pad = _pads[i];
+	pad.connected = false;
+	_devices->detach(pad.device);
+	erase_sorted(_connected, i);
+	_lost.push_back(pad.device);
+}
+
+bool recording_source_t::open(const uint8_t* data, size_t size)
+{
+	_connected.clear();
+	_states.clear();
+	_pending = false;
+	return _decoder.open(data, size);
+}
+
+bool recording_source_t::next_tick(uint64_t& now)
+{
+	// the records up to the next tick belong to the current one.
+	bool started = _pending;
+	if (started)
+		now = _next.time;
+	_pending = false;
+
+	record_event_t e;
+	while (_decoder.next(e)) {
+		switch (e.kind) {
+		case record_event_t::tick:
+			if (started) {
+				_next = e;
+				_pending = true;
+				return true;
+			}
+			started = true;
+			now = e.time;
+			break;
+		case record_event_t::state:
+			if (e.device >= (int)_states.size()) {
+				_connected.resize(e.device + 1);
+				_states.resize(e.device + 1);
+			}
+			_connected[e.device] = true;
+			_states[e.device] = e.xinput;
+			break;
+		case record_event_t::disconnect:
+			if (e.device < (int)_connected.size())
+				_connected[e.device] = false;
+			break;
+		case record_event_t::gap:
+			_connected.assign(_connected.size(), false);
+			break;
+		}
+	}
+	return started;
+}
+
+DWORD recording_source_t::read(DWORD slot, XINPUT_STATE* state)
+{
+	if (slot >= _connected.size() || !_connected[slot])
+		return ERROR_DEVICE_NOT_CONNECTED;
+	*state = _states[slot];
+	return ERROR_SUCCESS;
+}
+
+} // namespace gpmouse
@@ -0,0 +1,113 @@
+#ifndef GPMOUSE_SOURCE_H
+#define GPMOUSE_SOURCE_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "platform.h"
+#include "record.h"
+#include "devices.h"
+
+
+namespace gpmouse
+{
+
+// Where check_xinput reads the pads from, slot by slot.
+class input_source_t
+{
+public:
+	virtual ~input_source_t() = default;
+
+	// ERROR_SUCCESS and the state of the pad in slot, or an error such as
+	// ERROR_DEVICE_NOT_CONNECTED if the slot is empty.
+	virtual DWORD read(DWORD slot, XINPUT_STATE* state) = 0;
+};
+
+// Pads set by the caller, e.g. by a test or a profiling run, as many as
+// devices takes. The caller numbers the pads from 0; a pad is the device
+// "synthetic/<pad>". The pads are read by slot, as slot_tracker_t reads the
+// first XUSER_MAX_COUNT of them, or polled as the pads of an event source,
+// where a tick costs the connected pads only.
+class synthetic_source_t: public input_source_t
+{
+public:
+	explicit synthetic_source_t(device_registry_t& devices);
+
+	// slot : a pad
+	DWORD read(DWORD slot, XINPUT_STATE* state) override;
+
+	// a new state of pad, which connects it. The packet number is advanced,
+	// as XInput does when something has changed.
+	// Returns the device id of pad, NONE if devices is full.
+	device_id_t set(int pad, const XINPUT_GAMEPAD& state);
+	void disconnect(int pad);
+
+	// as evdev_source_t::poll(): the pads lost since the last call, then
+	// the connected pads in the order of their numbers.
+	template <typename F, typename G>
+	void poll(F&& on_state, G&& on_disconnect);
+
+	// the number of read() calls, empty slots included.
+	uint64_t reads() const { return _reads; }
+
+private:
+	struct pad_t
+	{
+		device_id_t device = device_registry_t::NONE;
+		bool connected = false;
+		DWORD reported = 0;	// the packet number at the last poll()
+		XINPUT_STATE state = {};
+	};
+
+	device_registry_t* _devices;
+	std::vector<pad_t> _pads;
+	std::vector<int> _connected;	// the connected pads, ascending
+	std::vector<device_id_t> _lost;
+	uint64_t _reads = 0;
+};
+
+template <typename F, typename G>
+void synthetic_source_t::poll(F&& on_state, G&& on_disconnect)
+{
+	for (auto id: _lost)
+		on_disconnect(id);
+	_lost.clear();
+
+	for (auto i: _connected) {
+		auto& pad = _pads[i];
+		bool changed = pad.reported != pad.state.dwPacketNumber;
+		pad.reported = pad.state.dwPacketNumber;
+		on_state(pad.device, pad.state, changed);
+	}
+}
+
+// The pads of a recording (record.h), one tick at a time, by device id.
+// A pad without a state in a tick keeps the previous one; after a gap
+// every pad is empty until it has a state again.
+class recording_source_t: public input_source_t
+{
+public:
+	// false if data is not a recording. data must outlive the source.
+	bool open(const uint8_t* data, size_t size);
+
+	// moves to the next tick. false at the end of the recording.
+	// now : the time of the tick [us] since the first one
+	bool next_tick(uint64_t& now);
+	bool broken() const { return _decoder.broken(); }
+
+	DWORD read(DWORD slot, XINPUT_STATE* state) override;
+
+private:
+	record_decoder_t _decoder;
+	record_event_t _next = {};
+	bool _pending = false;	// _next is a tick which has not been returned yet
+	// by device id, up to the largest one seen
+	std::vector<bool> _connected;
+	std::vector<XINPUT_STATE> _states;
+};
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_SOURCE_H
@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#	include <intrin.h>
+#	define TARGET_SSE41
+#	define TARGET_AVX2
+#else
+#	define TARGET_SSE41 __attribute__((target("sse4.1")))
+#	define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#include <algorithm>
+
+#include "stick.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// Trigger selection of a stick_t as lane masks: all ones where the trigger
+// is assigned to the function.
+struct trigger_masks_t
+{
+	int left_accel;
+	int right_accel;
+	int left_brake;
+	int right_brake;
+
+	explicit trigger_masks_t(const stick_t& cfg):
+		left_accel(cfg.left_trigger == trigger_function_t::acceleration ? -1 : 0),
+		right_accel(cfg.right_trigger == trigger_function_t::acceleration ? -1 : 0),
+		left_brake(cfg.left_trigger == trigger_function_t::deacceleration ? -1 : 0),
+		right_brake(cfg.right_trigger == trigger_function_t::deacceleration ? -1 : 0)
+	{
+	}
+};
+
+void process_scalar(const stick_batch_t& b, size_t begin)
+{
+	auto& in = b.in;
+	for (auto i = begin; i < in.count; ++i)
+		stick_velocity(*b.cfg, b.divisor, b.y_sign,
+			in.x[i], in.y[i], in.left_trigger[i], in.right_trigger[i], b.vx[i], b.vy[i]);
+}
+
+TARGET_SSE41
+__m128 lookup4(const float* table, __m128i index)
+{
+	alignas(16) int32_t i[4];
+	_mm_store_si128((__m128i*)i, index);
+	return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+TARGET_SSE41
+void process_sse41(const stick_batch_t& b)
+{
+	auto& cfg = *b.cfg;
+	auto& in = b.in;
+	trigger_masks_t t(cfg);
+
+	const auto cx = _mm_set1_epi32(cfg.cx);
+	const auto cy = _mm_set1_epi32(cfg.cy);
+	const auto dz2 = _mm_set1_epi32(cfg.deadzone * cfg.deadzone);
+	const auto la = _mm_set1_epi32(t.left_accel);
+	const auto ra = _mm_set1_epi32(t.right_accel);
+	const auto lb = _mm_set1_epi32(t.left_brake);
+	const auto rb = _mm_set1_epi32(t.right_brake);
+	const auto base = _mm_set1_ps(cfg.base_speed);
+	const auto divisor = _mm_set1_ps(b.divisor);
+	const auto y_sign = _mm_set1_ps(b.y_sign);
+	const auto c128 = _mm_set1_ps(128.0f);
+	const auto c255 = _mm_set1_ps(255.0f);
+
+	size_t i = 0;
+	for (; i + 4 <= in.count; i += 4) {
+		auto x = _mm_sub_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(in.x + i))), cx);
+		auto y = _mm_sub_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)(in.y + i))), cy);
+		auto r2 = _mm_add_epi32(_mm_mullo_epi32(x, x), _mm_mullo_epi32(y, y));
+		auto moving = _mm_castsi128_ps(_mm_cmpgt_epi32(r2, dz2));
+
+		int32_t lt, rt;
+		memcpy(&lt, in.left_trigger + i, sizeof(lt));
+		memcpy(&rt, in.right_trigger + i, sizeof(rt));
+		auto l = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(lt));
+		auto r = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(rt));
+		auto a = _mm_max_epi32(_mm_and_si128(l, la), _mm_and_si128(r, ra));
+		auto k = _mm_max_epi32(_mm_and_si128(l, lb), _mm_and_si128(r, rb));
+
+		auto fx = _mm_cvtepi32_ps(x);
+		auto fy = _mm_cvtepi32_ps(y);
+		auto m = _mm_div_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy))), c128);
+		auto mi = _mm_cvttps_epi32(_mm_min_ps(m, c255));
+
+		auto accel = _mm_mul_ps(lookup4(cfg.accel_table.values, a), lookup4(cfg.magnitude_table.values, mi));
+		auto d = _mm_mul_ps(divisor, lookup4(cfg.brake_table.values, k));
+		auto vx = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(base, fx), accel), d);
+		auto vy = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(_mm_mul_ps(base, fy), accel), d), y_sign);
+
+		_mm_storeu_ps(b.vx + i, _mm_and_ps(vx, moving));
+		_mm_storeu_ps(b.vy + i, _mm_and_ps(vy, moving));
+	}
+	process_scalar(b, i);
+}
+
+TARGET_AVX2
+void process_avx2(const stick_batch_t& b)
+{
+	auto& cfg = *b.cfg;
+	auto& in = b.in;
+	trigger_masks_t t(cfg);
+
+	const auto cx = _mm256_set1_epi32(cfg.cx);
+	const auto cy = _mm256_set1_epi32(cfg.cy);
+	const auto dz2 = _mm256_set1_epi32(cfg.deadzone * cfg.deadzone);
+	const auto la = _mm256_set1_epi32(t.left_accel);
+	const auto ra = _mm256_set1_epi32(t.right_accel);
+	const auto lb = _mm256_set1_epi32(t.left_brake);
+	const auto rb = _mm256_set1_epi32(t.right_brake);
+	const auto base = _mm256_set1_ps(cfg.base_speed);
+	const auto divisor = _mm256_set1_ps(b.divisor);
+	const auto y_sign = _mm256_set1_ps(b.y_sign);
+	const auto c128 = _mm256_set1_ps(128.0f);
+	const auto c255 = _mm256_set1_ps(255.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= in.count; i += 8) {
+		auto x = _mm256_sub_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in.x + i))), cx);
+		auto y = _mm256_sub_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in.y + i))), cy);
+		auto r2 = _mm256_add_epi32(_mm256_mullo_epi32(x, x), _mm256_mullo_epi32(y, y));
+		auto moving = _mm256_castsi256_ps(_mm256_cmpgt_epi32(r2, dz2));
+
+		auto l = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in.left_trigger + i)));
+		auto r = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in.right_trigger + i)));
+		auto a = _mm256_max_epi32(_mm256_and_si256(l, la), _mm256_and_si256(r, ra));
+		auto k = _mm256_max_epi32(_mm256_and_si256(l, lb), _mm256_and_si256(r, rb));
+
+		auto fx = _mm256_cvtepi32_ps(x);
+		auto fy = _mm256_cvtepi32_ps(y);
+		auto m = _mm256_div_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(fx, fx), _mm256_mul_ps(fy, fy))), c128);
+		auto mi = _mm256_cvttps_epi32(_mm256_min_ps(m, c255));
+
+		auto accel = _mm256_mul_ps(
+			_mm256_i32gather_ps(cfg.accel_table.values, a, 4),
+			_mm256_i32gather_ps(cfg.magnitude_table.values, mi, 4));
+		auto d = _mm256_mul_ps(divisor, _mm256_i32gather_ps(cfg.brake_table.values, k, 4));
+		auto vx = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(base, fx), accel), d);
+		auto vy = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(base, fy), accel), d), y_sign);
+
+		_mm256_storeu_ps(b.vx + i, _mm256_and_ps(vx, moving));
+		_mm256_storeu_ps(b.vy + i, _mm256_and_ps(vy, moving));
+	}
+	process_scalar(b, i);
+}
+
+} // namespace
+
+simd_t detect_simd()
+{
+	static const simd_t simd = []{
+#ifdef _MSC_VER
+		int r[4];
+		__cpuid(r, 0);
+		auto max_leaf = r[0];
+
+		__cpuid(r, 1);
+		bool sse41 = (r[2] & (1 << 19)) != 0;
+		bool osxsave = (r[2] & (1 << 27)) != 0;
+		bool avx = (r[2] & (1 << 28)) != 0;
+
+		bool avx2 = false;
+		if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(r, 7, 0);
+			avx2 = (r[1] & (1 << 5)) != 0;
+		}
+#else
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		return avx2 ? simd_t::avx2 : sse41 ? simd_t::sse41 : simd_t::scalar;
+	}();
+	return simd;
+}
+
+void process_stick_batches(const stick_batch_t* batches, size_t n, simd_t simd)
+{
+	// never use an instruction set the CPU does not have.
+	simd = std::min(simd, detect_simd());
+
+	for (auto b = batches; b != batches + n; ++b) {
+		switch (simd) {
+		case simd_t::avx2:
+			process_avx2(*b);
+			break;
+		case simd_t::sse41:
+			process_sse41(*b);
+			break;
+		default:
+			process_scalar(*b, 0);
+			break;
+		}
+	}
+}
+
+} // namespace gpmouse
@@ -0,0 +1,85 @@
+#ifndef GPMOUSE_STICK_H
+#define GPMOUSE_STICK_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "config.h"
+
+
+namespace gpmouse
+{
+
+// Velocity of one stick sample in counts per reference interval.
+// divisor is the screen width for the cursor and FPS for the wheel,
+// y_sign flips the y axis (the cursor moves down for positive dy).
+// Both the live path and the batch kernels below are built on this,
+// so they produce identical results.
+inline bool stick_velocity(const stick_t& cfg, float divisor, float y_sign,
+	int16_t thumb_x, int16_t thumb_y, uint8_t lt, uint8_t rt, float& vx, float& vy)
+{
+	int x = thumb_x - cfg.cx;
+	int y = thumb_y - cfg.cy;
+
+	if (x*x + y*y <= cfg.deadzone * cfg.deadzone) {
+		vx = vy = 0;
+		return false;
+	}
+
+	uint8_t a = 0;
+	uint8_t b = 0;
+	if (cfg.left_trigger == trigger_function_t::acceleration)
+		a = std::max(a, lt);
+	if (cfg.right_trigger == trigger_function_t::acceleration)
+		a = std::max(a, rt);
+	if (cfg.left_trigger == trigger_function_t::deacceleration)
+		b = std::max(b, lt);
+	if (cfg.right_trigger == trigger_function_t::deacceleration)
+		b = std::max(b, rt);
+
+	float accel = cfg.accel_table[a] * cfg.magnitude_table[stick_t::magnitude_index(x, y)];
+	float d = divisor * cfg.brake_table[b];
+	vx = cfg.base_speed * (float)x * accel / d;
+	vy = cfg.base_speed * (float)y * accel / d * y_sign;
+	return true;
+}
+
+// Samples of one stick, structure of arrays.
+struct stick_samples_t
+{
+	size_t count = 0;
+	const int16_t* x = nullptr;
+	const int16_t* y = nullptr;
+	const uint8_t* left_trigger = nullptr;
+	const uint8_t* right_trigger = nullptr;
+};
+
+// One stick of one device: settings, input samples and output velocities.
+// vx and vy must have room for in.count values.
+struct stick_batch_t
+{
+	const stick_t* cfg = nullptr;
+	float divisor = 1;
+	float y_sign = 1;
+	stick_samples_t in;
+	float* vx = nullptr;
+	float* vy = nullptr;
+};
+
+enum class simd_t
+{
+	scalar,
+	sse41,
+	avx2,
+};
+
+simd_t detect_simd();
+
+// Runs stick_velocity over every sample of every batch, e.g. to replay a
+// recorded session with other stick_t parameters.
+void process_stick_batches(const stick_batch_t* batches, size_t n, simd_t simd = detect_simd());
+
+} // namespace gpmouse
+
+#endif // ndef GPMOUSE_STICK_H
@@ -0,0 +1,231 @@
+#include "platform.h"
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <array>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+
+#include "uinput.h"
+
+
+namespace gpmouse
+{
+
+namespace {
+
+// The keys whose KEY_ code is not their scan code (platform.h): the extended
+// keys, which share their scan code with a key of the keypad, and the keys
+// without a scan code.
+constexpr std::array<uint16_t, 256> make_extended_keys()
+{
+	std::array<uint16_t, 256> t = {};
+	t[VK_RCONTROL] = KEY_RIGHTCTRL;
+	t[VK_RMENU] = KEY_RIGHTALT;
+	t[VK_LWIN] = KEY_LEFTMETA;
+	t[VK_RWIN] = KEY_RIGHTMETA;
+	t[VK_APPS] = KEY_COMPOSE;
+	t[VK_SNAPSHOT] = KEY_SYSRQ;
+	t[VK_PAUSE] = KEY_PAUSE;
+	t[VK_DIVIDE] = KEY_KPSLASH;
+
+	t[VK_HOME] = KEY_HOME;
+	t[VK_END] = KEY_END;
+	t[VK_PRIOR] = KEY_PAGEUP;
+	t[VK_NEXT] = KEY_PAGEDOWN;
+	t[VK_INSERT] = KEY_INSERT;
+	t[VK_DELETE] = KEY_DELETE;
+	t[VK_UP] = KEY_UP;
+	t[VK_DOWN] = KEY_DOWN;
+	t[VK_LEFT] = KEY_LEFT;
+	t[VK_RIGHT] = KEY_RIGHT;
+
+	for (int i = 0; i < 12; ++i)
+		t[VK_F13 + i] = (uint16_t)(KEY_F13 + i);
+
+	t[VK_HELP] = KEY_HELP;
+	t[VK_SLEEP] = KEY_SLEEP;
+	t[VK_BROWSER_BACK] = KEY_BACK;
+	t[VK_BROWSER_FORWARD] = KEY_FORWARD;
+	t[VK_BROWSER_REFRESH] = KEY_REFRESH;
+	t[VK_BROWSER_STOP] = KEY_STOP;
+	t[VK_BROWSER_SEARCH] = KEY_SEARCH;
+	t[VK_BROWSER_FAVORITES] = KEY_BOOKMARKS;
+	t[VK_BROWSER_HOME] = KEY_HOMEPAGE;
+	t[VK_VOLUME_MUTE] = KEY_MUTE;
+	t[VK_VOLUME_DOWN] = KEY_VOLUMEDOWN;
+	t[VK_VOLUME_UP] = KEY_VOLUMEUP;
+	t[VK_MEDIA_NEXT_TRACK] = KEY_NEXTSONG;
+	t[VK_MEDIA_PREV_TRACK] = KEY_PREVIOUSSONG;
+	t[VK_MEDIA_STOP] = KEY_STOPCD;
+	t[VK_MEDIA_PLAY_PAUSE] = KEY_PLAYPAUSE;
+	t[VK_LAUNCH_MAIL] = KEY_MAIL;
+	t[VK_LAUNCH_MEDIA_SELECT] = KEY_MEDIA;
+	t[VK_LAUNCH_APP1] = KEY_COMPUTER;
+	t[VK_LAUNCH_APP2] = KEY_CALC;
+	return t;
+}
+
+constexpr auto EXTENDED_KEYS = make_extended_keys();
+
+input_event make_event(uint16_t type, uint16_t code, int32_t value)
+{
+	input_event e = {};
+	e.type = type;
+	e.code = code;
+	e.value = value;
+	return e;
+}
+
+bool write_all(int fd, const input_event* events, size_t n)
+{
+	auto p = (const uint8_t*)events;
+	auto size = n * sizeof(input_event);
+	while (size > 0) {
+		auto written = ::write(fd, p, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		p += written;
+		size -= (size_t)written;
+	}
+	return true;
+}
+
+} // namespace
+
+uint16_t key_code(uint8_t vk)
+{
+	if (auto code = EXTENDED_KEYS[vk])
+		return code;
+	// KEY_ESC - KEY_F12 are the scan codes of set 1.
+	auto code = scan_code(vk);
+	return code <= KEY_F12 ? code : 0;
+}
+
+uinput_sink_t::~uinput_sink_t()
+{
+	close();
+}
+
+bool uinput_sink_t::open(const char* path)
+{
+	close();
+	auto fd = ::open(path, O_WRONLY|O_NONBLOCK|O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	bool ok = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0 && ioctl(fd, UI_SET_EVBIT, EV_REL) == 0;
+	for (int vk = 0; ok && vk < 256; ++vk)
+		if (auto code = key_code((uint8_t)vk))
+			ok = ioctl(fd, UI_SET_KEYBIT, code) == 0;
+	for (auto button: { BTN_LEFT, BTN_RIGHT, BTN_MIDDLE, BTN_SIDE, BTN_EXTRA })
+		ok = ok && ioctl(fd, UI_SET_KEYBIT, button) == 0;
+	for (auto axis: { REL_X, REL_Y, REL_WHEEL, REL_HWHEEL, REL_WHEEL_HI_RES, REL_HWHEEL_HI_RES })
+		ok = ok && ioctl(fd, UI_SET_RELBIT, axis) == 0;
+
+	uinput_setup setup = {};
+	setup.id.bustype = BUS_VIRTUAL;
+	strncpy(setup.name, "gpmouse", sizeof(setup.name) - 1);
+	ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+	if (!ok) {
+		::close(fd);
+		return false;
+	}
+
+	_fd = fd;
+	_device = true;
+	return true;
+}
+
+void uinput_sink_t::attach(int fd)
+{
+	close();
+	_fd = fd;
+}
+
+void uinput_sink_t::close()
+{
+	if (_fd < 0)
+		return;
+	if (_device)
+		ioctl(_fd, UI_DEV_DESTROY);
+	::close(_fd);
+	_fd = -1;
+	_device = false;
+	_wheel = _hwheel = 0;
+}
+
+UINT uinput_sink_t::send(UINT n, INPUT* inputs)
+{
+	if (_fd < 0)
+		return 0;
+
+	// a large batch is written in parts; the report closes the last one.
+	input_event events[64];
+	size_t count = 0;
+	bool ok = true;
+	auto emit = [&](uint16_t type, uint16_t code, int32_t value) {
+		if (count == std::size(events)) {
+			ok = write_all(_fd, events, count) && ok;
+			count = 0;
+		}
+		events[count++] = make_event(type, code, value);
+	};
+	auto button = [&](DWORD flags, DWORD down, DWORD up, uint16_t code) {
+		if (flags & down)
+			emit(EV_KEY, code, 1);
+		if (flags & up)
+			emit(EV_KEY, code, 0);
+	};
+	auto wheel = [&](int& rest, uint16_t hi_res, uint16_t notch, int delta) {
+		emit(EV_REL, hi_res, delta);
+		rest += delta;
+		if (auto notches = rest / WHEEL_DELTA) {
+			emit(EV_REL, notch, notches);
+			rest -= notches * WHEEL_DELTA;
+		}
+	};
+
+	for (auto i = inputs; i != inputs + n; ++i) {
+		if (i->type == INPUT_KEYBOARD) {
+			if (auto code = key_code((uint8_t)i->ki.wVk))
+				emit(EV_KEY, code, (i->ki.dwFlags & KEYEVENTF_KEYUP) ? 0 : 1);
+			continue;
+		}
+		if (i->type != INPUT_MOUSE)
+			continue;
+
+		auto& mi = i->mi;
+		auto flags = mi.dwFlags;
+		if (flags & MOUSEEVENTF_MOVE) {
+			if (mi.dx != 0)
+				emit(EV_REL, REL_X, mi.dx);
+			if (mi.dy != 0)
+				emit(EV_REL, REL_Y, mi.dy);
+		}
+		button(flags, MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_LEFTUP, BTN_LEFT);
+		button(flags, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_RIGHTUP, BTN_RIGHT);
+		button(flags, MOUSEEVENTF_MIDDLEDOWN, MOUSEEVENTF_MIDDLEUP, BTN_MIDDLE);
+		button(flags, MOUSEEVENTF_XDOWN, MOUSEEVENTF_XUP, mi.mouseData == 1 ? BTN_SIDE : BTN_EXTRA);
+		if (flags & MOUSEEVENTF_WHEEL)
+			wheel(_wheel, REL_WHEEL_HI_RES, REL_WHEEL, (int)mi.mouseData);
+		if (flags & MOUSEEVENTF_HWHEEL)
+			wheel(_hwheel, REL_HWHEEL_HI_RES, REL_HWHEEL, (int)mi.mouseData);
+	}
+	emit(EV_SYN, SYN_REPORT, 0);
+	ok = write_all(_fd, events, count) && ok;
+	return ok ? n : 0;
+}
+
+} // namespace gpmouse
+
+#endif // defined(__linux__)
@@ -0,0 +1,55 @@
+#ifndef GPMOUSE_UINPUT_H
+#define GPMOUSE_UINPUT_H
+#pragma once
+
+#if defined(__linux__)
+
+#include <stdint.h>
+
+#include "platform.h"
+
+#include "output.h"
+
+
+namespace gpmouse
+{
+
+// The KEY_ code of a virtual key, 0 if it has none.
+uint16_t key_code(uint8_t vk);
+
+// SendInput of Linux: a virtual mouse and keyboard made through uinput.
+// Each send() becomes one write() of the input_event records of the
+// batch, closed by a single SYN_REPORT, so a batch is one report.
+// The wheels are sent in high resolution, 120 per notch as WHEEL_DELTA,
+// with a notch event whenever a whole notch has accumulated.
+class uinput_sink_t: public output_sink_t
+{
+public:
+	uinput_sink_t() = default;
+	uinput_sink_t(const uinput_sink_t&) = delete;
+	uinput_sink_t& operator=(const uinput_sink_t&) = delete;
+	~uinput_sink_t();
+
+	// creates the device. false if path cannot be opened or set up.
+	bool open(const char* path = "/dev/uinput");
+	// writes the records to fd without making a device, e.g. to a pipe.
+	// The sink then owns fd.
+	void attach(int fd);
+	void close();
+
+	// the number of inputs written, 0 if the write failed.
+	UINT send(UINT n, INPUT* inputs) override;
+
+private:
+	int _fd = -1;
+	bool _device = false;
+	// the wheel motion since the last whole notch
+	int _wheel = 0;
+	int _hwheel = 0;
+};
+
+} // namespace gpmouse
+
+#endif // defined(__linux__)
+
+#endif // ndef GPMOUSE_UINPUT_H
@@ -0,0 +1,164 @@
+// The input events are built without allocating: the allocations of the
+// thread are counted around each send(), by a sink which allocates itself.
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alloc.h"
+#include "engine.h"
+#include "output.h"
+#include "process.h"
+#include "repeat.h"
+#include "settings.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+// Records every batch, which allocates, and the allocations of the thread
+// when each send() starts and ends.
+class counting_sink_t: public recording_sink_t
+{
+public:
+	UINT send(UINT n, INPUT* inputs) override {
+		entered.push_back(thread_allocations());
+		auto sent = recording_sink_t::send(n, inputs);
+		left.push_back(thread_allocations());
+		return sent;
+	}
+
+	std::vector<uint64_t> entered;
+	std::vector<uint64_t> left;
+};
+
+// the allocations made outside send() since start.
+uint64_t allocations_between_sends(const counting_sink_t& sink, uint64_t start, uint64_t end)
+{
+	uint64_t n = 0, last = start;
+	for (size_t i = 0; i < sink.entered.size(); ++i) {
+		n += sink.entered[i] - last;
+		last = sink.left[i];
+	}
+	return n + (end - last);
+}
+
+// The cursor is over an editor in window 1 or a terminal in window 2, the
+// editor is in the foreground.
+class two_windows_t: public window_system_t
+{
+public:
+	window_t window_under_cursor() override { return cursor; }
+	window_t foreground_window() override { return 1; }
+	process_id_t process_id(window_t w) override { return (process_id_t)w; }
+	bool executable_name(process_id_t pid, std::string& name) override {
+		name = pid == 1 ? "code.exe" : "windowsterminal.exe";
+		return true;
+	}
+
+	window_t cursor = 1;
+};
+
+// the default bindings, plus LB+A for the editor.
+void add_app_binding(settings_t& s)
+{
+	auto& c = *s.controllers[0];
+	auto app = s.app_matcher.add("editor", "code.exe");
+	c.key_bindings.clear();
+	for (auto& sb: c.single_button)
+		if (sb.buttons != 0)
+			c.key_bindings.push_back(sb);
+	c.key_bindings.push_back({ .app = app, .priority = 0, .buttons = XINPUT_GAMEPAD_LEFT_SHOULDER | XINPUT_GAMEPAD_A, .keys = { VK_F5, 0, 0, 0 } });
+	std::sort(c.key_bindings.begin(), c.key_bindings.end(), [](auto& a, auto& b) {
+		return a.buttons < b.buttons || (a.buttons == b.buttons && a.priority < b.priority);
+	});
+	c.binding_table.build(c.key_bindings, c.single_button);
+	c.binding_profiles.clear();
+}
+
+} // namespace
+
+int main()
+{
+	// the counter counts.
+	auto before = thread_allocations();
+	auto p = std::make_unique<int>(1);
+	CHECK_EQ(thread_allocations() - before, 1);
+
+	// the sink allocates on every send, but not when it records the counts.
+	counting_sink_t sink;
+	sink.entered.reserve(16);
+	sink.left.reserve(16);
+
+	// mouse buttons, modifiers and keys, pressed then released.
+	keystate_t keys = {};
+	for (uint8_t vk: { VK_LBUTTON, VK_RBUTTON, VK_SHIFT, VK_CONTROL, VK_MENU, VK_LWIN, VK_UP, VK_F5 })
+		keys.press(vk);
+	for (int vk = 'A'; vk <= 'Z'; ++vk)
+		keys.press((uint8_t)vk);
+	keystate_t state = {};
+
+	auto start = thread_allocations();
+	CHECK_EQ(gp_handle_buttons_input(sink, keys, state), 34);
+	CHECK_EQ(gp_handle_buttons_input(sink, {}, state), 34);
+	CHECK_EQ(gp_handle_buttons_input(sink, {}, state), 0);
+	auto end = thread_allocations();
+	CHECK_EQ(sink.batches.size(), 2);
+	CHECK(end > start);	// in the sink
+	CHECK_EQ(allocations_between_sends(sink, start, end), 0);
+
+	// more repeats at once than a batch takes, so one is sent in the middle.
+	repeat_scheduler_t repeats;
+	repeat_config_t cfg = { .delay = 10, .interval = 10, .keys = {} };
+	for (device_id_t d = 0; d < 2; ++d)
+		for (int vk = 1; vk < 200; ++vk)
+			repeats.press(d, (uint8_t)vk, 0, cfg);
+	sink.entered.clear();
+	sink.left.clear();
+	start = thread_allocations();
+	repeat_keys(sink, repeats, 10);
+	end = thread_allocations();
+	CHECK_EQ(sink.entered.size(), 2);
+	CHECK_EQ(sink.inputs.size(), 68 + 398);
+	CHECK_EQ(allocations_between_sends(sink, start, end), 0);
+
+	// a binding of an application, under the cursor in turn with another
+	// one: once both names are cached, matched and their profiles built,
+	// the handler only allocates in the sink.
+	settings_t s;
+	default_config(s);
+	add_app_binding(s);
+	two_windows_t windows;
+	process_cache_t processes(windows);
+	button_handler_t handler(sink, processes);
+	const uint16_t lb_a = XINPUT_GAMEPAD_LEFT_SHOULDER | XINPUT_GAMEPAD_A;
+	uint64_t now = 0;
+	auto press = [&](window_t cursor) {
+		windows.cursor = cursor;
+		handler.handle(s, { .device = 0, .timestamp = 0, .buttons = lb_a, .controller = 0 }, now++);
+		handler.handle(s, { .device = 0, .timestamp = 0, .buttons = 0, .controller = 0 }, now++);
+	};
+	press(1);
+	press(2);
+
+	sink.entered.clear();
+	sink.left.clear();
+	sink.inputs.clear();
+	start = thread_allocations();
+	auto allowed = thread_allowed_allocations();
+	press(1);
+	press(2);
+	end = thread_allocations();
+	CHECK_EQ(allocations_between_sends(sink, start, end), 0);
+	CHECK_EQ((end - start) - (thread_allowed_allocations() - allowed), 0);
+	auto f5 = std::count_if(sink.inputs.begin(), sink.inputs.end(), [](const INPUT& i) {
+		return i.type == INPUT_KEYBOARD && i.ki.wVk == VK_F5;
+	});
+	CHECK_EQ(f5, 2);	// down and up, over the editor only
+
+	return test::test_result();
+}
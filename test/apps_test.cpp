@@ -0,0 +1,64 @@
+// app_matcher_t: literal and regex patterns, the memo, and a match which
+// stays valid while the memo is dropped for growing too large.
+#include <stdint.h>
+
+#include <string>
+
+#include "apps.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+int main()
+{
+	app_matcher_t matcher;
+	auto notepad = matcher.add("notepad", "notepad\\.exe");
+	auto editors = matcher.add("editors", "(notepad|code)\\.exe");
+	auto terminal = matcher.add("terminal", "WindowsTerminal\\.exe");
+	CHECK_EQ(matcher.size(), 3);
+
+	// literals and regexes, case-insensitively.
+	auto a = matcher.match("Notepad.exe");
+	CHECK(a.test(notepad));
+	CHECK(a.test(editors));
+	CHECK(!a.test(terminal));
+	auto b = matcher.match("code.exe");
+	CHECK(!b.test(notepad));
+	CHECK(b.test(editors));
+	CHECK(matcher.match("windowsterminal.exe").test(terminal));
+	CHECK(!matcher.match("notepad.exe.bak").test(notepad));
+	CHECK(!matcher.match("").test(editors));
+
+	// a name is matched once.
+	auto misses = matcher.stats().misses;
+	CHECK(matcher.match("code.exe") == b);
+	CHECK_EQ(matcher.stats().misses, misses);
+
+	// the sets of the windows under the cursor and in the foreground stay
+	// valid while other names drop the memo.
+	auto& cursor = matcher.match("notepad.exe");
+	for (int i = 0; i < 3000; ++i)
+		matcher.match("process" + std::to_string(i) + ".exe");
+	auto& foreground = matcher.match("code.exe");
+	CHECK(cursor.test(notepad));
+	CHECK(cursor.test(editors));
+	CHECK(!foreground.test(notepad));
+	CHECK(foreground.test(editors));
+
+	// restored patterns are compiled on the first match; a malformed one
+	// never matches.
+	app_matcher_t restored;
+	auto r = restored.restore("editors", "(notepad|code)\\.exe");
+	auto broken = restored.restore("broken", "(notepad");
+	auto set = restored.match("code.exe");
+	CHECK(set.test(r));
+	CHECK(!set.test(broken));
+
+	// clear() forgets the applications and the memo.
+	matcher.clear();
+	CHECK_EQ(matcher.size(), 0);
+	CHECK(!matcher.match("notepad.exe").test(notepad));
+
+	return test::test_result();
+}
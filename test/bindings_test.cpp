@@ -0,0 +1,163 @@
+// binding_table_t and binding_profile_t against the resolution they
+// replaced, a binary search over the sorted bindings, for all 65536 button
+// masks and several pairs of applications.
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+#include "config.h"
+#include "apps.h"
+#include "bindings.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr uint32_t MASKS = 1 << 16;
+constexpr app_id_t APPS = 8;
+
+// bindings on a few hundred masks, several on some of them, as configure() sorts them.
+std::vector<key_binding_t> random_bindings()
+{
+	std::mt19937 random(2024);
+	std::uniform_int_distribution<int> mask(1, 0xffff), app(0, APPS), key(1, 254), coin(0, 3);
+	std::vector<key_binding_t> bindings;
+	for (int i = 0; i < 400; ++i) {
+		key_binding_t b = {};
+		b.buttons = (uint16_t)mask(random);
+		auto a = app(random);
+		b.app = a == APPS ? NO_APP : (app_id_t)a;
+		b.priority = (uint16_t)(b.app == NO_APP ? UINT16_MAX : a);
+		b.foreground_window(coin(random) == 0);
+		b.oneshot(coin(random) == 0);
+		b.modifiers = (uint8_t)coin(random);
+		b.keys[0] = (uint8_t)key(random);
+		b.keys[1] = coin(random) == 0 ? (uint8_t)key(random) : 0;
+		bindings.push_back(b);
+		// another binding or two of the same buttons.
+		for (int n = coin(random); n > 1; --n) {
+			auto more = b;
+			auto a = app(random);
+			more.app = a == APPS ? NO_APP : (app_id_t)a;
+			more.priority = (uint16_t)(more.app == NO_APP ? UINT16_MAX : a);
+			more.keys[0] = (uint8_t)key(random);
+			bindings.push_back(more);
+		}
+	}
+	std::stable_sort(bindings.begin(), bindings.end(), [](auto& a, auto& b) {
+		return a.buttons < b.buttons || (a.buttons == b.buttons && a.priority < b.priority);
+	});
+	return bindings;
+}
+
+// what translate_input did before the table: the first binding of the
+// buttons whose application matches, or the single buttons put together.
+keystate_t reference(const std::vector<key_binding_t>& bindings, const key_binding_t (&single_button)[16],
+	uint16_t buttons, const app_set_t& cursor, const app_set_t& foreground)
+{
+	key_binding_t key = {};
+	key.buttons = buttons;
+	auto [first, last] = std::equal_range(bindings.begin(), bindings.end(), key);
+	keystate_t keys = {};
+	if (first == last) {
+		for (int i = 0; i < 16; ++i)
+			if (buttons & (1 << i))
+				single_button[i].fill(keys);
+		return keys;
+	}
+	for (auto b = first; b != last; ++b) {
+		auto& apps = b->foreground_window() ? foreground : cursor;
+		if (b->app == NO_APP || apps.test(b->app)) {
+			b->fill(keys);
+			break;
+		}
+	}
+	return keys;
+}
+
+app_set_t apps(std::initializer_list<app_id_t> ids)
+{
+	app_set_t set(APPS);
+	for (auto id: ids)
+		set.set(id);
+	return set;
+}
+
+} // namespace
+
+int main()
+{
+	auto bindings = random_bindings();
+	key_binding_t single_button[16] = {};
+	for (int i = 0; i < 16; ++i)
+		single_button[i] = { .modifiers = (uint8_t)(i % 3 == 0 ? key_binding_t::SHIFT : 0), .keys = { (uint8_t)(0x41 + i), 0, 0, 0 } };
+	single_button[5] = {};	// a button without a key
+
+	binding_table_t table;
+	table.build(bindings, single_button);
+	CHECK_EQ(table.size(), bindings.size());
+
+	// the candidates of every mask are its bindings, in their order.
+	int failed = 0;
+	for (uint32_t buttons = 0; buttons < MASKS && failed < 10; ++buttons) {
+		key_binding_t key = {};
+		key.buttons = (uint16_t)buttons;
+		auto [first, last] = std::equal_range(bindings.begin(), bindings.end(), key);
+		auto candidates = table.candidates((uint16_t)buttons);
+		bool same = candidates.size() == (size_t)(last - first) &&
+			table.offset((uint16_t)buttons) == (uint32_t)(first - bindings.begin());
+		for (size_t i = 0; same && i < candidates.size(); ++i) {
+			auto& b = first[i];
+			keystate_t keys = {};
+			b.fill(keys);
+			same = candidates[i].app == b.app && candidates[i].flags == b.flags &&
+				table.keys(candidates[i]) == keys && table.binding(candidates[i]).buttons == b.buttons;
+		}
+		if (candidates.empty()) {
+			keystate_t keys = {};
+			for (int i = 0; i < 16; ++i)
+				if (buttons & (1 << i))
+					single_button[i].fill(keys);
+			same = same && table.combine((uint16_t)buttons) == keys;
+		}
+		if (!same) {
+			fprintf(stderr, "mask %04X: the table differs from the bindings\n", buttons);
+			++failed;
+		}
+	}
+	CHECK_EQ(failed, 0);
+
+	// the flattened profiles resolve every mask as the search did.
+	const std::pair<app_set_t, app_set_t> windows[] = {
+		{ app_set_t(), app_set_t() },
+		{ apps({ 1 }), apps({ 1 }) },
+		{ apps({ 1, 2 }), apps({ 3 }) },
+		{ apps({ 4 }), apps({ 0, 5, 6, 7 }) },
+		{ apps({ 0, 1, 2, 3, 4, 5, 6, 7 }), app_set_t() },
+	};
+	binding_profiles_t profiles(table);
+	for (auto& [cursor, foreground]: windows) {
+		auto& profile = profiles.select(cursor, foreground);
+		failed = 0;
+		for (uint32_t buttons = 0; buttons < MASKS && failed < 10; ++buttons) {
+			if (profile.resolve((uint16_t)buttons) != reference(bindings, single_button, (uint16_t)buttons, cursor, foreground)) {
+				fprintf(stderr, "mask %04X: the profile differs from the search\n", buttons);
+				++failed;
+			}
+		}
+		CHECK_EQ(failed, 0);
+	}
+
+	// switching back to a pair of applications takes its profile again.
+	auto& a = profiles.select(windows[1].first, windows[1].second);
+	profiles.select(windows[2].first, windows[2].second);
+	CHECK(&profiles.select(windows[1].first, windows[1].second) == &a);
+
+	return test::test_result();
+}
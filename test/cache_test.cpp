@@ -0,0 +1,143 @@
+// The configuration cache: a settings_t comes back from its cache as it was
+// saved, and a cache of another text, a broken file or a payload cut short
+// or padded is refused, even with a checksum which matches.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+#include "cache.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+// where cache.cpp keeps the payload size and its checksum in the header.
+constexpr size_t HEADER = 32, SIZE_AT = 16, CHECKSUM_AT = 24;
+
+// the header of data made valid again for its payload, as a corrupt cache
+// written by a broken build would be.
+std::vector<uint8_t> reseal(std::vector<uint8_t> data)
+{
+	uint64_t size = data.size() - HEADER, h = 0xcbf29ce484222325ull;
+	for (size_t i = HEADER; i < data.size(); ++i) {
+		h ^= data[i];
+		h *= 0x100000001b3ull;
+	}
+	memcpy(data.data() + SIZE_AT, &size, sizeof(size));
+	memcpy(data.data() + CHECKSUM_AT, &h, sizeof(h));
+	return data;
+}
+
+std::unique_ptr<settings_t> load(const std::vector<uint8_t>& data, uint64_t key)
+{
+	return deserialize_settings(data.data(), data.size(), key);
+}
+
+void settings(settings_t& s)
+{
+	default_config(s);
+	s.log.directory = "/var/log/gpmouse";
+	s.log.max_size = 1 << 20;
+	s.log.max_files = 3;
+	s.log.level = "debug";
+	auto editor = s.app_matcher.add("editor", "(vim|emacs)\\.exe");
+	s.app_matcher.add("game", "game.exe");
+	key_binding_t b = { .buttons = XINPUT_GAMEPAD_A | XINPUT_GAMEPAD_B, .keys = { VK_F1, 0, 0, 0 } };
+	b.app = editor;
+	s.controllers[0]->key_bindings.push_back(b);
+	s.controllers[0]->binding_table.build(s.controllers[0]->key_bindings, s.controllers[0]->single_button);
+	s.repeat = { .delay = 250, .interval = 30, .keys = {} };
+	s.app_repeats.push_back({ editor, { .delay = 400, .interval = 50, .keys = {} } });
+}
+
+} // namespace
+
+int main()
+{
+	settings_t s;
+	settings(s);
+	auto key = settings_cache_key("[cursor]\nspeed = 1\n");
+	auto data = serialize_settings(s, key);
+
+	// round trip: the same settings, down to the bytes of the cache.
+	{
+		auto t = load(data, key);
+		CHECK(t != nullptr);
+		if (t) {
+			CHECK(t->log.directory == s.log.directory);
+			CHECK_EQ(t->log.max_size, s.log.max_size);
+			CHECK_EQ(t->log.max_files, s.log.max_files);
+			CHECK(t->log.level == s.log.level);
+			CHECK_EQ(t->app_matcher.size(), 2);
+			CHECK(t->app_matcher.pattern(0) == s.app_matcher.pattern(0));
+			CHECK_EQ(t->controllers[0]->key_bindings.size(), s.controllers[0]->key_bindings.size());
+			CHECK_EQ(t->repeat.delay, 250);
+			CHECK_EQ(t->app_repeats.size(), 1);
+			CHECK(serialize_settings(*t, key) == data);
+		}
+	}
+
+	// stale: made from another text.
+	CHECK(settings_cache_key("[cursor]\nspeed = 2\n") != key);
+	CHECK(load(data, settings_cache_key("[cursor]\nspeed = 2\n")) == nullptr);
+
+	// corrupt: a flipped byte anywhere, or cut short.
+	for (size_t i = 0; i < data.size(); i += 7) {
+		auto broken = data;
+		broken[i] ^= 0x10;
+		if (load(broken, key) != nullptr) {
+			fprintf(stderr, "a cache with byte %zu flipped was loaded\n", i);
+			CHECK(false);
+			break;
+		}
+	}
+	CHECK(load(std::vector<uint8_t>(data.begin(), data.end() - 1), key) == nullptr);
+	CHECK(load(std::vector<uint8_t>(data.begin(), data.begin() + HEADER - 1), key) == nullptr);
+
+	// a payload cut short or padded, with a header which matches it.
+	CHECK(load(reseal(data), key) != nullptr);
+	for (size_t n = HEADER; n < data.size(); n += 5) {
+		if (load(reseal(std::vector<uint8_t>(data.begin(), data.begin() + n)), key) != nullptr) {
+			fprintf(stderr, "a cache cut at %zu was loaded\n", n);
+			CHECK(false);
+			break;
+		}
+	}
+	{
+		auto padded = data;
+		padded.push_back(0);
+		CHECK(load(reseal(padded), key) == nullptr);
+	}
+
+	// through a file.
+	auto dir = std::filesystem::temp_directory_path() / ("gpmouse_cache_test." + std::to_string(getpid()));
+	std::filesystem::create_directories(dir);
+	auto path = (dir / "gpmouse.cache").wstring();
+	CHECK(load_settings_cache(path, key) == nullptr);	// missing
+	CHECK(save_settings_cache(path, s, key));
+	{
+		auto t = load_settings_cache(path, key);
+		CHECK(t != nullptr);
+		if (t)
+			CHECK(serialize_settings(*t, key) == data);
+	}
+	CHECK(load_settings_cache(path, key + 1) == nullptr);
+	{
+		std::fstream f(std::filesystem::path(path), std::ios::in | std::ios::out | std::ios::binary);
+		f.seekp(HEADER + 3);
+		f.put('\x7f');
+	}
+	CHECK(load_settings_cache(path, key) == nullptr);
+	std::filesystem::remove_all(dir);
+
+	return test::test_result();
+}
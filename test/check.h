@@ -0,0 +1,48 @@
+#ifndef GPMOUSE_TEST_CHECK_H
+#define GPMOUSE_TEST_CHECK_H
+#pragma once
+
+#include <stdio.h>
+
+
+// The checks of the tests. A failed check is reported and the test goes on;
+// main() returns test_result().
+namespace gpmouse::test
+{
+
+inline int& failures()
+{
+	static int n = 0;
+	return n;
+}
+
+inline int test_result()
+{
+	if (failures() != 0)
+		fprintf(stderr, "%d checks failed\n", failures());
+	return failures() != 0;
+}
+
+} // namespace gpmouse::test
+
+#define CHECK(x) \
+	do { \
+		if (!(x)) { \
+			++::gpmouse::test::failures(); \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); \
+		} \
+	} while (0)
+
+// a comparison of integers, which prints both sides when it fails.
+#define CHECK_EQ(a, b) \
+	do { \
+		auto a_ = (long long)(a); \
+		auto b_ = (long long)(b); \
+		if (!(a_ == b_)) { \
+			++::gpmouse::test::failures(); \
+			fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, \
+				#a, #b, a_, b_); \
+		} \
+	} while (0)
+
+#endif // ndef GPMOUSE_TEST_CHECK_H
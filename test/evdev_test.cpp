@@ -0,0 +1,252 @@
+// The evdev source and the uinput sink on pipes: input_event records
+// written to a pipe come out as XInput states, a press and a release in the
+// same write take a tick each, a record split between writes is joined,
+// the end of the stream disconnects the pad, and a button mapped through
+// the engine comes out of the uinput sink as key records.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <linux/input.h>
+
+#include "settings.h"
+#include "evdev.h"
+#include "uinput.h"
+#include "engine.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+input_event event(uint16_t type, uint16_t code, int32_t value)
+{
+	input_event e = {};
+	e.type = type;
+	e.code = code;
+	e.value = value;
+	return e;
+}
+
+input_event report()
+{
+	return event(EV_SYN, SYN_REPORT, 0);
+}
+
+bool write_events(int fd, const std::vector<input_event>& events)
+{
+	auto size = events.size() * sizeof(input_event);
+	return write(fd, events.data(), size) == (ssize_t)size;
+}
+
+// the states of a tick, as check_evdev() takes them.
+struct tick_t
+{
+	std::vector<std::pair<device_id_t, XINPUT_STATE>> states;
+	std::vector<device_id_t> lost;
+	int changed = 0;
+};
+
+tick_t tick(evdev_source_t& source, int timeout = 100)
+{
+	source.wait(timeout);
+	tick_t t;
+	source.poll(
+		[&](device_id_t id, const XINPUT_STATE& s, bool changed) {
+			t.states.push_back({ id, s });
+			t.changed += changed;
+		},
+		[&](device_id_t id) { t.lost.push_back(id); });
+	return t;
+}
+
+void source()
+{
+	device_registry_t devices;
+	evdev_source_t source(devices);
+	CHECK(source.open());
+
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	auto id = source.add_stream(fds[0]);
+	CHECK(id != device_registry_t::NONE);
+	CHECK_EQ(source.count(), 0);	// no state yet
+	CHECK(!source.connected(id));
+
+	// the first report connects the pad.
+	CHECK(write_events(fds[1], { event(EV_ABS, ABS_X, 20000), event(EV_ABS, ABS_Y, -32768), event(EV_ABS, ABS_RZ, 255), report() }));
+	auto t = tick(source);
+	CHECK_EQ(t.states.size(), 1);
+	CHECK_EQ(t.changed, 1);
+	CHECK(source.connected(id));
+	CHECK_EQ(source.count(), 1);
+	auto& pad = t.states[0].second.Gamepad;
+	CHECK_EQ(pad.sThumbLX, 20000);
+	CHECK_EQ(pad.sThumbLY, 32767);	// up
+	CHECK_EQ(pad.bRightTrigger, 255);
+	CHECK_EQ(pad.wButtons, 0);
+
+	// a press and its release in one write: neither is lost.
+	CHECK(write_events(fds[1], { event(EV_KEY, BTN_SOUTH, 1), report(), event(EV_KEY, BTN_SOUTH, 0), report() }));
+	t = tick(source);
+	CHECK_EQ(t.changed, 1);
+	CHECK_EQ(t.states[0].second.Gamepad.wButtons, XINPUT_GAMEPAD_A);
+	CHECK(source.backlog());
+	t = tick(source, 0);
+	CHECK_EQ(t.changed, 1);
+	CHECK_EQ(t.states[0].second.Gamepad.wButtons, 0);
+	CHECK(!source.backlog());
+
+	// a record split between two writes, and the hat as the d-pad.
+	std::vector<input_event> hat = { event(EV_ABS, ABS_HAT0X, 1), event(EV_ABS, ABS_HAT0Y, -1), report() };
+	auto bytes = (const char*)hat.data();
+	auto half = sizeof(input_event) + sizeof(input_event) / 2;
+	CHECK(write(fds[1], bytes, half) == (ssize_t)half);
+	t = tick(source);
+	CHECK_EQ(t.changed, 0);
+	CHECK(write(fds[1], bytes + half, hat.size() * sizeof(input_event) - half) == (ssize_t)(hat.size() * sizeof(input_event) - half));
+	t = tick(source);
+	CHECK_EQ(t.changed, 1);
+	CHECK_EQ(t.states[0].second.Gamepad.wButtons, XINPUT_GAMEPAD_DPAD_RIGHT | XINPUT_GAMEPAD_DPAD_UP);
+
+	// an unchanged report is no packet.
+	CHECK(write_events(fds[1], { event(EV_ABS, ABS_HAT0X, 1), report() }));
+	t = tick(source);
+	CHECK_EQ(t.changed, 0);
+
+	// nothing to read: the wait times out.
+	t = tick(source, 10);
+	CHECK_EQ(t.changed, 0);
+
+	// wake() ends a wait at once.
+	source.wake();
+	CHECK(!source.wait(-1));
+
+	// the end of the stream.
+	close(fds[1]);
+	t = tick(source);
+	CHECK_EQ(t.lost.size(), 1);
+	CHECK(t.states.empty());
+	CHECK(!source.connected(id));
+}
+
+// the records written for a batch.
+std::vector<input_event> read_events(int fd)
+{
+	std::vector<input_event> events(256);
+	auto n = read(fd, events.data(), events.size() * sizeof(input_event));
+	events.resize(n > 0 ? (size_t)n / sizeof(input_event) : 0);
+	return events;
+}
+
+bool has(const std::vector<input_event>& events, uint16_t type, uint16_t code, int32_t value)
+{
+	for (auto& e: events)
+		if (e.type == type && e.code == code && e.value == value)
+			return true;
+	return false;
+}
+
+void sink()
+{
+	int fds[2];
+	CHECK(pipe(fds) == 0);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	uinput_sink_t sink;
+	sink.attach(fds[1]);
+
+	INPUT inputs[3] = {};
+	inputs[0].type = INPUT_KEYBOARD;
+	inputs[0].ki.wVk = 'A';
+	inputs[1].type = INPUT_MOUSE;
+	inputs[1].mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_LEFTDOWN;
+	inputs[1].mi.dx = 5;
+	inputs[1].mi.dy = -3;
+	inputs[2].type = INPUT_MOUSE;
+	inputs[2].mi.dwFlags = MOUSEEVENTF_WHEEL;
+	inputs[2].mi.mouseData = 60;
+	CHECK_EQ(sink.send(3, inputs), 3);
+
+	// one report for the batch.
+	auto events = read_events(fds[0]);
+	CHECK_EQ(events.size(), 6);
+	CHECK(has(events, EV_KEY, KEY_A, 1));
+	CHECK(has(events, EV_REL, REL_X, 5));
+	CHECK(has(events, EV_REL, REL_Y, -3));
+	CHECK(has(events, EV_KEY, BTN_LEFT, 1));
+	CHECK(has(events, EV_REL, REL_WHEEL_HI_RES, 60));
+	CHECK(!has(events, EV_REL, REL_WHEEL, 1));	// half a notch
+	CHECK(events.size() && events.back().type == EV_SYN && events.back().code == SYN_REPORT);
+
+	// the other half makes the notch.
+	CHECK_EQ(sink.send(1, inputs + 2), 1);
+	events = read_events(fds[0]);
+	CHECK(has(events, EV_REL, REL_WHEEL_HI_RES, 60));
+	CHECK(has(events, EV_REL, REL_WHEEL, 1));
+
+	sink.close();
+	close(fds[0]);
+}
+
+// a pad on a pipe through the engine to a uinput sink on a pipe.
+void pipeline()
+{
+	settings_t s;
+	default_config(s);
+
+	device_registry_t devices;
+	evdev_source_t source(devices);
+	CHECK(source.open());
+	int in[2], out[2];
+	CHECK(pipe(in) == 0 && pipe(out) == 0);
+	fcntl(out[0], F_SETFL, O_NONBLOCK);
+	source.add_stream(in[0]);
+
+	xinput_queue_t queue(overflow_t::drop);
+	analog_output_t output;
+	poller_t poller(queue, output);
+	poller.attach(devices);
+	poller.configure(s);
+	uinput_sink_t sink;
+	sink.attach(out[1]);
+	no_window_system_t windows;
+	process_cache_t processes(windows);
+	button_handler_t handler(sink, processes);
+
+	// A is ESCAPE; a press, then the release.
+	CHECK(write_events(in[1], { event(EV_KEY, BTN_SOUTH, 1), report(), event(EV_KEY, BTN_SOUTH, 0), report() }));
+	std::vector<input_event> events;
+	for (uint64_t now = 1; now <= 3; ++now) {
+		source.wait(0);
+		poller.begin(now * 1000, now * 1000000);
+		source.poll(
+			[&](device_id_t id, const XINPUT_STATE& state, bool changed) { poller.state(id, state, changed); },
+			[&](device_id_t id) { poller.disconnect(id); });
+		poller.end();
+		xinput_t input;
+		while (queue.pop(input))
+			handler.handle(s, input, now);
+		auto e = read_events(out[0]);
+		events.insert(events.end(), e.begin(), e.end());
+	}
+	CHECK(has(events, EV_KEY, KEY_ESC, 1));
+	CHECK(has(events, EV_KEY, KEY_ESC, 0));
+
+	close(in[1]);
+	close(out[0]);
+}
+
+} // namespace
+
+int main()
+{
+	source();
+	sink();
+	pipeline();
+	return test::test_result();
+}
@@ -0,0 +1,145 @@
+// The latency histograms: every duration falls in the bucket which bounds
+// it, the summary is within a bucket of the truth, the dump has a line per
+// stage with records, and the pipeline records each stage of a press.
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <spdlog/sinks/ostream_sink.h>
+
+#include "settings.h"
+#include "latency.h"
+#include "engine.h"
+#include "poll.h"
+#include "source.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+using histogram_t = latency_histogram_t;
+
+void buckets()
+{
+	// the buckets are in order, and each one starts where the last ended.
+	int failed = 0;
+	for (size_t b = 0; b + 1 < histogram_t::BUCKETS && failed < 10; ++b) {
+		auto lo = histogram_t::lower_bound(b), hi = histogram_t::lower_bound(b + 1);
+		if (hi <= lo || histogram_t::bucket(lo) != b || histogram_t::bucket(hi - 1) != b
+			|| (lo >= 8 && (hi - lo) * 4 > lo)) {
+			fprintf(stderr, "bucket %zu: [%llu, %llu)\n", b, (unsigned long long)lo, (unsigned long long)hi);
+			++failed;
+		}
+	}
+	CHECK_EQ(failed, 0);
+	CHECK_EQ(histogram_t::bucket(0), 0);
+	CHECK_EQ(histogram_t::bucket(histogram_t::LIMIT), histogram_t::BUCKETS - 1);
+	CHECK_EQ(histogram_t::bucket(UINT64_MAX), histogram_t::BUCKETS - 1);
+}
+
+void summary()
+{
+	histogram_t h;
+	CHECK_EQ(h.summary().count, 0);
+
+	// 1 to 1000 us.
+	for (uint64_t i = 1; i <= 1000; ++i)
+		h.record(i * 1000);
+	auto s = h.summary();
+	CHECK_EQ(s.count, 1000);
+	CHECK_EQ(s.mean, 500500);
+	CHECK_EQ(s.max, 1000000);
+	// at or above the true value, by less than a bucket.
+	auto near = [](uint64_t p, uint64_t truth) { return p >= truth && p < truth + truth / 4; };
+	CHECK(near(s.p50, 500000));
+	CHECK(near(s.p90, 900000));
+	CHECK(near(s.p99, 990000));
+	CHECK(near(s.p999, 999000));
+	CHECK(s.p50 <= s.p90 && s.p90 <= s.p99 && s.p99 <= s.p999 && s.p999 <= s.max);
+}
+
+void dump()
+{
+	latency_stats_t stats;
+	for (int i = 0; i < 100; ++i)
+		stats.record(latency_stage_t::enqueue, 1000);
+	stats.record(latency_stage_t::total, 2500000);
+
+	std::ostringstream out;
+	auto sink = std::make_shared<spdlog::sinks::ostream_sink_st>(out);
+	spdlog::logger logger("latency_test", sink);
+	logger.set_pattern("%v");
+	stats.dump(logger);
+
+	// the stages without a record are left out.
+	CHECK(out.str() ==
+		"latency enqueue   n=100 mean=1.0us p50=1.0us p90=1.0us p99=1.0us p99.9=1.0us max=1.0us\n"
+		"latency total     n=1 mean=2.50ms p50=2.50ms p90=2.50ms p99=2.50ms p99.9=2.50ms max=2.50ms\n");
+	if (test::failures())
+		fprintf(stderr, "%s", out.str().c_str());
+}
+
+// a press and a release through the poller and the handler.
+void pipeline()
+{
+	settings_t s;
+	default_config(s);
+	latency_stats_t stats;
+
+	device_registry_t devices;
+	synthetic_source_t source(devices);
+	slot_tracker_t slots(s.polling, source, devices);
+	xinput_queue_t queue(overflow_t::drop);
+	analog_output_t output;
+	poller_t poller(queue, output, &stats);
+	poller.attach(devices);
+	poller.configure(s);
+
+	no_window_system_t windows;
+	process_cache_t processes(windows);
+	recording_sink_t sink;
+	button_handler_t handler(sink, processes, &stats);
+
+	for (int t = 0; t < 4; ++t) {
+		XINPUT_GAMEPAD pad = {};
+		if (t == 1)
+			pad.wButtons = XINPUT_GAMEPAD_A;
+		source.set(0, pad);
+
+		auto polled = now_ns();
+		poller.begin(polled / 1000, polled);
+		slots.poll(polled / 1000,
+			[&](device_id_t i, const XINPUT_STATE& state, bool changed) { poller.state(i, state, changed); },
+			[&](device_id_t i) { poller.disconnect(i); });
+		poller.end();
+
+		xinput_t input;
+		while (queue.pop(input))
+			handler.handle(s, input, polled / 1000000);
+	}
+
+	// the press and the release, each through every stage.
+	for (auto stage: { latency_stage_t::enqueue, latency_stage_t::dequeue, latency_stage_t::translate,
+			latency_stage_t::emit, latency_stage_t::total })
+		CHECK_EQ(stats.histogram(stage).summary().count, 2);
+	CHECK_EQ(stats.histogram(latency_stage_t::poll).summary().count, 0);	// recorded by the polling loop
+	CHECK_EQ(sink.inputs.size(), 2);
+	// no stage of a test on one thread takes a second.
+	CHECK(stats.histogram(latency_stage_t::total).summary().max < 1000000000);
+}
+
+} // namespace
+
+int main()
+{
+	buckets();
+	summary();
+	dump();
+	pipeline();
+	return test::test_result();
+}
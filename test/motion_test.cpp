@@ -0,0 +1,103 @@
+// motion_integrator_t fed with synthetic samples: the displacement over a
+// second is the same at any polling rate, and slow deflections which never
+// make a whole count in one sample still move.
+#include <stdint.h>
+#include <math.h>
+
+#include <initializer_list>
+
+#include "output.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr uint32_t REFERENCE = 8000;	// [us]
+constexpr uint64_t DURATION = 1000 * 1000;	// [us]
+
+struct total_t
+{
+	long long dx = 0;
+	long long dy = 0;
+	long long hwheel = 0;
+	long long vwheel = 0;
+};
+
+// samples v every interval, alternately interval - jitter and interval + jitter, for DURATION.
+total_t integrate(const analog_motion_t& v, uint64_t interval, uint64_t jitter = 0)
+{
+	motion_integrator_t integrator(REFERENCE);
+	total_t total;
+	// the first sample counts for one reference interval, so it is taken at REFERENCE.
+	uint64_t now = REFERENCE;
+	for (int i = 0; now <= DURATION; ++i) {
+		auto f = integrator.integrate(now, v);
+		total.dx += f.dx;
+		total.dy += f.dy;
+		total.hwheel += f.hwheel;
+		total.vwheel += f.vwheel;
+		now += (i % 2) ? interval + jitter : interval - jitter;
+	}
+	return total;
+}
+
+bool near(long long actual, double expected)
+{
+	return fabs(actual - expected) <= 1;
+}
+
+} // namespace
+
+int main()
+{
+	// counts per reference interval, some of them below one.
+	const analog_motion_t v = { .dx = 2.5f, .dy = -0.3f, .hwheel = 0.05f, .vwheel = -7.75f };
+	const double intervals = (double)DURATION / REFERENCE;
+
+	for (uint64_t interval: { 1000, 2000, 4000, 8000, 10000, 16000 }) {
+		auto t = integrate(v, interval);
+		// the last sample may fall short of DURATION by less than an interval.
+		auto covered = (double)(REFERENCE + (DURATION - REFERENCE) / interval * interval) / REFERENCE;
+		CHECK(near(t.dx, v.dx * covered));
+		CHECK(near(t.dy, v.dy * covered));
+		CHECK(near(t.hwheel, v.hwheel * covered));
+		CHECK(near(t.vwheel, v.vwheel * covered));
+		CHECK(covered > intervals - 2);
+	}
+
+	// 8 ms with jitter, as the poll loop runs.
+	{
+		auto t = integrate(v, 8000, 1500);
+		CHECK(near(t.dx, v.dx * intervals) || near(t.dx, v.dx * (intervals - 1)));
+		CHECK(near(t.vwheel, v.vwheel * intervals) || near(t.vwheel, v.vwheel * (intervals - 1)));
+		CHECK(t.dy < 0);
+		CHECK(t.hwheel > 0);
+	}
+
+	// a slow deflection moves, where truncating every sample would not.
+	{
+		auto t = integrate({ .dx = 0.2f }, 1000);
+		CHECK(t.dx > 0);
+		CHECK(near(t.dx, 0.2 * intervals));
+	}
+
+	// a pause longer than a few intervals does not jump.
+	{
+		motion_integrator_t integrator(REFERENCE);
+		integrator.integrate(REFERENCE, { .dx = 10 });
+		auto f = integrator.integrate(REFERENCE + 1000 * 1000, { .dx = 10 });
+		CHECK(f.dx <= 40);
+	}
+
+	// the remainder is dropped when the stick returns to the center.
+	{
+		motion_integrator_t integrator(REFERENCE);
+		CHECK_EQ(integrator.integrate(8000, { .dx = 0.9f }).dx, 0);
+		CHECK_EQ(integrator.integrate(16000, {}).dx, 0);
+		CHECK_EQ(integrator.integrate(24000, { .dx = 0.9f }).dx, 0);
+	}
+
+	return test::test_result();
+}
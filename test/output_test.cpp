@@ -0,0 +1,95 @@
+// analog_output_t on a recording sink: the frames of every pad in a tick
+// are merged into one send() call, and the output thread sends what is
+// pending until it is stopped.
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "output.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+// A recording sink which tells another thread how many events it has got.
+class counting_sink_t: public recording_sink_t
+{
+public:
+	UINT send(UINT n, INPUT* inputs) override {
+		auto sent = recording_sink_t::send(n, inputs);
+		this->sent += sent;
+		return sent;
+	}
+
+	std::atomic<UINT> sent = 0;
+};
+
+} // namespace
+
+int main()
+{
+	// nothing pending, nothing sent.
+	{
+		analog_output_t output;
+		recording_sink_t sink;
+		CHECK_EQ(output.flush(sink), 0);
+		output.submit({});
+		CHECK_EQ(output.flush(sink), 0);
+		CHECK(sink.batches.empty());
+	}
+
+	// three pads in one tick: the cursor and both wheels in one call.
+	{
+		analog_output_t output;
+		recording_sink_t sink;
+		output.submit({ .dx = 3, .dy = -1 });
+		output.submit({ .dx = -1, .dy = 4, .vwheel = 120 });
+		output.submit({ .hwheel = -60, .vwheel = 10 });
+		CHECK_EQ(output.flush(sink), 3);
+		CHECK_EQ(sink.batches.size(), 1);
+		CHECK_EQ(sink.inputs.size(), 3);
+
+		auto& move = sink.inputs[0].mi;
+		CHECK_EQ(move.dwFlags, MOUSEEVENTF_MOVE);
+		CHECK_EQ(move.dx, 2);
+		CHECK_EQ(move.dy, 3);
+		CHECK_EQ(sink.inputs[1].mi.dwFlags, MOUSEEVENTF_HWHEEL);
+		CHECK_EQ((int)sink.inputs[1].mi.mouseData, -60);
+		CHECK_EQ(sink.inputs[2].mi.dwFlags, MOUSEEVENTF_WHEEL);
+		CHECK_EQ((int)sink.inputs[2].mi.mouseData, 130);
+
+		// the motion which cancels out sends nothing, and a flush takes everything.
+		output.submit({ .dx = 5 });
+		output.submit({ .dx = -5 });
+		CHECK_EQ(output.flush(sink), 0);
+		CHECK_EQ(sink.batches.size(), 1);
+
+		// a wheel alone.
+		output.submit({ .vwheel = -120 });
+		CHECK_EQ(output.flush(sink), 1);
+		CHECK_EQ(sink.batches.size(), 2);
+		CHECK_EQ(sink.inputs[3].mi.dwFlags, MOUSEEVENTF_WHEEL);
+	}
+
+	// the output thread sends what was submitted before it waits, then
+	// returns once the status has changed and it is stopped.
+	{
+		analog_output_t output;
+		counting_sink_t sink;
+		uint32_t status = 0;
+		output.submit({ .dx = 7 });
+		std::thread thread([&]{ output.run(&status, sink); });
+		while (sink.sent.load() == 0)
+			std::this_thread::yield();
+		status = 1;
+		output.stop();
+		thread.join();
+		CHECK_EQ(sink.inputs.size(), 1);
+		CHECK_EQ(sink.inputs[0].mi.dx, 7);
+	}
+
+	return test::test_result();
+}
@@ -0,0 +1,227 @@
+// The whole input pipeline on synthetic pads: slot_tracker_t -> poller_t ->
+// queue -> button_handler_t, recorded as it runs, then the recording
+// replayed through replay_recording(), which has to send the same events.
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "settings.h"
+#include "engine.h"
+#include "poll.h"
+#include "source.h"
+#include "record.h"
+#include "replay.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr uint64_t TICK = 8000;	// [us]
+constexpr int TICKS = 400;
+
+// what the pads do in tick t.
+void script(synthetic_source_t& source, int t)
+{
+	XINPUT_GAMEPAD pad = {};
+	if (t >= 10 && t < 120)
+		pad.wButtons |= XINPUT_GAMEPAD_DPAD_DOWN;	// held long enough to repeat
+	if (t >= 50 && t < 60)
+		pad.wButtons |= XINPUT_GAMEPAD_X;
+	if (t >= 150 && t < 250)
+		pad.sThumbLX = (SHORT)(t * 100);
+	if (t >= 200 && t < 260)
+		pad.sThumbRY = 20000;
+	source.set(0, pad);
+
+	// the second pad comes and goes.
+	if (t == 30) {
+		XINPUT_GAMEPAD b = {};
+		b.wButtons = XINPUT_GAMEPAD_DPAD_UP;
+		source.set(1, b);
+	}
+	if (t == 300)
+		source.disconnect(1);
+}
+
+// the key repeats due before a tick, at their own deadlines, as replay_recording() runs them.
+void repeat(button_handler_t& handler, uint64_t now)
+{
+	for (auto d = handler.next_deadline(); d != repeat_scheduler_t::NEVER && d * 1000 < now; d = handler.next_deadline())
+		handler.repeat(d);
+}
+
+// the handler thread, woken up by a tick.
+void handle(button_handler_t& handler, xinput_queue_t& queue, const settings_t& s, uint64_t now)
+{
+	handler.repeat(now / 1000);
+	xinput_t input;
+	while (queue.pop(input))
+		handler.handle(s, input, now / 1000);
+}
+
+bool same(const INPUT& a, const INPUT& b)
+{
+	if (a.type != b.type)
+		return false;
+	if (a.type == INPUT_KEYBOARD)
+		return a.ki.wVk == b.ki.wVk && a.ki.wScan == b.ki.wScan && a.ki.dwFlags == b.ki.dwFlags;
+	return a.mi.dx == b.mi.dx && a.mi.dy == b.mi.dy && a.mi.mouseData == b.mi.mouseData && a.mi.dwFlags == b.mi.dwFlags;
+}
+
+bool same(const std::vector<INPUT>& a, const std::vector<INPUT>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (!same(a[i], b[i])) {
+			fprintf(stderr, "the events differ at %zu\n", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+// a pad unplugged with a button held: the key goes up and stops repeating,
+// and a reconnect with nothing pressed sends nothing more.
+void unplug()
+{
+	settings_t s;
+	default_config(s);
+
+	device_registry_t devices;
+	synthetic_source_t source(devices);
+	slot_tracker_t slots(s.polling, source, devices);
+	xinput_queue_t queue(overflow_t::drop);
+	analog_output_t output;
+	poller_t poller(queue, output);
+	poller.attach(devices);
+	poller.configure(s);
+	no_window_system_t windows;
+	process_cache_t processes(windows);
+	recording_sink_t sink;
+	button_handler_t handler(sink, processes);
+
+	auto downs = [&] {
+		int n = 0;
+		for (auto& i: sink.inputs)
+			n += i.type == INPUT_KEYBOARD && i.ki.wVk == VK_DOWN && !(i.ki.dwFlags & KEYEVENTF_KEYUP);
+		return n;
+	};
+	auto ups = [&] {
+		int n = 0;
+		for (auto& i: sink.inputs)
+			n += i.type == INPUT_KEYBOARD && i.ki.wVk == VK_DOWN && (i.ki.dwFlags & KEYEVENTF_KEYUP);
+		return n;
+	};
+
+	for (int t = 0; t < 200; ++t) {
+		auto now = TICK * (t + 1);
+		XINPUT_GAMEPAD pad = {};
+		pad.wButtons = XINPUT_GAMEPAD_DPAD_DOWN;
+		if (t < 10 || t >= 150)
+			source.set(0, {});
+		else if (t < 20)
+			source.set(0, pad);
+		else if (t == 20)
+			source.disconnect(0);
+
+		repeat(handler, now);
+		poller.begin(now, now * 1000);
+		slots.poll(now,
+			[&](device_id_t i, const XINPUT_STATE& state, bool changed) { poller.state(i, state, changed); },
+			[&](device_id_t i) { poller.disconnect(i); });
+		poller.end();
+		handle(handler, queue, s, now);
+
+		if (t == 20) {
+			CHECK_EQ(downs(), 1);
+			CHECK_EQ(ups(), 1);
+		}
+	}
+	// no repeat after the release.
+	CHECK_EQ(downs(), 1);
+	CHECK_EQ(ups(), 1);
+	CHECK(handler.next_deadline() == repeat_scheduler_t::NEVER);
+}
+
+} // namespace
+
+int main()
+{
+	unplug();
+
+	settings_t s;
+	default_config(s);
+
+	device_registry_t devices;
+	synthetic_source_t source(devices);
+	slot_tracker_t slots(s.polling, source, devices);
+
+	xinput_queue_t queue(overflow_t::drop);
+	analog_output_t output;
+	poller_t poller(queue, output);
+	poller.attach(devices);
+	poller.configure(s);
+
+	no_window_system_t windows;
+	process_cache_t processes(windows);
+	recording_sink_t live;
+	button_handler_t handler(live, processes);
+
+	record_encoder_t encoder;
+	std::vector<uint8_t> recording;
+	encoder.header(recording);
+
+	for (int t = 0; t < TICKS; ++t) {
+		auto now = TICK * (t + 1);
+		script(source, t);
+
+		encoder.tick(recording, now);
+		repeat(handler, now);
+		poller.begin(now, now * 1000);
+		slots.poll(now,
+			[&](device_id_t i, const XINPUT_STATE& state, bool changed) {
+				if (changed || !encoder.known(i))
+					encoder.state(recording, i, state);
+				poller.state(i, state, changed);
+			},
+			[&](device_id_t i) {
+				encoder.disconnect(recording, i);
+				poller.disconnect(i);
+			});
+		poller.end();
+		output.flush(live);
+		handle(handler, queue, s, now);
+	}
+
+	CHECK_EQ(slots.count(), 1);
+	CHECK(live.inputs.size() > 20);
+
+	// the keys and the mouse button of the buttons went down and up.
+	int down = 0, up = 0, clicks = 0, moves = 0;
+	for (auto& i: live.inputs) {
+		if (i.type == INPUT_KEYBOARD)
+			++((i.ki.dwFlags & KEYEVENTF_KEYUP) ? up : down);
+		else if (i.mi.dwFlags == MOUSEEVENTF_LEFTDOWN || i.mi.dwFlags == MOUSEEVENTF_LEFTUP)
+			++clicks;
+		else if (i.mi.dwFlags == MOUSEEVENTF_MOVE)
+			++moves;
+	}
+	CHECK(down > up + 1);	// the repeats of VK_DOWN
+	CHECK(up >= 1);
+	CHECK_EQ(clicks, 2);
+	CHECK(moves > 0);
+
+	recording_sink_t replayed;
+	uint64_t clock = 0;
+	replay_stats_t stats;
+	CHECK(replay_recording(recording.data(), recording.size(), s, replayed, &clock, stats));
+	CHECK_EQ(stats.ticks, TICKS);
+	CHECK(!stats.broken);
+	CHECK_EQ(stats.inputs, live.inputs.size());
+	CHECK(same(live.inputs, replayed.inputs));
+
+	return test::test_result();
+}
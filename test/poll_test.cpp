@@ -0,0 +1,212 @@
+// slot_tracker_t on a scripted sequence of connects and disconnects: the
+// connected slots are read on every tick, the empty ones once per
+// probe_interval, and a lost pad is reported once.
+// poll_scheduler_t on a synthetic clock: the full rate at once on a change,
+// the back-off after idle_delay up to the idle rate, and the cpu load.
+#include <stdint.h>
+#include <math.h>
+
+#include <vector>
+
+#include "poll.h"
+#include "source.h"
+#include "devices.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr uint64_t TICK = 8000;	// [us]
+
+// The pads of the four slots, as the script sets them.
+class scripted_source_t: public input_source_t
+{
+public:
+	DWORD read(DWORD slot, XINPUT_STATE* state) override {
+		++reads[slot];
+		if (!connected[slot])
+			return ERROR_DEVICE_NOT_CONNECTED;
+		*state = states[slot];
+		return ERROR_SUCCESS;
+	}
+
+	bool connected[XUSER_MAX_COUNT] = {};
+	XINPUT_STATE states[XUSER_MAX_COUNT] = {};
+	int reads[XUSER_MAX_COUNT] = {};
+};
+
+struct events_t
+{
+	std::vector<device_id_t> states;
+	std::vector<device_id_t> changed;
+	std::vector<device_id_t> lost;
+};
+
+events_t tick(slot_tracker_t& slots, uint64_t now)
+{
+	events_t e;
+	slots.poll(now,
+		[&](device_id_t i, const XINPUT_STATE&, bool changed) {
+			e.states.push_back(i);
+			if (changed)
+				e.changed.push_back(i);
+		},
+		[&](device_id_t i) { e.lost.push_back(i); });
+	return e;
+}
+
+void scheduler()
+{
+	polling_t cfg;
+	cfg.active_rate = 1000;
+	cfg.idle_rate = 30;
+	cfg.idle_delay = 250;
+	poll_scheduler_t s(cfg);
+	CHECK_EQ(s.min_interval(), 1000);
+	CHECK_EQ(s.max_interval(), 33333);
+
+	// idle until the first change.
+	uint64_t now = 1000000;
+	CHECK_EQ(s.interval(), s.max_interval());
+	CHECK(s.idle());
+	CHECK_EQ(s.update(now, false, false, 0), s.max_interval());
+
+	// a change ramps up to the full rate at once, which holds for idle_delay.
+	now += s.interval();
+	CHECK_EQ(s.update(now, false, true, 0), s.min_interval());
+	CHECK(!s.idle());
+	auto changed_at = now;
+	for (now += s.interval(); now < changed_at + 250000; now += s.interval())
+		CHECK_EQ(s.update(now, false, false, 0), s.min_interval());
+
+	// then the interval doubles on every tick, up to the idle rate.
+	for (uint32_t expected: { 2000, 4000, 8000, 16000, 32000, 33333, 33333 }) {
+		CHECK_EQ(s.update(now, false, false, 0), expected);
+		now += s.interval();
+	}
+	CHECK(s.idle());
+
+	// a stick out of its deadzone is a change, and delays the back-off again.
+	CHECK_EQ(s.update(now, true, false, 0), s.min_interval());
+	now += s.interval();
+	CHECK_EQ(s.update(now, false, false, 0), s.min_interval());
+
+	// the cpu load is the smoothed ratio of busy to the time between ticks.
+	poll_scheduler_t load(cfg);
+	now = 1000000;
+	load.update(now, true, false, 500);
+	CHECK(load.cpu_load() == 0);	// no tick before the first
+	for (int i = 0; i < 400; ++i) {
+		now += 1000;
+		load.update(now, true, false, 100);
+	}
+	CHECK(fabsf(load.cpu_load() - 0.1f) < 0.001f);
+	auto smoothed = load.cpu_load();
+	now += 1000;
+	load.update(now, true, false, 1000);
+	CHECK(load.cpu_load() > smoothed);
+	CHECK(load.cpu_load() < 0.2f);
+
+	// a tick busier than the wall time counts as fully loaded; two ticks at
+	// the same time are not counted.
+	for (int i = 0; i < 400; ++i) {
+		now += 1000;
+		load.update(now, true, false, 5000);
+	}
+	CHECK(fabsf(load.cpu_load() - 1.0f) < 0.001f);
+	CHECK(load.cpu_load() <= 1.0f);
+	smoothed = load.cpu_load();
+	load.update(now, true, false, 0);
+	CHECK(load.cpu_load() == smoothed);
+}
+
+} // namespace
+
+int main()
+{
+	scheduler();
+
+	polling_t cfg;
+	cfg.probe_interval = 1000;
+
+	device_registry_t devices;
+	scripted_source_t source;
+	slot_tracker_t slots(cfg, source, devices);
+
+	// the slots are the first devices, in their order.
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i)
+		CHECK_EQ(slots.device(i), i);
+
+	// every empty slot is probed on the first tick, then not before probe_interval.
+	uint64_t now = 0;
+	auto e = tick(slots, now);
+	CHECK(e.states.empty());
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i)
+		CHECK_EQ(source.reads[i], 1);
+
+	// a pad plugged into slot 2 is found by the next probe.
+	source.connected[2] = true;
+	source.states[2].dwPacketNumber = 1;
+	for (now += TICK; now < 1000 * 1000; now += TICK)
+		CHECK(tick(slots, now).states.empty());
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i)
+		CHECK_EQ(source.reads[i], 1);
+
+	e = tick(slots, now);
+	CHECK(e.states == std::vector<device_id_t>{ 2 });
+	CHECK(e.changed == std::vector<device_id_t>{ 2 });
+	CHECK(slots.connected(2));
+	CHECK(devices.attached(2));
+	CHECK_EQ(slots.count(), 1);
+	for (int i = 0; i < XUSER_MAX_COUNT; ++i)
+		CHECK_EQ(source.reads[i], 2);
+
+	// the connected slot is read on every tick, and changed follows the packet number.
+	now += TICK;
+	e = tick(slots, now);
+	CHECK(e.states == std::vector<device_id_t>{ 2 });
+	CHECK(e.changed.empty());
+	source.states[2].dwPacketNumber = 2;
+	now += TICK;
+	e = tick(slots, now);
+	CHECK(e.changed == std::vector<device_id_t>{ 2 });
+	CHECK_EQ(source.reads[2], 4);
+	CHECK_EQ(source.reads[0], 2);
+
+	// the loss is reported once, then the slot is probed again.
+	source.connected[2] = false;
+	now += TICK;
+	e = tick(slots, now);
+	CHECK(e.states.empty());
+	CHECK(e.lost == std::vector<device_id_t>{ 2 });
+	CHECK(!slots.connected(2));
+	CHECK(!devices.attached(2));
+	auto lost_at = now;
+	auto reads = source.reads[2];
+	for (now += TICK; now < lost_at + 1000 * 1000; now += TICK)
+		CHECK(tick(slots, now).lost.empty());
+	CHECK_EQ(source.reads[2], reads);
+
+	// the pad comes back in the same slot, as the same device, and its
+	// first state counts as changed even with the old packet number.
+	source.connected[2] = true;
+	e = tick(slots, now);
+	CHECK(e.changed == std::vector<device_id_t>{ 2 });
+	CHECK(devices.attached(2));
+
+	// two pads lost in one tick.
+	source.connected[0] = true;
+	now += 1000 * 1000;
+	tick(slots, now);
+	CHECK_EQ(slots.count(), 2);
+	source.connected[0] = source.connected[2] = false;
+	now += TICK;
+	e = tick(slots, now);
+	CHECK((e.lost == std::vector<device_id_t>{ 0, 2 }));
+	CHECK_EQ(slots.count(), 0);
+	CHECK(devices.active().empty());
+
+	return test::test_result();
+}
@@ -0,0 +1,96 @@
+// process_cache_t on a scripted window system: the names are cached by
+// process, dropped when the process exits, and what a lookup returns stays
+// valid whatever the cache does afterwards.
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "process.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+// Windows are their process ids. The names of the processes in uncached
+// are returned, but may not be cached.
+class scripted_window_system_t: public window_system_t
+{
+public:
+	window_t window_under_cursor() override { return cursor; }
+	window_t foreground_window() override { return foreground; }
+	process_id_t process_id(window_t window) override { return (process_id_t)window; }
+	bool executable_name(process_id_t pid, std::string& name) override {
+		++queries;
+		auto n = names.find(pid);
+		if (n == names.end())
+			return false;
+		name = n->second;
+		return uncached.count(pid) == 0;
+	}
+
+	window_t cursor = 0;
+	window_t foreground = 0;
+	std::map<process_id_t, std::string> names;
+	std::map<process_id_t, bool> uncached;
+	int queries = 0;
+};
+
+} // namespace
+
+int main()
+{
+	scripted_window_system_t ws;
+	ws.names = {
+		{ 1, "a-rather-long-executable-name.exe" },
+		{ 2, "another-rather-long-executable-name.exe" },
+		{ 3, "elevated-process-one.exe" },
+		{ 4, "elevated-process-two.exe" },
+	};
+	ws.uncached = { { 3, true }, { 4, true } };
+	process_cache_t cache(ws);
+
+	// a name is queried once, then cached.
+	ws.cursor = 1;
+	CHECK(cache.under_cursor() == "a-rather-long-executable-name.exe");
+	CHECK(cache.under_cursor() == "a-rather-long-executable-name.exe");
+	CHECK_EQ(ws.queries, 1);
+	CHECK_EQ(cache.stats().hits, 1);
+	CHECK_EQ(cache.stats().misses, 1);
+
+	// the exit of a process drops its name from the cache on the next
+	// lookup, so a name is copied to be kept across lookups.
+	ws.foreground = 2;
+	std::string cursor(cache.under_cursor());
+	cache.invalidate_process(1);
+	auto foreground = cache.foreground();
+	CHECK(cursor == "a-rather-long-executable-name.exe");
+	CHECK(foreground == "another-rather-long-executable-name.exe");
+	CHECK(cache.under_cursor() == "a-rather-long-executable-name.exe");
+	CHECK_EQ(ws.queries, 3);
+
+	// names which may not be cached are queried every time, into the
+	// same buffer.
+	ws.cursor = 3;
+	ws.foreground = 4;
+	cache.invalidate_foreground();
+	std::string elevated_cursor(cache.under_cursor());
+	std::string elevated_foreground(cache.foreground());
+	CHECK(elevated_cursor == "elevated-process-one.exe");
+	CHECK(elevated_foreground == "elevated-process-two.exe");
+	CHECK(cache.under_cursor() == "elevated-process-one.exe");
+	CHECK_EQ(ws.queries, 6);
+
+	// no window, no name; clear() drops everything.
+	ws.cursor = 0;
+	CHECK(cache.under_cursor().empty());
+	ws.foreground = 2;
+	cache.clear();
+	auto queries = ws.queries;
+	CHECK(cache.foreground() == "another-rather-long-executable-name.exe");
+	CHECK_EQ(ws.queries, queries + 1);
+
+	return test::test_result();
+}
@@ -0,0 +1,175 @@
+// xinput_queue_t: the order and the overflow policies on one thread, then
+// a producer and a consumer thread hammering it. The states of a device
+// must come out in the order they went in, and its last state must always
+// come out.
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr size_t CAPACITY = xinput_queue_t::CAPACITY;
+
+xinput_t state(device_id_t device, uint32_t sequence)
+{
+	return { device, sequence, (uint16_t)sequence, (uint8_t)(device % 4) };
+}
+
+void single_thread()
+{
+	// first in, first out, and the counters.
+	{
+		xinput_queue_t queue(overflow_t::drop);
+		for (uint32_t i = 0; i < CAPACITY; ++i)
+			CHECK(queue.push(state(i % 3, i)));
+		CHECK(!queue.push(state(0, 999)));
+		CHECK_EQ(queue.depth(), CAPACITY);
+		CHECK_EQ(queue.stats().pushed, CAPACITY);
+		CHECK_EQ(queue.stats().overflows, 1);
+		CHECK_EQ(queue.stats().max_depth, CAPACITY);
+
+		xinput_t v;
+		for (uint32_t i = 0; i < CAPACITY; ++i) {
+			CHECK(queue.pop(v));
+			CHECK_EQ(v.timestamp, i);
+			CHECK_EQ(v.device, (device_id_t)(i % 3));
+			CHECK_EQ(v.controller, i % 3);
+		}
+		CHECK(!queue.pop(v));
+	}
+
+	// coalesce: a full ring keeps the latest state of each device aside,
+	// and hands it out after what was pushed before it.
+	{
+		xinput_queue_t queue(overflow_t::coalesce);
+		for (uint32_t i = 0; i < CAPACITY; ++i)
+			CHECK(queue.push(state(0, i)));
+		CHECK(queue.push(state(1, 100)));
+		CHECK(queue.push(state(2, 200)));
+		CHECK(queue.push(state(1, 101)));
+		CHECK_EQ(queue.stats().overflows, 3);
+
+		// device 2 is not aside any more once it is taken, device 1 stays
+		// aside until then even though the ring has room.
+		xinput_t v;
+		CHECK(queue.pop(v));
+		CHECK(queue.push(state(1, 102)));
+		for (uint32_t i = 1; i < CAPACITY; ++i) {
+			CHECK(queue.pop(v));
+			CHECK_EQ(v.device, 0);
+		}
+		CHECK(queue.pop(v));
+		CHECK_EQ(v.device, 1);
+		CHECK_EQ(v.timestamp, 102);
+		CHECK_EQ(v.buttons, 102);
+		CHECK_EQ(v.controller, 1);
+		CHECK(queue.pop(v));
+		CHECK_EQ(v.device, 2);
+		CHECK_EQ(v.timestamp, 200);
+		CHECK(!queue.pop(v));
+
+		// the device goes through the ring again.
+		CHECK(queue.push(state(1, 103)));
+		CHECK_EQ(queue.depth(), 1);
+	}
+
+	// a state aside is not forgotten however far the ring goes past it
+	// while another device keeps it busy.
+	for (uint32_t cycles: { 100u, 200u, 1000u, 70000u }) {
+		xinput_queue_t queue(overflow_t::coalesce);
+		for (uint32_t i = 0; i < CAPACITY; ++i)
+			CHECK(queue.push(state(1, i)));
+		CHECK(queue.push(state(0, 1)));
+		xinput_t v = {};
+		int delivered = 0;
+		for (uint32_t i = 0; i < cycles; ++i) {
+			CHECK(queue.pop(v));
+			delivered += v.device == 0;
+			queue.push(state(1, CAPACITY + i));
+		}
+		while (queue.pop(v))
+			delivered += v.device == 0;
+		CHECK_EQ(delivered, 1);
+	}
+}
+
+// every state of the devices, in turn, as fast as the consumer takes them.
+void stress(overflow_t policy, uint32_t states)
+{
+	constexpr int DEVICES = 8;
+	xinput_queue_t queue(policy);
+	std::atomic<bool> done = false;
+	std::vector<uint32_t> pushed(DEVICES, 0);	// the last sequence accepted, + 1
+
+	std::thread producer([&]{
+		for (uint32_t i = 1; i <= states; ++i) {
+			auto device = (device_id_t)(i % DEVICES);
+			if (queue.push(state(device, i)))
+				pushed[device] = i + 1;
+			if (i % 64 == 0)
+				queue.signal().notify();
+		}
+		done.store(true, std::memory_order_release);
+		queue.signal().notify();
+	});
+
+	std::vector<uint32_t> last(DEVICES, 0);
+	uint64_t popped = 0;
+	int disorders = 0, bad = 0;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+	for (;;) {
+		auto seen = queue.signal().value();
+		bool finished = done.load(std::memory_order_acquire);
+		xinput_t v;
+		bool any = false;
+		while (queue.pop(v)) {
+			any = true;
+			++popped;
+			if (v.device < 0 || v.device >= DEVICES || v.buttons != (uint16_t)v.timestamp || v.controller != v.device % 4)
+				++bad;
+			else if (v.timestamp <= last[v.device])
+				++disorders;
+			else
+				last[v.device] = v.timestamp;
+		}
+		if (finished && !any)
+			break;
+		if (std::chrono::steady_clock::now() > deadline)
+			break;
+		if (!any)
+			queue.signal().wait(seen, 1);
+	}
+	producer.join();
+
+	CHECK_EQ(bad, 0);
+	CHECK_EQ(disorders, 0);
+	for (int d = 0; d < DEVICES; ++d) {
+		// the last state accepted came out.
+		if (pushed[d] != 0)
+			CHECK_EQ(last[d] + 1, pushed[d]);
+	}
+	if (policy == overflow_t::coalesce)
+		CHECK_EQ(queue.stats().pushed + queue.stats().overflows, states);
+	else
+		CHECK_EQ(popped, queue.stats().pushed);
+}
+
+} // namespace
+
+int main()
+{
+	single_thread();
+	stress(overflow_t::drop, 2'000'000);
+	stress(overflow_t::coalesce, 2'000'000);
+	return test::test_result();
+}
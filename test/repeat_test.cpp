@@ -0,0 +1,146 @@
+// repeat_scheduler_t on a virtual clock: the repeats come at the delay and
+// then every interval, and a caller who is late, by less or more than a
+// turn of the wheel, gets one repeat per key and keeps the phase.
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "repeat.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+using repeat_key_t = std::pair<device_id_t, uint8_t>;
+
+std::vector<repeat_key_t> advance(repeat_scheduler_t& r, uint64_t now)
+{
+	std::vector<repeat_key_t> fired;
+	r.advance(now, [&](device_id_t d, uint8_t vk) { fired.push_back({ d, vk }); });
+	return fired;
+}
+
+repeat_config_t config(uint32_t delay, uint32_t interval)
+{
+	return { .delay = delay, .interval = interval, .keys = {} };
+}
+
+// The repeats as they are specified: a key due at now fires once, and its
+// next repeat is the first of its phase after now.
+struct model_t
+{
+	struct timer_t
+	{
+		uint64_t deadline;
+		uint32_t interval;
+	};
+	std::map<repeat_key_t, timer_t> timers;
+
+	void press(repeat_key_t k, uint64_t now, const repeat_config_t& cfg) {
+		timers[k] = { now + cfg.delay, cfg.interval };
+	}
+	std::map<repeat_key_t, int> advance(uint64_t now) {
+		std::map<repeat_key_t, int> fired;
+		for (auto& [k, t]: timers) {
+			if (t.deadline > now)
+				continue;
+			++fired[k];
+			t.deadline += ((now - t.deadline) / t.interval + 1) * t.interval;
+		}
+		return fired;
+	}
+	uint64_t next_deadline() const {
+		auto d = repeat_scheduler_t::NEVER;
+		for (auto& [k, t]: timers)
+			d = std::min(d, t.deadline);
+		return d;
+	}
+};
+
+} // namespace
+
+int main()
+{
+	// the delay, then every interval, until the release.
+	{
+		repeat_scheduler_t r;
+		CHECK(r.next_deadline() == repeat_scheduler_t::NEVER);
+		r.press(0, 'A', 100, config(500, 33));
+		CHECK_EQ(r.next_deadline(), 600);
+		CHECK(advance(r, 599).empty());
+		CHECK_EQ(advance(r, 600).size(), 1);
+		CHECK_EQ(r.next_deadline(), 633);
+		CHECK_EQ(advance(r, 640).size(), 1);
+		CHECK_EQ(r.next_deadline(), 666);
+		r.release(0, 'A');
+		CHECK(r.empty());
+		CHECK(advance(r, 700).empty());
+	}
+
+	// late by more than a turn of the wheel: one repeat, and the phase is kept.
+	{
+		repeat_scheduler_t r;
+		r.press(0, 'A', 1000, config(500, 1000));
+		CHECK_EQ(advance(r, 1500).size(), 1);
+		CHECK_EQ(r.next_deadline(), 2500);
+		CHECK_EQ(advance(r, 11500).size(), 1);
+		CHECK_EQ(r.next_deadline(), 12500);
+		CHECK_EQ(advance(r, 12500).size(), 1);
+		CHECK_EQ(r.next_deadline(), 13500);
+	}
+
+	// late by less than a turn, but with the longest interval.
+	{
+		repeat_scheduler_t r;
+		auto max = repeat_scheduler_t::MAX_PERIOD;
+		r.press(0, 'A', 0, config(1, max));
+		CHECK_EQ(advance(r, 2040).size(), 1);
+		CHECK_EQ(r.next_deadline(), 1 + 2 * max);
+		CHECK(advance(r, 2 * max).empty());
+		CHECK_EQ(advance(r, 2 * max + 1).size(), 1);
+	}
+
+	// keys of several devices against the model, with the clock going
+	// forward by anything from a millisecond to several turns.
+	{
+		std::mt19937 random(2024);
+		std::uniform_int_distribution<uint32_t> delay(1, 1000), interval(1, 1000), key(0, 40), step(0, 99);
+		repeat_scheduler_t r;
+		model_t model;
+		uint64_t now = 0;
+		int failed = 0;
+		for (int i = 0; i < 20000 && failed < 10; ++i) {
+			auto s = step(random);
+			now += s < 70 ? s % 20 + 1 : s < 95 ? s * 20 : s * 100;
+
+			std::map<repeat_key_t, int> fired;
+			for (auto& k: advance(r, now))
+				++fired[k];
+			if (fired != model.advance(now) || r.next_deadline() != model.next_deadline()) {
+				fprintf(stderr, "at %llu: the repeats differ from the model\n", (unsigned long long)now);
+				++failed;
+			}
+
+			// press or release a key now and then.
+			repeat_key_t k = { (device_id_t)(key(random) % 3), (uint8_t)(key(random) + 'A') };
+			if (i % 3 == 0) {
+				auto cfg = config(delay(random), interval(random));
+				r.press(k.first, k.second, now, cfg);
+				model.press(k, now, cfg);
+			}
+			else if (i % 7 == 0) {
+				r.release(k.first, k.second);
+				model.timers.erase(k);
+			}
+		}
+		CHECK_EQ(failed, 0);
+	}
+
+	return test::test_result();
+}
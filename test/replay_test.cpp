@@ -0,0 +1,134 @@
+// gpmouse --replay on a recording at a path which is not ASCII: the text it
+// writes is the one expected of the scripted session, line for line, and
+// the same as replay_recording() gives in memory. The paths are converted
+// to UTF-8 and back whatever the locale.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+#include "platform.h"
+#include "record.h"
+#include "replay.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr uint64_t TICK = 8000;	// [us]
+
+// DOWN is tapped, the left shoulder holds CONTROL over A (ESCAPE), X clicks,
+// and the left stick moves the cursor.
+std::vector<uint8_t> session()
+{
+	record_encoder_t encoder;
+	std::vector<uint8_t> data;
+	encoder.header(data);
+	for (int t = 0; t < 100; ++t) {
+		XINPUT_STATE s = {};
+		s.dwPacketNumber = (DWORD)t;
+		if (t >= 10 && t < 12)
+			s.Gamepad.wButtons |= XINPUT_GAMEPAD_DPAD_DOWN;
+		if (t >= 20 && t < 40)
+			s.Gamepad.wButtons |= XINPUT_GAMEPAD_LEFT_SHOULDER;
+		if (t >= 25 && t < 30)
+			s.Gamepad.wButtons |= XINPUT_GAMEPAD_A;
+		if (t >= 50 && t < 53)
+			s.Gamepad.wButtons |= XINPUT_GAMEPAD_X;
+		if (t >= 60 && t < 63)
+			s.Gamepad.sThumbLX = 30000;
+		encoder.tick(data, TICK * (t + 1));
+		encoder.state(data, 0, s);
+	}
+	return data;
+}
+
+std::string read(const std::wstring& path)
+{
+	std::string text;
+	if (auto f = open_file(path, "r")) {
+		char buf[256];
+		while (auto n = fread(buf, 1, sizeof(buf), f))
+			text.append(buf, n);
+		fclose(f);
+	}
+	return text;
+}
+
+// what replay_file() writes, in memory.
+std::string replay(const std::vector<uint8_t>& data, const settings_t& s)
+{
+	char* buf = nullptr;
+	size_t size = 0;
+	auto out = open_memstream(&buf, &size);
+	uint64_t clock = 0;
+	text_sink_t sink(out, &clock);
+	replay_stats_t stats;
+	replay_recording(data.data(), data.size(), s, sink, &clock, stats);
+	fclose(out);
+	std::string text(buf, size);
+	free(buf);
+	return text;
+}
+
+} // namespace
+
+int main()
+{
+	settings_t s;
+	default_config(s);
+	auto data = session();
+
+	auto dir = std::filesystem::temp_directory_path().wstring() + L"/gpmouse_replay_test." + std::to_wstring(getpid()) + L"/記録 é";
+	CHECK(from_utf8(to_utf8(dir)) == dir);
+	CHECK(file_path(dir).native() == to_utf8(dir));
+	CHECK(to_utf8(L"記録 é") == "\xe8\xa8\x98\xe9\x8c\xb2 \xc3\xa9");
+	CHECK(from_utf8("a\xff\xe8\xa8") == L"a\ufffd\ufffd");
+	auto exe = executable_path();
+	CHECK(exe.size() > 12 && exe.substr(exe.size() - 12) == L"/replay_test");
+	std::filesystem::create_directories(file_path(dir));
+	auto recording = dir + L"/セッション.bin", output = dir + L"/出力.txt";
+	{
+		auto f = open_file(recording, "wb");
+		CHECK(f != nullptr);
+		if (f) {
+			fwrite(data.data(), 1, data.size(), f);
+			fclose(f);
+		}
+	}
+
+	replay_stats_t stats;
+	CHECK(replay_file(recording, output, s, stats));
+	CHECK_EQ(stats.ticks, 100);
+	CHECK(!stats.broken);
+	auto text = read(output);
+	CHECK(text == replay(data, s));
+
+	// the session as it has always replayed.
+	CHECK(text ==
+		"80000 key VK_DOWN down\n"
+		"96000 key VK_DOWN up\n"
+		"160000 key VK_CONTROL down\n"
+		"200000 key VK_ESCAPE down\n"
+		"240000 key VK_ESCAPE up\n"
+		"320000 key VK_CONTROL up\n"
+		"400000 button left down\n"
+		"424000 button left up\n"
+		"480000 move 10 0\n"
+		"488000 move 10 0\n"
+		"496000 move 10 0\n");
+	if (test::failures())
+		fprintf(stderr, "%s", text.c_str());
+
+	CHECK(!replay_file(dir + L"/ない.bin", output, s, stats));
+	std::filesystem::remove_all(file_path(dir).parent_path());
+
+	return test::test_result();
+}
@@ -0,0 +1,183 @@
+// snapshot_t under reloads in a tight loop: the readers never see an
+// object freed or half built, and the poll and handler threads keep running
+// on synthetic pads while the settings are published over and over.
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "settings.h"
+#include "snapshot.h"
+#include "engine.h"
+#include "poll.h"
+#include "source.h"
+
+#include "check.h"
+
+using namespace gpmouse;
+
+namespace {
+
+constexpr int RELOADS = 2000;
+
+// an object which tells when it is used after delete: the memory is kept
+// and poisoned instead of freed, so a late reader reads DEAD.
+struct canary_t
+{
+	static constexpr uint64_t ALIVE = 0x616c697665;
+	static constexpr uint64_t DEAD = 0xdeaddeaddead;
+
+	volatile uint64_t magic = ALIVE;	// first
+	uint64_t version;
+	uint64_t check;		// version, twice
+
+	explicit canary_t(uint64_t v): version(v), check(~v) {}
+	bool valid() const {
+		return magic == ALIVE && check == ~version;
+	}
+
+	static void operator delete(void* p) {
+		// volatile: the object is dead to the compiler already.
+		*static_cast<volatile uint64_t*>(p) = DEAD;
+	}
+};
+
+void stress_canary()
+{
+	snapshot_t<canary_t> snapshot;
+	snapshot.publish(std::make_unique<canary_t>(0));
+
+	std::atomic<bool> stop = false;
+	std::atomic<int> broken = 0, backwards = 0;
+	auto read = [&] {
+		snapshot_t<canary_t>::reader_t reader(snapshot);
+		uint64_t last = 0;
+		while (!stop.load()) {
+			// gives the writer the CPU while the object is in use, as a
+			// preempted reader does.
+			auto& c = reader.enter();
+			for (int i = 0; i < 10; ++i) {
+				if (!c.valid())
+					++broken;
+				std::this_thread::yield();
+			}
+			if (!c.valid())
+				++broken;
+			if (c.version < last)
+				++backwards;
+			last = c.version;
+			reader.leave();
+			std::this_thread::yield();
+		}
+	};
+	std::thread a(read), b(read);
+
+	for (uint64_t v = 1; v <= RELOADS; ++v)
+		snapshot.publish(std::make_unique<canary_t>(v));
+	stop = true;
+	a.join();
+	b.join();
+
+	CHECK_EQ(snapshot.version(), RELOADS + 1);
+	CHECK_EQ(broken.load(), 0);
+	CHECK_EQ(backwards.load(), 0);
+}
+
+std::unique_ptr<settings_t> settings(int i)
+{
+	auto s = std::make_unique<settings_t>();
+	default_config(*s);
+	s->repeat.delay = 10 + i % 50;
+	s->repeat.interval = 1 + i % 7;
+	return s;
+}
+
+// the poll thread and the handler thread of gpmouse.cpp, on synthetic pads.
+void stress_pipeline()
+{
+	snapshot_t<settings_t> snapshot;
+	snapshot.publish(settings(0));
+
+	xinput_queue_t queue(overflow_t::drop);
+	std::atomic<bool> stop = false;
+	std::atomic<uint64_t> polls = 0;
+
+	std::thread poll([&] {
+		snapshot_t<settings_t>::reader_t reader(snapshot);
+		uint64_t version = 0;
+		analog_output_t output;
+		recording_sink_t sink;
+		poller_t poller(queue, output);
+		device_registry_t devices;
+		synthetic_source_t source(devices);
+		slot_tracker_t slots(poller.polling(), source, devices);
+		poller.attach(devices);
+
+		for (uint64_t t = 1; !stop.load(); ++t) {
+			if (version != snapshot.version()) {
+				version = snapshot.version();
+				poller.configure(reader.enter());
+				reader.leave();
+			}
+			XINPUT_GAMEPAD pad = {};
+			pad.wButtons = (t / 4) % 2 ? XINPUT_GAMEPAD_DPAD_DOWN : XINPUT_GAMEPAD_X;
+			pad.sThumbLX = (SHORT)(t % 2 ? 20000 : -20000);
+			source.set(0, pad);
+
+			auto now = t * 1000;
+			poller.begin(now, now * 1000);
+			slots.poll(now,
+				[&](device_id_t i, const XINPUT_STATE& state, bool changed) { poller.state(i, state, changed); },
+				[&](device_id_t i) { poller.disconnect(i); });
+			poller.end();
+			output.flush(sink);
+			++polls;
+			std::this_thread::yield();
+		}
+	});
+
+	std::atomic<uint64_t> handled = 0;
+	std::thread handle([&] {
+		snapshot_t<settings_t>::reader_t reader(snapshot);
+		no_window_system_t windows;
+		process_cache_t processes(windows);
+		recording_sink_t sink;
+		button_handler_t handler(sink, processes);
+		xinput_t input;
+		for (uint64_t now = 1; !stop.load(); ++now) {
+			auto& s = reader.enter();
+			handler.repeat(now);
+			while (queue.pop(input)) {
+				handler.handle(s, input, now);
+				++handled;
+			}
+			reader.leave();
+			std::this_thread::yield();
+		}
+	});
+
+	for (int i = 1; i <= RELOADS; ++i)
+		snapshot.publish(settings(i));
+	// the threads run on the last settings for a while too.
+	while (handled.load() < 100)
+		std::this_thread::yield();
+	stop = true;
+	poll.join();
+	handle.join();
+
+	CHECK_EQ(snapshot.version(), RELOADS + 1);
+	CHECK(polls.load() > 0);
+	CHECK(handled.load() >= 100);
+}
+
+} // namespace
+
+int main()
+{
+	stress_canary();
+	stress_pipeline();
+	return test::test_result();
+}